@@ -79,7 +79,8 @@ export default class UIToolbar extends React.Component {
     this.scUpdate.updateMeshes(
       nodeId,
       hwv.model.getNodeParent(nodeId),
-      meshDataCopy
+      meshDataCopy,
+      hwv.model.getNodeMatrix(nodeId)
     );
     this.scUpdate.sendToLibSc();
   }
@@ -1,5 +1,14 @@
 import io from 'socket.io-client';
 
+// btoa() takes a binary string; build it in slices so large buffers do not overflow the call stack.
+function toBase64(bytes) {
+  let binary = '';
+  for (let i = 0; i < bytes.length; i += 0x8000) {
+    binary += String.fromCharCode.apply(null, bytes.subarray(i, i + 0x8000));
+  }
+  return btoa(binary);
+}
+
 export default class scUpdate {
   constructor(libScServerEndpoint, modelname) {
     this.scChanges = {};
@@ -28,6 +37,8 @@ export default class scUpdate {
     this.scChanges.nodeNames.push(nodeInfo);
   }
 
+  // nodeAttributes maps names to values. Numbers and booleans are stored as numeric attributes and
+  // ISO 8601 dates (a Date serializes to one) as time attributes; anything else as text.
   updateAttributes(nodeId, nodeAttributes) {
     //Need to add check if nodeId already has attribute updates associated
     let nodeInfo = {
@@ -40,6 +51,19 @@ export default class scUpdate {
     this.scChanges.attributes.push(updateInfo);
   }
 
+  // Imports a partNumber,attribute,value CSV/TSV from the server's attribute directory
+  // (LIBSC_ATTRIBUTE_DIR); rows apply to every node whose keyAttribute (default PartNumber) matches.
+  importAttributeTable(file, keyAttribute) {
+    if (!this.scChanges.hasOwnProperty('attributeTables')) {
+      this.scChanges.attributeTables = [];
+    }
+    let table = { file: file };
+    if (keyAttribute) {
+      table.keyAttribute = keyAttribute;
+    }
+    this.scChanges.attributeTables.push(table);
+  }
+
   updateDefaultCameraView(camera) {
     this.scChanges.defaultCamera = camera;
   }
@@ -58,18 +82,82 @@ export default class scUpdate {
     });
   }
 
-  updateMeshes(nodeId, parentNodeId, meshData) {
+  // Moves a node by replacing its local transform (a Communicator.Matrix); nodeId may be a mesh
+  // node added earlier in the same change set.
+  updateTransforms(nodeId, localTransform) {
+    if (!this.scChanges.hasOwnProperty('transforms')) {
+      this.scChanges.transforms = [];
+    }
+    this.scChanges.transforms.push({
+      nodeId: nodeId,
+      localTransform: Array.from(localTransform.m),
+    });
+  }
+
+  // Reparents nodeId, with its subtree, under parentNodeId. Both must already exist in the model.
+  // Unless keepWorldTransform is false the node's local transform is recomposed so it stays in place.
+  moveNode(nodeId, parentNodeId, keepWorldTransform) {
+    if (!this.scChanges.hasOwnProperty('moves')) {
+      this.scChanges.moves = [];
+    }
+    this.scChanges.moves.push({
+      nodeId: nodeId,
+      parentNodeId: parentNodeId,
+      keepWorldTransform: keepWorldTransform !== false,
+    });
+  }
+
+  // Adds a point cloud under parentNodeId. positions is a Float32Array of x,y,z and colors an
+  // optional Uint8Array of r,g,b,a per point; both are sent as base64 to keep large scans compact.
+  updatePointClouds(nodeId, parentNodeId, positions, colors, localTransform) {
+    if (!this.scChanges.hasOwnProperty('pointClouds')) {
+      this.scChanges.pointClouds = [];
+    }
+    let cloud = {
+      nodeId: nodeId,
+      parentNodeId: parentNodeId,
+      localTransform: localTransform ? Array.from(localTransform.m) : undefined,
+      positionData: toBase64(new Uint8Array(positions.buffer, positions.byteOffset, positions.byteLength)),
+    };
+    if (colors) {
+      cloud.rgbaData = toBase64(colors);
+    }
+    this.scChanges.pointClouds.push(cloud);
+  }
+
+  // polygons is an array of {position: [x, y, z, ...], normal?, rgba?} planar loops; the server
+  // triangulates them.
+  updatePolygons(nodeId, parentNodeId, polygons, localTransform) {
+    if (!this.scChanges.hasOwnProperty('meshes')) {
+      this.scChanges.meshes = [];
+    }
+    this.scChanges.meshes.push({
+      nodeId: nodeId,
+      parentNodeId: parentNodeId,
+      localTransform: localTransform ? Array.from(localTransform.m) : undefined,
+      polygons: polygons.map((polygon) => ({
+        position: Array.from(polygon.position),
+        normal: polygon.normal ? Array.from(polygon.normal) : undefined,
+        rgba: polygon.rgba ? Array.from(polygon.rgba) : undefined,
+      })),
+    });
+  }
+
+  // lineStroke ({thickness, cap: 'round' | 'none'}) bakes the mesh's lines into solid strokes,
+  // e.g. for redline markup.
+  updateMeshes(nodeId, parentNodeId, meshData, localTransform, lineStroke) {
     // Need to parse meshdatacopy and put into JSON.
     let meshDataTemplate = {
       nodeId: nodeId,
       parentNodeId: parentNodeId,
-      localTransform: undefined,
+      localTransform: localTransform ? Array.from(localTransform.m) : undefined,
       faces: [],
       lines: [],
       points: [],
       winding: meshData.winding,
       isTwoSided: meshData.isTwoSided,
       isManifold: meshData.isManifold,
+      lineStroke: lineStroke,
     }
 
     let elementTypes = ["faces", "lines", "points"];
@@ -1,16 +1,143 @@
 var express = require('express');
 var { Server } = require('socket.io');
 var path = require('path');
+var os = require('os');
 var app = express();
 var http = require('http');
 
 const httpServer = http.createServer(app);
 const io = new Server(httpServer, {
+  // Point clouds arrive as a single change set message.
+  maxHttpBufferSize: (parseInt(process.env.LIBSC_MAX_CHANGESET_MB, 10) || 256) * 1024 * 1024,
   cors: {
     origin: 'http//:localhost:3000',
   },
 });
 const { spawn } = require('child_process');
+const { AuthoringScheduler } = require('./authoring-scheduler');
+
+// Authoring jobs run on a bounded pool of libsc processes, serialized per model.
+const scheduler = new AuthoringScheduler({
+  workers: parseInt(process.env.LIBSC_WORKERS, 10) || undefined,
+  maxQueued: parseInt(process.env.LIBSC_MAX_QUEUED, 10) || undefined,
+  launch: (modelname, job) => runAuthoringJob(job.socket, modelname, job.libSCdataJSON),
+  onSuperseded: (modelname, job) => {
+    job.socket.emit('libscstdout', 'Change set superseded before it started.');
+  },
+});
+
+// libsc_sample writes one JSON event per line (see sc_update_progress.h). Structured events go to
+// the client as 'libscprogress'; log lines and finished phases are also rendered as text on
+// 'libscstdout' for the terminal pane.
+function forwardLibscLine(socket, line) {
+  if (line.length === 0) return;
+  let event;
+  try {
+    event = JSON.parse(line);
+  } catch (e) {
+    socket.emit('libscstdout', line);
+    return;
+  }
+  socket.emit('libscprogress', event);
+  if (event.event === 'log') {
+    const prefix = event.level === 'info' ? '' : `${event.level.toUpperCase()}: `;
+    socket.emit('libscstdout', prefix + event.message);
+  } else if (event.event === 'end') {
+    socket.emit('libscstdout', `[${event.phase}] ${event.duration_ms.toFixed(1)} ms`);
+  }
+}
+
+function runAuthoringJob(socket, modelname, libSCdataJSON) {
+  const env = {
+    LD_LIBRARY_PATH: path.join(__dirname, '/libsc/bin/macos/'),
+    // Split the cores between the concurrent libsc processes for their parallel mesh stages.
+    SC_UPDATE_THREADS: String(Math.max(1, Math.floor(os.cpus().length / scheduler.workers))),
+  };
+  // Set LIBSC_LOD_LEVELS (1-3) to store decimated levels of detail with every uploaded mesh.
+  if (process.env.LIBSC_LOD_LEVELS) {
+    env.SC_UPDATE_LOD_LEVELS = process.env.LIBSC_LOD_LEVELS;
+  }
+  // LIBSC_CHUNK_VERTICES / LIBSC_CHUNK_BYTES bound the size of one stream unit of uploaded geometry.
+  if (process.env.LIBSC_CHUNK_VERTICES) {
+    env.SC_UPDATE_CHUNK_VERTICES = process.env.LIBSC_CHUNK_VERTICES;
+  }
+  if (process.env.LIBSC_CHUNK_BYTES) {
+    env.SC_UPDATE_CHUNK_BYTES = process.env.LIBSC_CHUNK_BYTES;
+  }
+  // LIBSC_LINE_THICKNESS (> 0) tessellates uploaded lines into solid strokes; LIBSC_LINE_CAPS is round or none.
+  if (process.env.LIBSC_LINE_THICKNESS) {
+    env.SC_UPDATE_LINE_THICKNESS = process.env.LIBSC_LINE_THICKNESS;
+  }
+  if (process.env.LIBSC_LINE_CAPS) {
+    env.SC_UPDATE_LINE_CAPS = process.env.LIBSC_LINE_CAPS;
+  }
+  // LIBSC_POINT_BATCH sets the points per point-cloud mesh batch.
+  if (process.env.LIBSC_POINT_BATCH) {
+    env.SC_UPDATE_POINT_BATCH = process.env.LIBSC_POINT_BATCH;
+  }
+  // LIBSC_ATTRIBUTE_DIR holds the CSV/TSV files attributeTables entries refer to.
+  if (process.env.LIBSC_ATTRIBUTE_DIR) {
+    env.SC_UPDATE_ATTRIBUTE_DIR = process.env.LIBSC_ATTRIBUTE_DIR;
+  }
+  // Set LIBSC_TRACE_DIR to get a Chrome trace (Perfetto / chrome://tracing) of every run.
+  if (process.env.LIBSC_TRACE_DIR) {
+    env.SC_UPDATE_TRACE = path.join(process.env.LIBSC_TRACE_DIR, `${modelname}-${Date.now()}.trace.json`);
+  }
+  const child = spawn(
+    path.join(__dirname, 'libsc/outputs/libsc_sample.x86_64'),
+    // The change set goes through stdin: point clouds easily exceed the argument size limit.
+    [path.join(__dirname, 'libsc/outputs/modelCache'), modelname, '-'],
+    {
+      env: env,
+    }
+  );
+  // The child may exit before it has read the whole change set (superseded, or a failed start);
+  // the resulting EPIPE is expected and must not take the server down.
+  child.stdin.on('error', (err) => {
+    console.log(`Change set for ${modelname} not fully delivered: ${err.code || err.message}`);
+  });
+  child.stdin.end(libSCdataJSON);
+
+  let lineBuffer = "";
+
+  child.stdout.on('data', (data) => {
+    lineBuffer += data.toString();
+
+    var lines = lineBuffer.split('\n');
+
+    for (var i = 0; i < lines.length - 1; i++) {
+      var line = lines[i];
+
+      forwardLibscLine(socket, line);
+    }
+
+    lineBuffer = lines[lines.length - 1];
+  });
+
+  child.stdout.on('end', () => {
+    console.log(lineBuffer);
+    forwardLibscLine(socket, lineBuffer);
+  });
+
+  child.on('close', (code, signal) => {
+    if (code === AuthoringScheduler.EXIT_CANCELLED) {
+      console.log(`Authoring of ${modelname} superseded by a newer change set.`);
+    } else if (code === null) {
+      console.log(`Authoring of ${modelname} stopped by ${signal}.`);
+    } else if (code === AuthoringScheduler.EXIT_INVALID) {
+      console.log(`Change set for ${modelname} rejected by validation.`);
+    } else if (code === AuthoringScheduler.EXIT_ROLLED_BACK) {
+      console.log(`Change set for ${modelname} rolled back after a failed operation.`);
+    }
+  });
+
+  return child;
+}
+
+// Queue depth and job counters for the authoring pool.
+app.get('/metrics/authoring', (req, res) => {
+  res.json(scheduler.metrics());
+});
 
 // Serve the build
 // app.get('/', function (req, res) {
@@ -25,34 +152,10 @@ io.on('connection', (socket) => {
 
   socket.on('sc_update_to_author', (libSCdataJSON) => {
     console.log(libSCdataJSON);
-    const child = spawn(
-      path.join(__dirname, 'libsc/outputs/libsc_sample.x86_64'),
-      [path.join(__dirname, 'libsc/outputs/modelCache'), libscModel, libSCdataJSON],
-      {
-        env: { LD_LIBRARY_PATH: path.join(__dirname, '/libsc/bin/macos/') },
-      }
-    );
-
-	let lineBuffer = "";
-
-    child.stdout.on('data', (data) => {
-      lineBuffer += data.toString();
-	
-      var lines = lineBuffer.split('\n');
-
-      for (var i = 0; i < lines.length - 1; i++) {
-        var line = lines[i];
-
-        socket.emit('libscstdout', line);
-      }
-
-      lineBuffer = lines[lines.length - 1];
-    });
-
-    child.stdout.on('end', () => {
-      console.log(lineBuffer);
-      socket.emit('libscstdout', lineBuffer);
-    });
+    const status = scheduler.submit(libscModel, { socket: socket, libSCdataJSON: libSCdataJSON });
+    if (status === 'rejected') {
+      socket.emit('libscstdout', 'Server busy: change set rejected, please retry shortly.');
+    }
   });
 
   socket.on('setModel', (modelname) => {
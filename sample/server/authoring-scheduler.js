@@ -0,0 +1,152 @@
+var os = require('os');
+
+// Schedules libsc authoring jobs onto a fixed number of workers.
+//
+// Jobs for the same model never run concurrently (they share the model's .orig files and output
+// cache), while jobs for different models spread across the workers. Each model holds at most one
+// running and one pending job: a newer change set replaces the pending one and asks the running
+// process to stop at its next checkpoint. Models waiting for a worker sit in a bounded FIFO queue;
+// once it is full new work is rejected instead of piling up behind the workers.
+class AuthoringScheduler {
+  constructor(options) {
+    // Each libsc process also runs its mesh stages on several threads (SC_UPDATE_THREADS), so by
+    // default the cores are shared as a few processes of about four threads each.
+    this.workers = options.workers || AuthoringScheduler.defaultWorkers();
+    this.maxQueued = options.maxQueued || this.workers * 4;
+    this.launch = options.launch;
+    this.onSuperseded = options.onSuperseded || (() => {});
+
+    this.models = new Map();
+    this.readyQueue = [];
+    this.running = 0;
+    this.counters = {
+      submitted: 0,
+      started: 0,
+      completed: 0,
+      cancelled: 0,
+      superseded: 0,
+      rejected: 0,
+      invalid: 0,
+      rolledBack: 0,
+    };
+    this.maxQueueDepth = 0;
+  }
+
+  // Returns 'started', 'queued', 'superseding' (the model is busy and its running job was asked
+  // to stop) or 'rejected' (the queue is full).
+  submit(modelname, job) {
+    this.counters.submitted++;
+    let slot = this.models.get(modelname);
+    if (!slot) {
+      slot = { child: undefined, pending: undefined, queued: false };
+      this.models.set(modelname, slot);
+    }
+
+    if (slot.child !== undefined || slot.queued) {
+      this._replacePending(slot, modelname, job);
+      if (slot.child !== undefined) {
+        slot.child.kill('SIGUSR1');
+        return 'superseding';
+      }
+      return 'queued';
+    }
+
+    if (this.running < this.workers) {
+      this._start(slot, modelname, job);
+      return 'started';
+    }
+
+    if (this.readyQueue.length >= this.maxQueued) {
+      this.counters.rejected++;
+      if (slot.pending === undefined) this.models.delete(modelname);
+      return 'rejected';
+    }
+
+    slot.pending = job;
+    this._enqueue(slot, modelname);
+    return 'queued';
+  }
+
+  static defaultWorkers() {
+    return Math.max(1, Math.floor(os.cpus().length / AuthoringScheduler.THREADS_PER_WORKER));
+  }
+
+  metrics() {
+    return {
+      workers: this.workers,
+      running: this.running,
+      queueDepth: this.readyQueue.length,
+      maxQueued: this.maxQueued,
+      maxQueueDepth: this.maxQueueDepth,
+      activeModels: this.models.size,
+      ...this.counters,
+    };
+  }
+
+  _replacePending(slot, modelname, job) {
+    if (slot.pending !== undefined) {
+      this.counters.superseded++;
+      this.onSuperseded(modelname, slot.pending);
+    }
+    slot.pending = job;
+  }
+
+  _enqueue(slot, modelname) {
+    slot.queued = true;
+    this.readyQueue.push(modelname);
+    this.maxQueueDepth = Math.max(this.maxQueueDepth, this.readyQueue.length);
+  }
+
+  _start(slot, modelname, job) {
+    this.running++;
+    this.counters.started++;
+    slot.child = this.launch(modelname, job);
+    slot.child.on('close', (code) => this._finished(slot, modelname, code));
+  }
+
+  _finished(slot, modelname, code) {
+    this.running--;
+    slot.child = undefined;
+    // A null code means the process died from a signal, in practice the SIGUSR1 of a supersede.
+    if (code === AuthoringScheduler.EXIT_CANCELLED || code === null) {
+      this.counters.cancelled++;
+    } else if (code === AuthoringScheduler.EXIT_INVALID) {
+      this.counters.invalid++;
+    } else if (code === AuthoringScheduler.EXIT_ROLLED_BACK) {
+      this.counters.rolledBack++;
+    } else {
+      this.counters.completed++;
+    }
+
+    // The model goes to the back of the queue so a busy model cannot starve the others.
+    if (slot.pending !== undefined) {
+      this._enqueue(slot, modelname);
+    } else {
+      this.models.delete(modelname);
+    }
+    this._dispatch();
+  }
+
+  _dispatch() {
+    while (this.running < this.workers && this.readyQueue.length > 0) {
+      const modelname = this.readyQueue.shift();
+      const slot = this.models.get(modelname);
+      const job = slot.pending;
+      slot.pending = undefined;
+      slot.queued = false;
+      this._start(slot, modelname, job);
+    }
+  }
+}
+
+// Cores per libsc process when LIBSC_WORKERS is not set.
+AuthoringScheduler.THREADS_PER_WORKER = 4;
+
+// libsc_sample exits with this status when it stops at a cancellation checkpoint.
+AuthoringScheduler.EXIT_CANCELLED = 2;
+// ... and with this one when it rejects a change set before touching the model.
+AuthoringScheduler.EXIT_INVALID = 3;
+// ... and with this one when an operation failed during apply and nothing was published.
+AuthoringScheduler.EXIT_ROLLED_BACK = 4;
+
+module.exports = { AuthoringScheduler };
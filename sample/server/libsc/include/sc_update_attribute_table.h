@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include "sc_assemblytree.h"
+#include "sc_update_intern.h"
+#include <gason.h>
+
+// One entry of the "attributeTables" category:
+//
+//   "attributeTables":[{"file":"plm-export.tsv","keyAttribute":"PartNumber","delimiter":"\t"}]
+//
+// imports a side file of key,attribute,value rows (a PLM export) instead of sending every
+// attribute through the "attributes" array. file is relative to the attribute directory
+// (SC_UPDATE_ATTRIBUTE_DIR, default <model folder>/attributes). Rows are matched to nodes by the
+// value of their keyAttribute (default PartNumber) Attr in the model's XML; every node carrying
+// that value gets the attribute. delimiter defaults to a tab for .tsv/.tab files and to the
+// first of tab or comma found on the first line otherwise.
+struct AttributeTableSource
+{
+    std::string file;
+    std::string key_attribute = "PartNumber";
+    char delimiter = 0;
+};
+
+bool ReadAttributeTableSources(JsonValue const &tables, std::vector<AttributeTableSource> &out, std::string &error);
+
+std::string AttributeTableDirectory(std::string const &model_folder);
+
+// Joins directory and file, rejecting absolute paths and ".." components.
+bool ResolveAttributeTablePath(std::string const &directory, std::string const &file, std::string &path, std::string &error);
+
+// Node ids by the value of one attribute, read from an assembly tree XML in a single pass. An Attr
+// belongs to the innermost tree node that encloses it (see IsAssemblyNodeElement()); attributes of
+// a Face or Edge go to the enclosing node.
+class AttributeKeyIndex
+{
+public:
+    bool Load(std::string const &xml_path, std::string const &key_attribute, std::string &error);
+
+    std::string const &KeyAttribute() const { return _key_attribute; }
+    size_t Size() const { return _nodes.size(); }
+
+    // Nodes carrying key, or nullptr. Safe to call from worker threads once loaded.
+    std::vector<SC::Store::NodeId> const *Find(std::string const &key) const;
+
+private:
+    std::string _key_attribute;
+    StringPool _keys;
+    std::unordered_map<char const *, std::vector<SC::Store::NodeId>> _nodes; // By interned key.
+};
+
+struct AttributeTableResult
+{
+    size_t rows = 0;       // Data rows, header excluded.
+    size_t attributes = 0; // AddAttribute calls that succeeded.
+    size_t unresolved = 0; // Rows whose key no node carries.
+    size_t malformed = 0;
+    size_t failed = 0;     // AddAttribute calls the tree rejected.
+    std::vector<std::string> errors; // The first few problems, with line numbers.
+};
+
+// Maps the table at path and parses it in parallel chunks of whole lines; rows are then applied
+// with AddAttribute on the calling thread, in file order. Quoted fields ("a, ""b""") are
+// supported but may not span lines. Returns false if the file could not be read.
+bool ImportAttributeTable(SC::Store::AssemblyTree &assembly_tree, AttributeKeyIndex const &index, std::string const &path,
+                          char delimiter, AttributeTableResult &result, std::string &error);
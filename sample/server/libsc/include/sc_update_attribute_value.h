@@ -0,0 +1,27 @@
+#pragma once
+
+#include "sc_assemblytree.h"
+#include <gason.h>
+
+// A change-set attribute value with the AssemblyTree type it maps to. AddAttribute only takes
+// text, so text holds the value in the canonical form of its type.
+//
+//   JSON number, integral     AttributeTypeInt    "42"
+//   JSON number, otherwise    AttributeTypeFloat  "0.25"
+//   true / false              AttributeTypeInt    "1" / "0"
+//   ISO 8601 date string      AttributeTypeTime   "2021-10-22" or "2021-10-22T08:30:00Z", as sent
+//   any other string          AttributeTypeString as sent
+struct TypedAttributeValue
+{
+    SC::Store::AssemblyTree::AttributeType type = SC::Store::AssemblyTree::AttributeTypeUndefined;
+    char const *text = nullptr; // Points into the JSON buffer for strings, else into buffer.
+    char buffer[32];
+};
+
+// Returns false for null, arrays and objects.
+bool ReadTypedAttributeValue(JsonValue const &value, TypedAttributeValue &out);
+
+// YYYY-MM-DD, optionally followed by THH:MM[:SS[.fraction]] and Z or +HH:MM / -HH:MM.
+bool IsIsoDate(char const *text);
+
+char const *AttributeTypeName(SC::Store::AssemblyTree::AttributeType type);
@@ -0,0 +1,71 @@
+#pragma once
+
+#include <stddef.h>
+#include <unordered_map>
+#include <vector>
+
+#include "sc_assemblytree.h"
+#include "sc_store.h"
+
+// Axis aligned bounds, empty until the first point is added.
+struct Bounds
+{
+    bool empty = true;
+    SC::Store::Point min;
+    SC::Store::Point max;
+
+    void Add(SC::Store::Point const &point_min, SC::Store::Point const &point_max);
+    void Add(Bounds const &that);
+
+    SC::Store::BBox ToBBox() const;
+};
+
+// Adds points to bounds. Runs four points per iteration on SSE / NEON where available.
+void AddPointBounds(SC::Store::Point const *points, size_t count, Bounds &bounds);
+
+// Bounds of the 8 corners of bounds after matrix.
+Bounds TransformBounds(Bounds const &bounds, SC::Store::Matrix3d const &matrix);
+
+// SC_UPDATE_VERIFY_BOUNDS=1 cross-checks the authored bounds against Model::ComputeBounding()
+// after PrepareStream(). Off by default: it walks the whole prepared model.
+bool BoundsVerificationFromEnvironment();
+
+// Bounds of the nodes authored by one change set, rolled up the parent chain.
+//
+// Nodes are added as they are created, so every tracked parent is added before its children.
+// Apply() then sums the bounds of each node's own bodies and of its children (moved into its
+// frame by their local transforms) and writes them with AssemblyTree::SetBoundingBox(). Parents
+// that existed before the change set are not tracked: their content is unknown here.
+class NodeBoundsRollup
+{
+public:
+    void AddNode(SC::Store::NodeId node_id, SC::Store::NodeId parent_node_id);
+    void AddContent(SC::Store::NodeId node_id, Bounds const &bounds);
+    void SetLocalTransform(SC::Store::NodeId node_id, SC::Store::Matrix3d const &matrix);
+
+    // Returns the number of nodes given a bounding box.
+    size_t Apply(SC::Store::AssemblyTree &assembly_tree);
+
+    // Union of the rolled up bounds of the top level authored nodes, in their parents' frames.
+    // Valid after Apply().
+    Bounds const &Total() const { return _total; }
+
+private:
+    struct Node
+    {
+        SC::Store::NodeId node_id;
+        SC::Store::NodeId parent_node_id;
+        size_t parent; // Index into _nodes, or no_parent for untracked parents.
+        bool has_local_transform;
+        SC::Store::Matrix3d local_transform;
+        Bounds bounds;
+    };
+
+    static size_t const no_parent = (size_t)-1;
+
+    Node *Find(SC::Store::NodeId node_id);
+
+    std::vector<Node> _nodes;
+    std::unordered_map<SC::Store::NodeId, size_t> _index;
+    Bounds _total;
+};
@@ -0,0 +1,25 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "sc_update_mesh.h"
+
+// Size limits for one stream unit of authored geometry. Read from SC_UPDATE_CHUNK_VERTICES and
+// SC_UPDATE_CHUNK_BYTES; 0 disables a limit.
+struct ChunkOptions
+{
+    uint32_t max_vertices = 65536;
+    uint64_t max_bytes = 2 * 1024 * 1024;
+};
+
+ChunkOptions ChunkOptionsFromEnvironment();
+
+// Splits a welded mesh that exceeds the chunk limits into spatially coherent sub-meshes: face
+// triangles, polyline pieces and point vertices are sorted along a Morton curve over the mesh
+// bounds and cut into consecutive runs that stay within the limits. Long polylines are cut into
+// pieces that share their end vertices, so a chunk boundary does not open a gap. Each chunk owns
+// only the attribute values it references.
+//
+// Returns false, leaving chunks empty, when the mesh fits in one chunk.
+bool SplitAuthoredMesh(AuthoredMesh const &mesh, ChunkOptions const &options, std::vector<AuthoredMesh> &chunks);
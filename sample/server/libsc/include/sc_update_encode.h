@@ -0,0 +1,27 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sc_update_mesh.h"
+
+// Mesh flags and stored bytes (see AuthoredMeshBytes) of a mesh before and after encoding.
+// bytes_after is filled in by the caller once the encoded mesh has been welded.
+struct EncodingStats
+{
+    uint32_t flags_before = 0, flags_after = 0;
+    uint64_t bytes_before = 0, bytes_after = 0;
+    uint32_t flat_triangles = 0;   // Face triangles whose normals were snapped to one face normal.
+    uint32_t smooth_triangles = 0; // Face triangles that keep per-vertex normals.
+};
+
+// Rewrites the de-indexed streams of a freshly built mesh into the most compact form the viewer
+// renders identically, ahead of welding:
+//
+// - normals are normalized, and the three corner normals of a flat shaded triangle are replaced by
+//   their common face normal, so every triangle of a planar face welds to one value (a cube ends
+//   up with 6 normals);
+// - normal streams without a single non-zero normal and UV streams holding one value only carry
+//   no information and are dropped together with their flag;
+// - an RGBA32 stream holding one color is dropped and the color is recorded in the mesh's
+//   face / line / point UniformColor, to be stored as a mesh material.
+EncodingStats EncodeAuthoredMesh(AuthoredMesh &mesh);
@@ -0,0 +1,54 @@
+#pragma once
+
+#include <stdint.h>
+#include <unordered_map>
+
+#include "sc_store.h"
+#include "sc_update_mesh.h"
+
+// 128-bit content hash of a canonicalized mesh.
+struct MeshContentHash
+{
+    uint64_t high = 0;
+    uint64_t low = 0;
+
+    bool operator==(MeshContentHash const &that) const { return high == that.high && low == that.low; }
+};
+
+struct MeshContentHashHasher
+{
+    size_t operator()(MeshContentHash const &hash) const { return (size_t)(hash.high ^ hash.low); }
+};
+
+// Moves a (welded) mesh so its bounding box starts at the origin and hashes the result. origin
+// receives the translation that places the canonical mesh back where the client authored it.
+//
+// Positions, normals and UVs are hashed with the weld quantization, so copies of the same part
+// pasted at different locations hash equal as long as the float offsets round the same way.
+// Uniform colors are part of the key, since they become the mesh's materials.
+MeshContentHash CanonicalizeAuthoredMesh(AuthoredMesh &mesh, SC::Store::Point &origin);
+
+// Content hash -> MeshKey index of the meshes inserted by one authoring run.
+//
+// Every run starts from the .orig baseline, so MeshKeys inserted by an earlier run do not exist
+// in the model being edited and the index is not kept between runs. A hash match is confirmed by
+// comparing the canonical content before the MeshKey is reused.
+class MeshInstanceIndex
+{
+public:
+    bool Find(MeshContentHash const &hash, AuthoredMesh const &mesh, SC::Store::MeshKey &mesh_key) const;
+
+    // mesh is the canonical mesh stored under mesh_key; it must outlive the index.
+    void Add(MeshContentHash const &hash, AuthoredMesh const &mesh, SC::Store::MeshKey mesh_key);
+
+    size_t Size() const { return _meshes.size(); }
+
+private:
+    struct Entry
+    {
+        AuthoredMesh const *mesh;
+        SC::Store::MeshKey mesh_key;
+    };
+
+    std::unordered_multimap<MeshContentHash, Entry, MeshContentHashHasher> _meshes;
+};
@@ -0,0 +1,53 @@
+#pragma once
+
+#include <memory>
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Hash-consed, arena-backed strings. Intern() returns the same zero terminated pointer for equal
+// text, so interned strings are stored once and compare by pointer. The text lives in large
+// blocks freed with the pool; pointers stay valid when the pool is moved.
+//
+// Intern() is not thread-safe. Find() only reads and may run on several threads at once while
+// nothing is interned; workers that intern keep a pool each.
+class StringPool
+{
+public:
+    explicit StringPool(size_t block_bytes = 64 * 1024);
+
+    StringPool(StringPool &&) = default;
+    StringPool &operator=(StringPool &&) = default;
+
+    char const *Intern(char const *text, size_t length);
+    char const *Intern(std::string const &text) { return Intern(text.data(), text.size()); }
+
+    // The interned copy of text, or nullptr.
+    char const *Find(char const *text, size_t length) const;
+    char const *Find(std::string const &text) const { return Find(text.data(), text.size()); }
+
+    size_t Count() const { return _count; }
+    size_t Bytes() const { return _bytes; } // Text bytes stored, terminators included.
+
+private:
+    struct Slot
+    {
+        char const *text;
+        uint32_t length;
+        uint32_t hash;
+    };
+
+    static uint32_t Hash(char const *text, size_t length);
+    Slot const *Lookup(char const *text, size_t length, uint32_t hash) const;
+    void Grow();
+    char *Allocate(size_t bytes);
+
+    size_t _block_bytes;
+    std::vector<std::unique_ptr<char[]>> _blocks;
+    char *_cursor = nullptr;
+    size_t _remaining = 0;
+    size_t _bytes = 0;
+    std::vector<Slot> _slots; // Open addressing, power of two size; empty slots have no text.
+    size_t _count = 0;
+};
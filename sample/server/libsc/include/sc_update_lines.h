@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sc_store_utils.h"
+#include "sc_update_mesh.h"
+#include <gason.h>
+
+// Whether and how polylines are tessellated into solid strokes. The defaults come from
+// SC_UPDATE_LINE_THICKNESS (0 keeps polylines as lines) and SC_UPDATE_LINE_CAPS ("round" or
+// "none"); a mesh entry overrides them with
+//
+//   "lineStroke":{"thickness":0.5,"cap":"round"}
+struct LineStrokeOptions
+{
+    float thickness = 0.0f;
+    SC::Store::Utils::LineCap begin_cap = SC::Store::Utils::LineCap::Round;
+    SC::Store::Utils::LineCap end_cap = SC::Store::Utils::LineCap::Round;
+    float steps_per_circle = 16.0f;
+};
+
+LineStrokeOptions LineStrokeOptionsFromEnvironment();
+
+// Reads the "lineStroke" of a mesh entry, if any, on top of defaults.
+bool ReadLineStroke(JsonValue const &mesh_template, LineStrokeOptions const &defaults, LineStrokeOptions &options,
+                    std::string &error);
+
+// One polyline tessellated into a flat ribbon. Utils::CreateThickLine works in the xy plane, so
+// the polyline is tessellated in its own best-fit plane and mapped back; non-planar polylines are
+// flattened onto that plane.
+struct TessellatedStroke
+{
+    uint32_t element = 0; // Index into mesh.polyline_elements.
+    bool valid = false;
+    std::vector<SC::Store::Point> points;
+    std::vector<uint32_t> triangles;
+    SC::Store::Normal normal;
+    bool has_color = false;
+    SC::Store::RGBA32 color; // Color of the polyline's first vertex.
+};
+
+// Tessellates one polyline of mesh. Pure computation, safe to run on worker threads.
+void TessellateStroke(AuthoredMesh const &mesh, LineStrokeOptions const &options, TessellatedStroke &stroke);
+
+// Moves all valid strokes into strokes_mesh as one two-sided face element (one normal and color
+// per stroke) and removes their polylines from mesh. Returns false if no stroke was valid.
+bool MergeStrokes(AuthoredMesh &mesh, std::vector<TessellatedStroke> &strokes, AuthoredMesh &strokes_mesh);
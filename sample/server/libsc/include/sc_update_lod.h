@@ -0,0 +1,26 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "sc_update_mesh.h"
+
+// Level-of-detail generation for authored meshes. Disabled unless SC_UPDATE_LOD_LEVELS is set.
+struct LodOptions
+{
+    unsigned levels = 0;            // Reduced levels per mesh (SC_UPDATE_LOD_LEVELS, at most 3).
+    float ratio = 0.35f;            // Triangle count of each level relative to the previous one.
+    uint32_t min_triangles = 2048;  // Smaller meshes are stored without levels.
+};
+
+LodOptions LodOptionsFromEnvironment();
+
+// Builds up to options.levels decimated copies of a mesh, highest detail first, with quadric
+// error edge collapses (Garland-Heckbert) that keep vertices in place: a collapsed vertex moves
+// onto the neighbour that adds the least error, so every level reuses the mesh's own points and
+// attributes. Boundary and non-manifold edges are never collapsed and collapses that would flip a
+// triangle are rejected. Polylines and points are copied to every level unchanged.
+//
+// Levels that cannot be reduced enough are dropped, so lods may end up shorter than requested.
+// Only reads mesh, so it can run on a ParallelFor worker.
+void BuildMeshLods(AuthoredMesh const &mesh, LodOptions const &options, std::vector<AuthoredMesh> &lods);
@@ -0,0 +1,57 @@
+#pragma once
+
+#include <stdint.h>
+#include <vector>
+
+#include "sc_assemblytree.h"
+#include "sc_store.h"
+#include "sc_update_mesh.h"
+
+// Measurement data derivation for authored meshes. Disabled when SC_UPDATE_MEASURE_TOLERANCE is 0.
+struct MeasurementOptions
+{
+    float angle_tolerance = 1.0f; // Degrees two normals of one plane or cylinder may differ by (SC_UPDATE_MEASURE_TOLERANCE).
+    uint32_t min_cylinder_triangles = 8;
+};
+
+MeasurementOptions MeasurementOptionsFromEnvironment();
+
+struct FaceMeasurement
+{
+    enum Kind
+    {
+        Plane,
+        Cylinder
+    };
+
+    uint32_t face = 0; // Index into mesh.face_elements.
+    Kind kind = Plane;
+    SC::Store::Point origin; // Plane: area weighted centroid. Cylinder: axis point at the face's lowest extent.
+    SC::Store::Vector normal; // Plane normal or cylinder axis.
+    float radius = 0.0f;
+};
+
+struct EdgeMeasurement
+{
+    uint32_t edge = 0; // Index into mesh.polyline_elements.
+    float length = 0.0f;
+};
+
+struct MeasurementData
+{
+    std::vector<FaceMeasurement> faces;
+    std::vector<EdgeMeasurement> edges;
+
+    bool Empty() const { return faces.empty() && edges.empty(); }
+};
+
+// Classifies every face element of mesh as a plane (all triangle normals within the tolerance of
+// their average), a cylinder (all normals perpendicular to one axis and every corner on one circle
+// around it) or neither, and every polyline element as a straight edge or not. Recognized elements
+// get the matching SelectionBits in mesh.mesh.face_elements_bits / polyline_elements_bits, so run
+// this on the final mesh, before it is hashed and inserted. Pure computation, safe to run on worker
+// threads.
+void DeriveMeasurementData(AuthoredMesh &mesh, MeasurementOptions const &options, MeasurementData &data);
+
+// Writes data onto a body node of the assembly tree. Returns the number of faces and edges set.
+size_t SetMeasurementData(SC::Store::AssemblyTree &assembly_tree, SC::Store::NodeId body_node_id, MeasurementData const &data);
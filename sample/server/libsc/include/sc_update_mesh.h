@@ -0,0 +1,90 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sc_store.h"
+#include <gason.h>
+
+// A color shared by every vertex of one element type. EncodeAuthoredMesh() moves it out of the
+// RGBA32 stream and the mesh carries it as its face / line / point material instead.
+struct UniformColor
+{
+    bool set = false;
+    SC::Store::RGBA32 rgba;
+};
+
+// A mesh authored from the "meshes" category of a change set.
+//
+// The SC::Store::Mesh only references its attribute arrays, so AuthoredMesh owns them and Bind()
+// points the mesh at them right before it is inserted. Face, polyline and point elements index
+// the arrays in the order point, normal, UV, RGBA32 for the attributes enabled in mesh.flags.
+class AuthoredMesh
+{
+public:
+    int node_id = 0;        // Viewer node id of the mesh instance (client side, may be negative).
+    int parent_node_id = 0; // Assembly tree node the mesh is created under.
+
+    std::vector<SC::Store::Point> points;
+    std::vector<SC::Store::Normal> normals;
+    std::vector<SC::Store::UV> uvs;
+    std::vector<SC::Store::RGBA32> rgba32s;
+
+    SC::Store::Mesh mesh;
+
+    // Transform of the mesh node relative to its parent, from "localTransform". The geometry stays
+    // in the node's frame; the transform is set on the node.
+    bool has_local_transform = false;
+    SC::Store::Matrix3d local_transform;
+
+    UniformColor face_color;
+    UniformColor line_color;
+    UniformColor point_color;
+
+    // Axis aligned bounds of points, in the node's frame. Set by ComputeBounds().
+    SC::Store::Point bounds_min;
+    SC::Store::Point bounds_max;
+
+    SC::Store::Mesh const &Bind();
+    void ComputeBounds();
+};
+
+// Number of indices per face / polyline / point vertex for the given mesh flags.
+uint32_t FaceIndexStride(SC::Store::Mesh::Bits flags);
+uint32_t LineIndexStride(SC::Store::Mesh::Bits flags);
+uint32_t PointIndexStride(SC::Store::Mesh::Bits flags);
+
+// Attribute array an index refers to.
+enum MeshAttribute
+{
+    PointAttribute,
+    NormalAttribute,
+    UVAttribute,
+    RGBA32Attribute,
+    MeshAttributeCount
+};
+
+// The attribute each index slot of one element type refers to, in index order.
+struct IndexLayout
+{
+    MeshAttribute slots[4];
+    uint32_t stride;
+};
+
+IndexLayout FaceIndexLayout(SC::Store::Mesh::Bits flags);
+IndexLayout LineIndexLayout(SC::Store::Mesh::Bits flags);
+IndexLayout PointIndexLayout(SC::Store::Mesh::Bits flags);
+
+// Bytes of attribute values and indices Model::Insert stores for the mesh.
+uint64_t AuthoredMeshBytes(AuthoredMesh const &mesh);
+
+// Builds a mesh from one entry of the "meshes" array, as produced by scUpdate.updateMeshes():
+//
+//   {"nodeId":-64,"parentNodeId":2,"localTransform":[16 numbers],"faces":[{"position":[...],"normal":[...],"rgba":[...],"uv":[...]}],
+//    "lines":[...],"points":[...],"winding":1,"isTwoSided":false,"isManifold":true}
+//
+// Faces are de-indexed triangle lists, lines are segment lists (consecutive segments sharing an
+// end point are chained into one polyline) and points are point lists. Every attribute buffer is
+// allocated once, sized from the array lengths. "polygons" are left to ReadPolygonFaces(); an entry
+// with only polygons builds an empty mesh. Returns false and sets error on malformed input.
+bool BuildAuthoredMesh(JsonValue const &mesh_template, AuthoredMesh &out, std::string &error);
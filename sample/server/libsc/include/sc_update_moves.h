@@ -0,0 +1,80 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+#include <gason.h>
+
+// One entry of the "moves" category:
+//
+//   "moves":[{"nodeId":12,"parentNodeId":3,"keepWorldTransform":true}]
+//
+// reparents node 12, with its subtree, under ProductOccurence 3. keepWorldTransform (default true)
+// recomposes the node's local matrix so it stays where it is in world space.
+struct NodeMove
+{
+    uint32_t node_id = 0;
+    uint32_t parent_node_id = 0;
+    bool keep_world_transform = true;
+};
+
+bool ReadNodeMoves(JsonValue const &moves, std::vector<NodeMove> &out, std::string &error);
+
+// The ProductOccurence structure of an assembly tree XML, indexed in one pass over the text.
+//
+// AssemblyTree has no reparenting, so moves are applied to the XML before it is deserialized. A
+// move only edits the Children lists of the old and new parent and the node's own
+// RelativeTransfo; the subtree below comes along unchanged. Write() splices all edits into the
+// text in one pass, so the cost is one read and one write of the XML plus O(depth) per move.
+class AssemblyXml
+{
+public:
+    bool Load(std::string text, std::string &error);
+
+    bool Move(NodeMove const &move, std::string &error);
+
+    std::string Write() const;
+
+private:
+    // Column-vector affine transform: x, y, z axes, then translation.
+    struct Affine
+    {
+        double m[12];
+    };
+
+    struct Occurrence
+    {
+        size_t start_tag_end = 0;          // Offset of the '>' or "/>" closing the start tag.
+        bool self_closing = false;
+        size_t children_attribute = 0;     // Offset of the space before Children=, if any.
+        size_t children_begin = 0, children_end = 0;
+        bool has_children_attribute = false;
+        size_t transform_begin = 0, transform_end = 0; // RelativeTransfo value, if any.
+        bool has_transform = false;
+        bool has_parent = false;
+        uint32_t parent = 0;
+        std::vector<uint32_t> children;
+        bool children_dirty = false;
+        Affine local = {{1, 0, 0, 0, 1, 0, 0, 0, 1, 0, 0, 0}}; // Only read once local_dirty is set.
+        bool local_dirty = false;
+    };
+
+    static Affine Identity();
+    static Affine Compose(Affine const &a, Affine const &b);
+    static bool Invert(Affine const &a, Affine &inverse);
+
+    Affine Local(Occurrence const &occurrence) const;
+    Affine World(uint32_t node_id);
+
+    std::string _text;
+    std::unordered_map<uint32_t, Occurrence> _occurrences;
+    std::unordered_map<uint32_t, Affine> _worlds;
+};
+
+// Applies moves to the XML at xml_path and writes the result to moved_xml_path. Moves that fail
+// are skipped and described in errors. Returns false if the XML itself could not be processed.
+bool ApplyNodeMoves(std::string const &xml_path, std::string const &moved_xml_path, std::vector<NodeMove> const &moves,
+                    size_t &moved, std::vector<std::string> &errors);
@@ -0,0 +1,16 @@
+#pragma once
+
+#include <functional>
+#include <stddef.h>
+
+// Number of worker threads used for parallel stages: SC_UPDATE_THREADS if set, otherwise the
+// number of hardware threads. Several libsc processes may run at once (see LIBSC_WORKERS on the
+// server), in which case the server hands each one its share of the cores through this variable.
+unsigned ParallelWorkerCount();
+
+// Calls body(i) for every i in [0, count), spread over up to ParallelWorkerCount() threads
+// (the calling thread included). Items are handed out one at a time, so uneven items balance
+// out. body must only touch state owned by item i; the SC::Store API is not thread-safe and must
+// not be called from it. The first exception thrown by body is rethrown on the calling thread
+// once every worker has stopped.
+void ParallelFor(size_t count, std::function<void(size_t)> const &body);
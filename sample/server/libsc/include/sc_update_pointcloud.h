@@ -0,0 +1,56 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+#include "sc_store.h"
+#include <gason.h>
+
+// Points per CreatePointMeshes batch. Read from SC_UPDATE_POINT_BATCH; 0 means one batch.
+struct PointCloudOptions
+{
+    size_t batch_points = 262144;
+};
+
+PointCloudOptions PointCloudOptionsFromEnvironment();
+
+// A run of consecutive points of a bucketed cloud, inserted with one CreatePointMeshes call.
+struct PointCloudBatch
+{
+    size_t begin = 0;
+    size_t count = 0;
+    SC::Store::Point bounds_min;
+    SC::Store::Point bounds_max;
+};
+
+// One entry of the "pointClouds" category:
+//
+//   {"nodeId":-80,"parentNodeId":2,"localTransform":[16 numbers],
+//    "position":[x,y,z,...],"rgba":[r,g,b,a,...]}
+//
+// Large scans can send "positionData" (base64 of little endian float32 x,y,z) and "rgbaData"
+// (base64 of uint8 r,g,b,a) instead of the number arrays. Colors are optional and per point.
+class PointCloud
+{
+public:
+    int node_id = 0;
+    int parent_node_id = 0;
+    bool has_local_transform = false;
+    SC::Store::Matrix3d local_transform;
+
+    std::vector<SC::Store::Point> points;
+    std::vector<SC::Store::RGBA32> rgba32s;
+};
+
+// Decodes a point cloud straight into its contiguous point and color buffers. Returns false and
+// sets error on malformed input.
+bool BuildPointCloud(JsonValue const &cloud_template, PointCloud &out, std::string &error);
+
+// Checks that every position of a point cloud entry decodes to a finite coordinate, without
+// building the cloud. Used by validation; BuildPointCloud() repeats the check on what it decodes.
+bool CheckPointCloudPositions(JsonValue const &cloud_template, std::string &error);
+
+// Sorts the points along a Morton curve over the cloud bounds and cuts them into batches of at most
+// batch_points, so every batch covers a compact region the stream cache can cull on its own.
+void BucketPointCloud(PointCloud &cloud, PointCloudOptions const &options, std::vector<PointCloudBatch> &batches);
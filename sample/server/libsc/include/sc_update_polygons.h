@@ -0,0 +1,38 @@
+#pragma once
+
+#include <string>
+#include <vector>
+
+#include "sc_update_mesh.h"
+#include <gason.h>
+
+// One planar polygon loop of a mesh entry's "polygons" array:
+//
+//   "polygons":[{"position":[x,y,z, ...],"normal":[nx,ny,nz],"rgba":[r,g,b,a]}]
+//
+// position lists the loop's corners once, open or closed. normal and rgba are optional; the normal
+// defaults to the loop's Newell normal.
+struct PolygonFace
+{
+    std::vector<SC::Store::Point> loop;
+    bool has_normal = false;
+    SC::Store::Normal normal;
+    bool has_color = false;
+    SC::Store::RGBA32 color;
+
+    bool valid = false;
+    std::vector<SC::Store::Point> triangles; // Triangle corners from Utils::TriangulateFace.
+};
+
+// Reads the "polygons" array of a mesh entry, if any. Returns false and sets error on malformed input.
+bool ReadPolygonFaces(JsonValue const &mesh_template, std::vector<PolygonFace> &faces, std::string &error);
+
+// Triangulates one polygon with Utils::TriangulateFace. Pure computation, safe to run on worker threads.
+void TriangulatePolygonFace(PolygonFace &face);
+
+// Merges the triangles of all valid polygons into one two-sided face element of polygon_mesh, one
+// normal per polygon and, if any polygon has a color, one color per polygon (opaque white for the
+// others). Returns false if no polygon was valid. The merged mesh is then encoded, welded and
+// split like any other mesh, in that order: encoding first drops constant streams the weld would
+// otherwise have to compare.
+bool MergePolygonFaces(AuthoredMesh const &owner, std::vector<PolygonFace> &faces, AuthoredMesh &polygon_mesh);
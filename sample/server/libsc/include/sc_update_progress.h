@@ -0,0 +1,67 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Structured progress output for authoring runs.
+//
+// Every line written to stdout is a JSON object (NDJSON) carrying an "event" field and a monotonic
+// "t_ms" timestamp measured from process start:
+//
+//   {"event":"log","t_ms":1.204,"level":"info","message":"Opened and Loaded SC Model ..."}
+//   {"event":"begin","t_ms":3.511,"phase":"prepare_stream"}
+//   {"event":"end","t_ms":812.090,"phase":"prepare_stream","duration_ms":808.579,"bytes":0,"count":0}
+//
+// "bytes" and "count" are phase specific (file sizes, change-set entries, meshes, ...).
+
+// Receives finished phases, e.g. so a benchmark harness can aggregate timings in process.
+class ProgressListener
+{
+public:
+    virtual ~ProgressListener() {}
+    virtual void
+    PhaseEnded(const char *phase, double duration_ms, uint64_t bytes, uint64_t count) = 0;
+};
+
+// Milliseconds since process start on a monotonic clock.
+double ProgressNowMs();
+
+// Installs (or clears with nullptr) the listener notified of finished phases.
+void SetProgressListener(ProgressListener *listener);
+
+// When false, events are only delivered to the listener and nothing is written to stdout.
+void SetProgressOutputEnabled(bool enabled);
+
+// Emits a printf-style log line. level is "info", "warning" or "error".
+void ProgressLog(const char *level, const char *format, ...)
+#if defined(__GNUC__)
+    __attribute__((format(printf, 2, 3)))
+#endif
+    ;
+
+// Emits a begin event on construction and an end event with the measured duration when it goes
+// out of scope (or End() is called).
+class ProgressPhase
+{
+public:
+    explicit ProgressPhase(std::string name);
+    ~ProgressPhase();
+
+    ProgressPhase(ProgressPhase const &) = delete;
+    ProgressPhase &operator=(ProgressPhase const &) = delete;
+
+    void SetBytes(uint64_t bytes) { _bytes = bytes; }
+    void AddBytes(uint64_t bytes) { _bytes += bytes; }
+    void SetCount(uint64_t count) { _count = count; }
+    void AddCount(uint64_t count) { _count += count; }
+
+    // Ends the phase early. Subsequent calls (and the destructor) do nothing.
+    void End();
+
+private:
+    std::string _name;
+    double _start_ms;
+    uint64_t _bytes;
+    uint64_t _count;
+    bool _ended;
+};
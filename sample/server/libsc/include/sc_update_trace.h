@@ -0,0 +1,41 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+// Opt-in span tracing for authoring runs, exported as Chrome trace-event JSON (loadable in
+// Perfetto or chrome://tracing).
+//
+// Tracing is enabled by setting SC_UPDATE_TRACE to the output file path. Each thread records
+// finished spans into its own fixed-size ring buffer without locking; when a buffer wraps the
+// oldest spans are dropped. TraceWriteFile() dumps all buffers once the run is over.
+
+// True when SC_UPDATE_TRACE is set. Cheap enough to call on every span.
+bool TraceEnabled();
+
+// Returns a pointer with static lifetime for a dynamically built span name.
+const char *TraceName(std::string const &name);
+
+// Records a finished span. name must have static lifetime (a literal or a TraceName() result).
+// arg is shown as args.id in the trace viewer, negative values are omitted.
+void TraceRecord(const char *name, double begin_ms, double end_ms, int64_t arg = -1);
+
+// Writes every recorded span to the SC_UPDATE_TRACE path. Returns false if tracing is disabled or
+// the file could not be written. Must not race with threads that are still recording.
+bool TraceWriteFile();
+
+// Records a span covering its own lifetime.
+class TraceScope
+{
+public:
+    explicit TraceScope(const char *name, int64_t arg = -1);
+    ~TraceScope();
+
+    TraceScope(TraceScope const &) = delete;
+    TraceScope &operator=(TraceScope const &) = delete;
+
+private:
+    const char *_name;
+    int64_t _arg;
+    double _begin_ms;
+};
@@ -0,0 +1,68 @@
+#pragma once
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "sc_update_intern.h"
+
+// One authoring run as a transaction over the published model files.
+//
+// The run reads the .orig baseline and writes every output to a staged path next to the file it
+// replaces. Commit() renames the staged files over the published ones in the order they were
+// staged; stage the file the viewer loads (.scs) last. Each rename is atomic, so no reader sees a
+// partially written file. The set of files is not replaced atomically: if a rename fails, the
+// files already published are restored from hard links taken beforehand, but a crash between two
+// renames can leave the earlier files new and the later ones old. Anything that ends the
+// run without a commit (a failed operation, cancellation, an exception) removes the staged files
+// instead: the edited tree and model only live in memory and the decompressed working copy, so
+// dropping them is the whole rollback, with no second load from .orig.
+//
+// AssemblyTree has no getters or node removal, so individual operations cannot be inverted in
+// place. The journal records every applied operation and the nodes it created instead, to decide
+// whether the run may commit and to report what was discarded.
+class ChangeTransaction
+{
+public:
+    ChangeTransaction() = default;
+    ChangeTransaction(ChangeTransaction const &) = delete;
+    ChangeTransaction &operator=(ChangeTransaction const &) = delete;
+    ~ChangeTransaction();
+
+    // Path to write instead of published_path: "model.scz" stages as "model.staged.scz".
+    std::string Stage(std::string const &published_path);
+
+    // operation is a short name such as "AddAttribute"; node_id is the client's id, or -1.
+    void Record(char const *operation, int64_t node_id, bool succeeded, std::string const &detail = std::string());
+    void RecordCreated(int64_t node_id) { _created.push_back(node_id); }
+
+    size_t Operations() const { return _journal.size(); }
+    size_t Failures() const { return _failures; }
+    std::vector<int64_t> const &Created() const { return _created; }
+
+    // "operation node: detail" for the first few failed operations.
+    std::vector<std::string> FailureSummary(size_t limit) const;
+
+    bool Commit(std::string &error);
+    void Abort();
+
+private:
+    void RemoveBackups(std::vector<bool> const &replaced) const;
+
+    struct Entry
+    {
+        char const *operation; // Interned.
+        int64_t node_id;
+        bool succeeded;
+        char const *detail; // Interned, failures only.
+    };
+
+    StringPool _strings;
+    std::vector<Entry> _journal;
+    size_t _failures = 0;
+    std::vector<int64_t> _created; // Client ids of the nodes this run added.
+    std::vector<std::pair<std::string, std::string>> _staged; // Staged path, published path.
+    bool _finished = false;
+};
@@ -0,0 +1,49 @@
+#pragma once
+
+#include <stdint.h>
+#include <string>
+#include <unordered_map>
+
+#include "sc_store.h"
+#include <gason.h>
+
+// Reads a node transform as sent by the client: the 16 values of a Communicator.Matrix (column
+// major 4x4, the last row 0 0 0 1) or the 12 values of an SC::Store::Matrix3d. Returns false and
+// sets error on anything else.
+bool ParseLocalTransform(JsonValue const &value, SC::Store::Matrix3d &matrix, std::string &error);
+
+bool IsIdentityTransform(SC::Store::Matrix3d const &matrix);
+
+// Exact bit pattern of a Matrix3d (with -0 folded into +0), used as a cache key.
+struct MatrixBits
+{
+    uint32_t words[12];
+
+    bool operator==(MatrixBits const &that) const;
+};
+
+struct MatrixBitsHasher
+{
+    size_t operator()(MatrixBits const &bits) const;
+};
+
+// Matrix -> MatrixKey cache of one authoring run, so every repeated transform (instance
+// translations, pasted copies moved by the same offset) shares one MatrixKey.
+//
+// Like the MeshInstanceIndex, the cache is not kept between runs: each run starts from the .orig
+// baseline, where the MatrixKeys of earlier runs do not exist.
+class MatrixKeyCache
+{
+public:
+    explicit MatrixKeyCache(SC::Store::Model &model);
+
+    SC::Store::MatrixKey FindOrInsert(SC::Store::Matrix3d const &matrix);
+
+    size_t Size() const { return _matrix_keys.size(); }
+    size_t Hits() const { return _hits; }
+
+private:
+    SC::Store::Model &_model;
+    size_t _hits;
+    std::unordered_map<MatrixBits, SC::Store::MatrixKey, MatrixBitsHasher> _matrix_keys;
+};
@@ -0,0 +1,37 @@
+#pragma once
+
+#include <stddef.h>
+#include <string>
+#include <unordered_set>
+#include <vector>
+
+#include "sc_assemblytree.h"
+#include <gason.h>
+
+// Whether an assembly tree XML element is a tree node (ProductOccurence, PartDefinition, Body,
+// BodyInstance). Other elements with an Id, such as Face and Edge, number things local to a body.
+bool IsAssemblyNodeElement(char const *name, size_t length);
+
+// Ids of the nodes an assembly tree XML defines, read in one pass over its start tags. Much
+// cheaper than DeserializeFromXML, and enough to check the node ids a change set refers to.
+class NodeIndex
+{
+public:
+    bool Load(std::string const &xml_path, std::string &error);
+
+    bool Contains(SC::Store::NodeId node_id) const { return _nodes.count(node_id) != 0; }
+    bool IsOccurrence(SC::Store::NodeId node_id) const { return _occurrences.count(node_id) != 0; }
+    size_t Size() const { return _nodes.size(); }
+
+private:
+    std::unordered_set<SC::Store::NodeId> _nodes;
+    std::unordered_set<SC::Store::NodeId> _occurrences; // ProductOccurence ids.
+};
+
+// Checks a whole parsed change set before the model is touched: categories and entry shapes,
+// node ids against the index (negative ids must be created by an earlier meshes or pointClouds
+// entry), attribute values, transforms, moves, attribute table paths and point cloud positions.
+// Mesh geometry itself is checked when it is prepared. Entries are checked in parallel; errors come back in change set
+// order, as "category[entry]: message". Returns true if there were none.
+bool ValidateChangeSet(JsonValue const &change_set, NodeIndex const &nodes, std::string const &attribute_directory,
+                       std::vector<std::string> &errors);
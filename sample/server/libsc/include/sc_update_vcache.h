@@ -0,0 +1,24 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sc_update_mesh.h"
+
+// Average cache miss ratio (transformed vertices per triangle) of a mesh's faces, before and
+// after OptimizeVertexCache. 3.0 is the worst case (triangle soup), around 0.7 is typical for a
+// well ordered regular mesh.
+struct VertexCacheStats
+{
+    uint32_t triangles = 0;
+    double acmr_before = 0.0;
+    double acmr_after = 0.0;
+};
+
+// Simulated FIFO post-transform cache size used for the reported ACMR.
+const uint32_t VertexCacheSimulatedSize = 16;
+
+// Reorders the triangles of every face element for the GPU post-transform vertex cache
+// (Forsyth's linear-speed algorithm with a 32 entry LRU model), then renumbers the attribute
+// arrays in order of first use for fetch locality. A vertex is a unique index group (point,
+// normal, uv, color), which is what the viewer ends up uploading. Element order is kept.
+VertexCacheStats OptimizeVertexCache(AuthoredMesh &mesh);
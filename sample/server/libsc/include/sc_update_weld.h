@@ -0,0 +1,33 @@
+#pragma once
+
+#include <stdint.h>
+
+#include "sc_update_mesh.h"
+
+// Attribute counts of a mesh before and after welding.
+struct WeldStats
+{
+    uint32_t points_before = 0, points_after = 0;
+    uint32_t normals_before = 0, normals_after = 0;
+    uint32_t uvs_before = 0, uvs_after = 0;
+    uint32_t rgba32s_before = 0, rgba32s_after = 0;
+};
+
+// Quantization shared by welding and mesh content hashing, so both agree on which values are equal.
+const float WeldNormalScale = 32767.0f;
+const float WeldUVScale = 65536.0f;
+float WeldPositionScale(float extent);
+int32_t QuantizeWeldValue(float value, float scale);
+
+// Welds the de-indexed vertex streams of an AuthoredMesh into unique attribute arrays.
+//
+// SC::Store meshes index every attribute separately, so each attribute array is welded on its own:
+// values are quantized (positions to 2^-21 of the largest bounding box extent, normals to 16-bit
+// snorm, UVs to 2^-16, colors exactly), hashed into an open-addressing table, and every element's
+// indices are remapped to the first occurrence of each value. Polyline and point elements are
+// remapped the same way as faces.
+WeldStats WeldAuthoredMesh(AuthoredMesh &mesh);
+
+// Drops attribute values no element references any more (e.g. after triangles were removed) and
+// renumbers the rest in order of first use, so vertex fetches walk the arrays forwards.
+void CompactAuthoredMesh(AuthoredMesh &mesh);
@@ -0,0 +1,473 @@
+// End-to-end authoring benchmark.
+//
+// Generates synthetic change sets of controlled size, runs them through StoreSample against copies
+// of the bundled models and reports p50/p95/p99 per phase plus peak RSS as JSON on stdout. Each
+// scenario runs in a forked child so its peak RSS is not inflated by earlier scenarios.
+//
+// Usage: libsc_bench models_folder work_folder [--models a,b] [--iterations N] [--count N]
+//        [--vertices V]
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/resource.h>
+#include <sys/stat.h>
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include "sc_update_progress.h"
+
+int StoreSample(const std::string &, const std::string &, const std::string &);
+
+struct BenchOptions
+{
+    std::string models_folder;
+    std::string work_folder;
+    std::vector<std::string> models;
+    int iterations = 5;
+    int count = 100;
+    int vertices = 3000;
+};
+
+// Node ids and instance keys harvested from the model XML so generated edits hit real nodes.
+struct BenchModelInfo
+{
+    std::vector<int> product_ids;
+    std::vector<std::pair<int, int>> body_instances; // node id, instance key
+    int root_id = -1;
+    std::vector<int> leaf_ids; // Product occurrences with a parent and no children of their own.
+};
+
+class BenchPhaseCollector : public ProgressListener
+{
+public:
+    virtual void
+    PhaseEnded(const char *phase, double duration_ms, uint64_t, uint64_t)
+    {
+        run_totals[phase] += duration_ms;
+    }
+
+    std::map<std::string, double> run_totals;
+};
+
+static bool
+CopyFile(std::string const &from, std::string const &to)
+{
+    std::ifstream from_stream(from, std::ios::binary);
+    if (!from_stream.good())
+        return false;
+    std::ofstream to_stream(to, std::ios::binary);
+    to_stream << from_stream.rdbuf();
+    return to_stream.good();
+}
+
+static std::string
+ReadFile(std::string const &path)
+{
+    std::ifstream stream(path, std::ios::binary);
+    std::ostringstream contents;
+    contents << stream.rdbuf();
+    return contents.str();
+}
+
+static int
+ReadIntAttribute(std::string const &xml, size_t tag_begin, size_t tag_end, const char *attribute)
+{
+    size_t at = xml.find(attribute, tag_begin);
+    if (at == std::string::npos || at > tag_end)
+        return -1;
+    return atoi(xml.c_str() + at + strlen(attribute));
+}
+
+static BenchModelInfo
+ScanModel(std::string const &xml_path)
+{
+    BenchModelInfo info;
+    std::vector<int> children, childless;
+    std::string xml = ReadFile(xml_path);
+    size_t at = 0;
+    while ((at = xml.find('<', at)) != std::string::npos)
+    {
+        size_t tag_end = xml.find('>', at);
+        if (tag_end == std::string::npos)
+            break;
+        if (xml.compare(at, 18, "<ProductOccurence ") == 0)
+        {
+            int id = ReadIntAttribute(xml, at, tag_end, " Id=\"");
+            if (id > 0)
+                info.product_ids.push_back(id);
+            if (info.root_id < 0)
+                info.root_id = id;
+            size_t children_at = xml.find(" Children=\"", at);
+            if (children_at != std::string::npos && children_at < tag_end)
+            {
+                const char *child = xml.c_str() + children_at + strlen(" Children=\"");
+                for (char *next = nullptr;; child = next)
+                {
+                    long child_id = strtol(child, &next, 10);
+                    if (next == child)
+                        break;
+                    children.push_back((int)child_id);
+                }
+            }
+            else if (id > 0)
+            {
+                childless.push_back(id);
+            }
+        }
+        else if (xml.compare(at, 14, "<BodyInstance ") == 0)
+        {
+            int id = ReadIntAttribute(xml, at, tag_end, " Id=\"");
+            size_t key_at = xml.find(" MeshInstanceKey=\"", at);
+            if (id >= 0 && key_at != std::string::npos && key_at < tag_end)
+            {
+                // MeshInstanceKey is "inclusion instance"; the generator needs the instance key.
+                const char *keys = xml.c_str() + key_at + strlen(" MeshInstanceKey=\"");
+                char *second = nullptr;
+                strtol(keys, &second, 10);
+                info.body_instances.push_back(std::make_pair(id, (int)strtol(second, nullptr, 10)));
+            }
+        }
+        at = tag_end;
+    }
+    // Childless occurrences that are nobody's child are instance prototypes, not tree nodes.
+    std::sort(children.begin(), children.end());
+    for (int id : childless)
+    {
+        if (std::binary_search(children.begin(), children.end(), id))
+            info.leaf_ids.push_back(id);
+    }
+    return info;
+}
+
+static std::string
+GenerateAttributes(BenchModelInfo const &info, int count)
+{
+    std::ostringstream json;
+    json << "{\"attributes\":[";
+    for (int i = 0; i < count; ++i)
+        json << (i ? "," : "") << "{\"nodeId\":" << info.product_ids[i % info.product_ids.size()]
+             << ",\"BenchAttribute" << i << "\":\"Value" << i << "\"}";
+    json << "]}";
+    return json.str();
+}
+
+static std::string
+GenerateRenames(BenchModelInfo const &info, int count)
+{
+    std::ostringstream json;
+    json << "{\"nodeNames\":[";
+    for (int i = 0; i < count; ++i)
+        json << (i ? "," : "") << "{\"nodeId\":" << info.product_ids[i % info.product_ids.size()]
+             << ",\"nodeName\":\"BenchNode" << i << "\"}";
+    json << "]}";
+    return json.str();
+}
+
+static std::string
+GenerateColors(BenchModelInfo const &info, int count)
+{
+    std::ostringstream json;
+    json << "{\"colors\":[";
+    for (int i = 0; i < count; ++i)
+    {
+        std::pair<int, int> const &body = info.body_instances[i % info.body_instances.size()];
+        json << (i ? "," : "") << "{\"nodeId\":" << body.first << ",\"color\":{\"r\":" << (i * 37) % 256
+             << ",\"g\":" << (i * 91) % 256 << ",\"b\":" << (i * 13) % 256 << "},\"scInstanceId\":" << body.second
+             << "}";
+    }
+    json << "]}";
+    return json.str();
+}
+
+// Moves product occurrences by a handful of distinct offsets, so most transforms repeat.
+static std::string
+GenerateTransforms(BenchModelInfo const &info, int count)
+{
+    std::ostringstream json;
+    json << "{\"transforms\":[";
+    for (int i = 0; i < count; ++i)
+        json << (i ? "," : "") << "{\"nodeId\":" << info.product_ids[i % info.product_ids.size()]
+             << ",\"localTransform\":[1,0,0,0,0,1,0,0,0,0,1,0," << (i % 8) * 10 << ",0,0,1]}";
+    json << "]}";
+    return json.str();
+}
+
+// Reparents leaf occurrences under the root, each at most once, so every move takes the XML path
+// through AssemblyXml and recomposes a world transform.
+static std::string
+GenerateMoves(BenchModelInfo const &info, int count)
+{
+    std::ostringstream json;
+    json << "{\"moves\":[";
+    int const moves = std::min<int>(count, (int)info.leaf_ids.size());
+    for (int i = 0; i < moves; ++i)
+        json << (i ? "," : "") << "{\"nodeId\":" << info.leaf_ids[i] << ",\"parentNodeId\":" << info.root_id << "}";
+    json << "]}";
+    return json.str();
+}
+
+// A de-indexed triangle soup over a regular grid, shaped like the viewer's iterate() output.
+static void
+AppendGridMesh(std::ostringstream &json, int node_id, int parent_id, int vertex_count)
+{
+    int quads = std::max(1, vertex_count / 6);
+    int side = 1;
+    while (side * side < quads)
+        ++side;
+
+    std::ostringstream position, normal, rgba;
+    bool first = true;
+    int emitted = 0;
+    for (int y = 0; y < side && emitted < quads; ++y)
+    {
+        for (int x = 0; x < side && emitted < quads; ++x, ++emitted)
+        {
+            int const corners[6][2] = {{x, y}, {x + 1, y}, {x + 1, y + 1}, {x, y}, {x + 1, y + 1}, {x, y + 1}};
+            for (int c = 0; c < 6; ++c)
+            {
+                char const *separator = first ? "" : ",";
+                first = false;
+                position << separator << corners[c][0] << "," << corners[c][1] << "," << ((corners[c][0] * corners[c][1]) % 7);
+                normal << separator << "0,0,1";
+                rgba << separator << (x * 8) % 256 << "," << (y * 8) % 256 << ",128,255";
+            }
+        }
+    }
+
+    json << "{\"nodeId\":" << node_id << ",\"parentNodeId\":" << parent_id << ",\"faces\":[{\"position\":["
+         << position.str() << "],\"normal\":[" << normal.str() << "],\"rgba\":[" << rgba.str()
+         << "],\"uv\":[]}],\"lines\":[],\"points\":[],\"winding\":\"clockwise\",\"isTwoSided\":0,\"isManifold\":0}";
+}
+
+static std::string
+GenerateMeshes(BenchModelInfo const &info, int count, int vertices)
+{
+    std::ostringstream json;
+    json << "{\"meshes\":[";
+    for (int i = 0; i < count; ++i)
+    {
+        if (i)
+            json << ",";
+        AppendGridMesh(json, -(i + 1), info.product_ids[0], vertices);
+    }
+    json << "]}";
+    return json.str();
+}
+
+// A helix of points with per-point colors, count * vertices points in total.
+static std::string
+GeneratePointCloud(BenchModelInfo const &info, int points)
+{
+    std::ostringstream position, rgba;
+    for (int i = 0; i < points; ++i)
+    {
+        char const *separator = i ? "," : "";
+        double const t = i * 0.01;
+        position << separator << 50.0 * std::cos(t) << "," << 50.0 * std::sin(t) << "," << t;
+        rgba << separator << i % 256 << "," << (i / 256) % 256 << ",200,255";
+    }
+    std::ostringstream json;
+    json << "{\"pointClouds\":[{\"nodeId\":-1,\"parentNodeId\":" << info.product_ids[0] << ",\"position\":["
+         << position.str() << "],\"rgba\":[" << rgba.str() << "]}]}";
+    return json.str();
+}
+
+static std::string
+GenerateCamera()
+{
+    return "{\"defaultCamera\":{\"position\":{\"x\":81.2,\"y\":-99.8,\"z\":-14.7},\"target\":{\"x\":42.0,\"y\":28.5,"
+           "\"z\":-45.1},\"up\":{\"x\":0.014,\"y\":0.234,\"z\":0.971},\"width\":137.6,\"height\":137.6,"
+           "\"projection\":0,\"nearLimit\":0.01,\"cameraFlags\":0}}";
+}
+
+static double
+Percentile(std::vector<double> values, double percentile)
+{
+    if (values.empty())
+        return 0.0;
+    std::sort(values.begin(), values.end());
+    // Nearest-rank percentile.
+    size_t rank = (size_t)(percentile / 100.0 * values.size() + 0.999999);
+    rank = std::max<size_t>(1, std::min(rank, values.size()));
+    return values[rank - 1];
+}
+
+static long
+PeakRssKb()
+{
+    struct rusage usage;
+    getrusage(RUSAGE_SELF, &usage);
+#ifdef __APPLE__
+    return usage.ru_maxrss / 1024; // bytes on macOS
+#else
+    return usage.ru_maxrss; // kilobytes on Linux
+#endif
+}
+
+// Runs one scenario and prints its JSON object. Executed in a forked child.
+static void
+RunScenario(BenchOptions const &options, std::string const &model, std::string const &scenario,
+            std::string const &change_set)
+{
+    BenchPhaseCollector collector;
+    SetProgressListener(&collector);
+    SetProgressOutputEnabled(false);
+
+    std::map<std::string, std::vector<double>> samples;
+    int failures = 0;
+    for (int i = 0; i < options.iterations; ++i)
+    {
+        collector.run_totals.clear();
+        if (StoreSample(options.work_folder, model, change_set) != 0)
+            ++failures;
+        for (auto const &phase : collector.run_totals)
+            samples[phase.first].push_back(phase.second);
+    }
+
+    printf("{\"model\":\"%s\",\"scenario\":\"%s\",\"iterations\":%d,\"failures\":%d,\"change_set_bytes\":%zu,"
+           "\"peak_rss_kb\":%ld,\"phases\":{",
+           model.c_str(), scenario.c_str(), options.iterations, failures, change_set.size(), PeakRssKb());
+    bool first = true;
+    for (auto const &phase : samples)
+    {
+        printf("%s\"%s\":{\"p50_ms\":%.3f,\"p95_ms\":%.3f,\"p99_ms\":%.3f,\"samples\":%zu}", first ? "" : ",",
+               phase.first.c_str(), Percentile(phase.second, 50), Percentile(phase.second, 95),
+               Percentile(phase.second, 99), phase.second.size());
+        first = false;
+    }
+    printf("}}");
+    fflush(stdout);
+}
+
+static std::vector<std::string>
+SplitList(std::string const &list)
+{
+    std::vector<std::string> items;
+    std::stringstream stream(list);
+    std::string item;
+    while (std::getline(stream, item, ','))
+        if (!item.empty())
+            items.push_back(item);
+    return items;
+}
+
+static void
+Usage()
+{
+    fprintf(stderr, "Usage: libsc_bench models_folder work_folder [--models a,b] [--iterations N] [--count N] "
+                    "[--vertices V]\n");
+}
+
+int
+main(int argc, char **argv)
+{
+    if (argc < 3)
+    {
+        Usage();
+        return 1;
+    }
+
+    BenchOptions options;
+    options.models_folder = argv[1];
+    options.work_folder = argv[2];
+    options.models = SplitList("microengine,_MOTO_X");
+    for (int i = 3; i + 1 < argc; i += 2)
+    {
+        std::string flag = argv[i];
+        if (flag == "--models")
+            options.models = SplitList(argv[i + 1]);
+        else if (flag == "--iterations")
+            options.iterations = std::max(1, atoi(argv[i + 1]));
+        else if (flag == "--count")
+            options.count = std::max(1, atoi(argv[i + 1]));
+        else if (flag == "--vertices")
+            options.vertices = std::max(3, atoi(argv[i + 1]));
+        else
+        {
+            Usage();
+            return 1;
+        }
+    }
+
+    if (mkdir(options.work_folder.c_str(), 0755) != 0 && errno != EEXIST)
+    {
+        fprintf(stderr, "Could not create work folder %s\n", options.work_folder.c_str());
+        return 1;
+    }
+
+    printf("{\"iterations\":%d,\"count\":%d,\"vertices\":%d,\"results\":[", options.iterations, options.count,
+           options.vertices);
+    fflush(stdout);
+
+    bool first = true;
+    for (std::string const &model : options.models)
+    {
+        std::string source = options.models_folder + "/" + model;
+        std::string target = options.work_folder + "/" + model;
+        // Fresh copies without .orig backups: the first run backs them up and every later run
+        // starts from the same baseline.
+        bool copied = CopyFile(source + ".scz", target + ".scz") && CopyFile(source + ".xml", target + ".xml");
+        CopyFile(source + ".scs", target + ".scs");
+        remove((target + ".scs.orig").c_str());
+        remove((target + ".scz.orig").c_str());
+        remove((target + ".xml.orig").c_str());
+        if (!copied)
+        {
+            fprintf(stderr, "Skipping %s: %s.scz/.xml not found\n", model.c_str(), source.c_str());
+            continue;
+        }
+
+        BenchModelInfo info = ScanModel(target + ".xml");
+        if (info.product_ids.empty() || info.body_instances.empty())
+        {
+            fprintf(stderr, "Skipping %s: no product occurrences or body instances in XML\n", model.c_str());
+            continue;
+        }
+
+        std::vector<std::pair<std::string, std::string>> scenarios;
+        scenarios.push_back(std::make_pair("baseline", std::string("{}")));
+        scenarios.push_back(std::make_pair("attributes", GenerateAttributes(info, options.count)));
+        scenarios.push_back(std::make_pair("renames", GenerateRenames(info, options.count)));
+        scenarios.push_back(std::make_pair("colors", GenerateColors(info, options.count)));
+        scenarios.push_back(std::make_pair("transforms", GenerateTransforms(info, options.count)));
+        scenarios.push_back(std::make_pair("camera", GenerateCamera()));
+        if (info.root_id >= 0 && !info.leaf_ids.empty())
+            scenarios.push_back(std::make_pair("moves", GenerateMoves(info, options.count)));
+        scenarios.push_back(std::make_pair("meshes", GenerateMeshes(info, std::max(1, options.count / 10), options.vertices)));
+        scenarios.push_back(std::make_pair("point_clouds", GeneratePointCloud(info, options.count * options.vertices)));
+
+        for (auto const &scenario : scenarios)
+        {
+            if (!first)
+                printf(",");
+            first = false;
+            printf("\n");
+            fflush(stdout);
+
+            pid_t child = fork();
+            if (child == 0)
+            {
+                RunScenario(options, model, scenario.first, scenario.second);
+                _exit(0);
+            }
+            int status = 0;
+            waitpid(child, &status, 0);
+            if (!WIFEXITED(status) || WEXITSTATUS(status) != 0)
+                printf("{\"model\":\"%s\",\"scenario\":\"%s\",\"error\":\"benchmark process failed\"}", model.c_str(),
+                       scenario.first.c_str());
+        }
+    }
+
+    printf("\n]}\n");
+    return 0;
+}
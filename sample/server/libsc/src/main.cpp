@@ -2,8 +2,12 @@
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <iterator>
+
+#include "sc_update_trace.h"
 
 int StoreSample(const std::string&, const std::string&, const std::string&);
+void InstallCancelHandler();
 
 void Usage();
 
@@ -21,21 +25,34 @@ main(int argc, char** argv)
     //Test JSON String for executing changes to model file.
     std::string json_update = "{\"meshes\":[{\"nodeId\":-64,\"parentNodeId\":-2,\"faces\":[{\"position\":[-10,10,10,10,10,10,-10,-10,10,10,10,10,10,-10,10,-10,-10,10,10,10,-10,-10,10,-10,-10,-10,-10,10,10,-10,-10,-10,-10,10,-10,-10,-10,10,-10,10,10,-10,10,10,10,-10,10,-10,10,10,10,-10,10,10,-10,-10,-10,10,-10,10,10,-10,-10,-10,-10,-10,-10,-10,10,10,-10,10,-10,10,-10,-10,10,10,-10,-10,-10,-10,10,10,-10,-10,10,-10,-10,-10,10,10,10,10,10,-10,10,-10,-10,10,10,10,10,-10,-10,10,-10,10],\"normal\":[0,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,-1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0,1,0,0],\"rgba\":[],\"uv\":[]}],\"lines\":[],\"points\":[],\"winding\":\"clockwise\",\"isTwoSided\":0,\"isManifold\":0}]}";
     
+    // Before the stdin read: the server may supersede this run while the change set is uploading.
+    InstallCancelHandler();
+
     if(argc > 3) {
         json_update = argv[3];
     }
+    // "-" reads the change set from stdin; large payloads (point clouds) do not fit in argv.
+    if (json_update == "-") {
+        json_update.assign(std::istreambuf_iterator<char>(std::cin), std::istreambuf_iterator<char>());
+    }
 
     //json_update = ""; //Uncomment this and it will simply revert the files back to their original and import/export.
 
-    StoreSample(model_path, modelname, json_update); 
+    int status = StoreSample(model_path, modelname, json_update);
+
+    // Tracing is opt-in through SC_UPDATE_TRACE; this is a no-op otherwise.
+    TraceWriteFile();
+
+    return status;
 
 }
 
 void
 Usage()
 {
-    std::cout << "Usage: libsc_sample model_folder modelname" << std::endl;
+    std::cout << "Usage: libsc_sample model_folder modelname [change_set_json | -]" << std::endl;
     std::cout << "model_folder\tName of output directory." << std::endl;
     std::cout << "modelname\tName of model to author or edit." << std::endl;
+    std::cout << "-\t\tRead the change set JSON from stdin." << std::endl;
 
 }
@@ -3,12 +3,37 @@
 #include <string>
 #include <iostream>
 #include <fstream>
+#include <map>
 #include <unistd.h>
+#include <signal.h>
 
 #include "hoops_license.h"
 #include "sc_store.h"
 #include "sc_assemblytree.h"
+#include "sc_store_utils.h"
+#include "sc_update_attribute_table.h"
+#include "sc_update_attribute_value.h"
+#include "sc_update_bounds.h"
+#include "sc_update_chunk.h"
+#include "sc_update_encode.h"
+#include "sc_update_instancing.h"
+#include "sc_update_lines.h"
+#include "sc_update_lod.h"
+#include "sc_update_measure.h"
+#include "sc_update_mesh.h"
+#include "sc_update_moves.h"
+#include "sc_update_parallel.h"
+#include "sc_update_pointcloud.h"
+#include "sc_update_polygons.h"
+#include "sc_update_vcache.h"
+#include "sc_update_weld.h"
+#include "sc_update_transform.h"
+#include "sc_update_validate.h"
+#include "sc_update_progress.h"
+#include "sc_update_trace.h"
+#include "sc_update_transaction.h"
 #include <gason.h>
+#include <sys/stat.h>
 
 #if 0
 #include "tc_io.h"
@@ -30,10 +55,46 @@ public:
     virtual void
     Message(const char *message) const
     {
-        printf("%s\n", message);
+        ProgressLog("info", "%s", message);
     }
 };
 
+// Set by the SIGUSR1 handler when the server has a newer change set for this model. The authoring
+// run polls it at checkpoints between phases and stops before publishing an obsolete result.
+static volatile sig_atomic_t cancel_requested = 0;
+
+static void
+HandleCancelSignal(int)
+{
+    cancel_requested = 1;
+}
+
+// Exit status reported when a run stops at a cancellation checkpoint.
+static const int StoreSampleCancelled = 2;
+
+// Exit status reported when the change set is rejected before the model is touched.
+static const int StoreSampleInvalid = 3;
+
+// Exit status reported when an operation failed during apply and the run was rolled back.
+static const int StoreSampleRolledBack = 4;
+
+// main() installs the handler before it reads the change set from stdin, so a newer change set
+// arriving during a long upload is seen at the first checkpoint instead of killing the process.
+void
+InstallCancelHandler()
+{
+    signal(SIGUSR1, HandleCancelSignal);
+}
+
+static bool
+CancelRequested(const char *checkpoint)
+{
+    if (!cancel_requested)
+        return false;
+    ProgressLog("warning", "Authoring cancelled after %s. A newer change set superseded this one.", checkpoint);
+    return true;
+}
+
 // Helper function to literally just save a file copy to file.orig
 void backupFiletoOrig(std::string &file_path)
 {
@@ -43,70 +104,277 @@ void backupFiletoOrig(std::string &file_path)
     orig_file_stream << file_path_stream.rdbuf();
 }
 
-// Helper function to literally just save a file.orig back to the original file name
-void revertFilesFromOrig(std::string &file_path)
+static uint64_t
+FileSize(std::string const &file_path)
 {
-    std::string orig_file_path = file_path + ".orig";
-    std::ifstream orig_file_stream(orig_file_path, std::ios::binary);
-    std::ofstream file_path_stream(file_path, std::ios::binary);
-    file_path_stream << orig_file_stream.rdbuf();
+    struct stat file_stat;
+    if (stat(file_path.c_str(), &file_stat) != 0)
+        return 0;
+    return (uint64_t)file_stat.st_size;
+}
+
+// Number of entries in a change-set category: array length, or 1 for a single object.
+static uint64_t
+ChangeEntryCount(JsonValue const &category)
+{
+    if (category.getTag() != JSON_ARRAY)
+        return 1;
+    uint64_t count = 0;
+    for (auto entry : category)
+    {
+        (void)entry;
+        ++count;
+    }
+    return count;
+}
+
+// One stream unit of a prepared mesh: the whole mesh, or one chunk of an oversized one.
+struct PreparedMeshPart
+{
+    AuthoredMesh authored;
+    VertexCacheStats vertex_cache_stats;
+    MeshContentHash content_hash;
+    SC::Store::Point origin;
+    std::vector<AuthoredMesh> lods;
+    MeasurementData measurement;
+};
+
+// One entry of the "meshes" category, built, tessellated, encoded, welded, split and hashed off the
+// main thread and then committed to the store in change-set order.
+struct PreparedMesh
+{
+    JsonValue const *mesh_template = nullptr;
+    bool valid = false;
+    std::string error;
+    int node_id = 0;
+    int parent_node_id = 0;
+    bool has_local_transform = false;
+    SC::Store::Matrix3d local_transform;
+    AuthoredMesh source; // The built mesh, until FinishPreparedMesh() turns it into parts.
+    LineStrokeOptions line_stroke;
+    std::vector<TessellatedStroke> strokes;
+    size_t stroked_polylines = 0;
+    std::vector<PolygonFace> polygons;
+    size_t triangulated_polygons = 0;
+    EncodingStats encoding_stats;
+    WeldStats weld_stats;
+    std::vector<PreparedMeshPart> parts;
+};
+
+// One entry of the "pointClouds" category, decoded and bucketed off the main thread.
+struct PreparedPointCloud
+{
+    JsonValue const *cloud_template = nullptr;
+    bool valid = false;
+    std::string error;
+    PointCloud cloud;
+    std::vector<PointCloudBatch> batches;
+};
+
+struct MeshPreparationOptions
+{
+    LodOptions lod;
+    ChunkOptions chunk;
+    LineStrokeOptions line_stroke;
+    MeasurementOptions measure;
+};
+
+static void
+PreparePart(PreparedMeshPart &part, MeshPreparationOptions const &options)
+{
+    part.authored.ComputeBounds();
+    // In the node's frame, before canonicalization moves the points to the part's origin.
+    DeriveMeasurementData(part.authored, options.measure, part.measurement);
+    part.vertex_cache_stats = OptimizeVertexCache(part.authored);
+    part.content_hash = CanonicalizeAuthoredMesh(part.authored, part.origin);
+    if (options.lod.levels > 0)
+    {
+        TraceScope lod_span("BuildMeshLods");
+        BuildMeshLods(part.authored, options.lod, part.lods);
+        for (AuthoredMesh &lod : part.lods)
+            OptimizeVertexCache(lod);
+    }
+}
+
+static void
+BuildPreparedMesh(PreparedMesh &prepared, MeshPreparationOptions const &options)
+{
+    TraceScope span("BuildAuthoredMesh");
+    if (cancel_requested)
+        return;
+    AuthoredMesh &authored = prepared.source;
+    prepared.valid = BuildAuthoredMesh(*prepared.mesh_template, authored, prepared.error) &&
+                     ReadLineStroke(*prepared.mesh_template, options.line_stroke, prepared.line_stroke, prepared.error) &&
+                     ReadPolygonFaces(*prepared.mesh_template, prepared.polygons, prepared.error);
+    if (!prepared.valid)
+        return;
+    prepared.node_id = authored.node_id;
+    prepared.parent_node_id = authored.parent_node_id;
+    prepared.has_local_transform = authored.has_local_transform;
+    prepared.local_transform = authored.local_transform;
+    if (prepared.line_stroke.thickness > 0.0f)
+    {
+        prepared.strokes.resize(authored.mesh.polyline_elements.size());
+        for (size_t i = 0; i < prepared.strokes.size(); ++i)
+            prepared.strokes[i].element = (uint32_t)i;
+    }
 }
 
+// Encodes, welds and splits one mesh of an entry into stream parts.
 static void
-AddSquareFace(
-    SC::Store::Mesh &mesh,
-    uint32_t const *point_indices,
-    uint32_t normal_index,
-    uint32_t rgba_index)
+AddPreparedParts(PreparedMesh &prepared, AuthoredMesh &authored, MeshPreparationOptions const &options)
 {
-    mesh.face_elements.emplace_back();
-    SC::Store::MeshElement &face = mesh.face_elements.back();
+    EncodingStats encoding_stats = EncodeAuthoredMesh(authored);
+    WeldStats const weld_stats = WeldAuthoredMesh(authored);
+    encoding_stats.bytes_after = AuthoredMeshBytes(authored);
 
-    // Add first face triangle
-    for (size_t i = 0; i < 3; ++i)
+    EncodingStats &encoding = prepared.encoding_stats;
+    encoding.flags_before |= encoding_stats.flags_before;
+    encoding.flags_after |= encoding_stats.flags_after;
+    encoding.bytes_before += encoding_stats.bytes_before;
+    encoding.bytes_after += encoding_stats.bytes_after;
+    encoding.flat_triangles += encoding_stats.flat_triangles;
+    encoding.smooth_triangles += encoding_stats.smooth_triangles;
+    WeldStats &weld = prepared.weld_stats;
+    weld.points_before += weld_stats.points_before, weld.points_after += weld_stats.points_after;
+    weld.normals_before += weld_stats.normals_before, weld.normals_after += weld_stats.normals_after;
+    weld.uvs_before += weld_stats.uvs_before, weld.uvs_after += weld_stats.uvs_after;
+    weld.rgba32s_before += weld_stats.rgba32s_before, weld.rgba32s_after += weld_stats.rgba32s_after;
+
+    std::vector<AuthoredMesh> chunks;
+    if (!SplitAuthoredMesh(authored, options.chunk, chunks))
+        chunks.push_back(std::move(authored));
+    for (AuthoredMesh &chunk : chunks)
     {
-        face.indices.push_back(point_indices[i]);
-        face.indices.push_back(normal_index);
-        face.indices.push_back(rgba_index);
+        prepared.parts.emplace_back();
+        prepared.parts.back().authored = std::move(chunk);
     }
+}
+
+static void
+FinishPreparedMesh(PreparedMesh &prepared, MeshPreparationOptions const &options)
+{
+    TraceScope span("PrepareMesh");
+    if (cancel_requested || !prepared.valid)
+        return;
+
+    // Tessellated polylines leave the source mesh and become one two-sided stroke mesh.
+    AuthoredMesh strokes;
+    bool const has_strokes = !prepared.strokes.empty() && MergeStrokes(prepared.source, prepared.strokes, strokes);
+    for (TessellatedStroke const &stroke : prepared.strokes)
+        prepared.stroked_polylines += stroke.valid ? 1 : 0;
+    std::vector<TessellatedStroke>().swap(prepared.strokes);
+
+    // Triangulated polygons share one set of buffers; the weld in AddPreparedParts() shares their corners.
+    AuthoredMesh polygons;
+    bool const has_polygons = !prepared.polygons.empty() && MergePolygonFaces(prepared.source, prepared.polygons, polygons);
+    for (PolygonFace const &polygon : prepared.polygons)
+        prepared.triangulated_polygons += polygon.valid ? 1 : 0;
+    std::vector<PolygonFace>().swap(prepared.polygons);
+
+    SC::Store::Mesh const &source = prepared.source.mesh;
+    bool const source_empty = source.face_elements.empty() && source.polyline_elements.empty() && source.point_elements.empty();
+    if (source_empty && !has_strokes && !has_polygons)
+    {
+        prepared.valid = false;
+        prepared.error = "mesh has no vertices";
+        return;
+    }
+    if (!source_empty)
+        AddPreparedParts(prepared, prepared.source, options);
+    if (has_strokes)
+        AddPreparedParts(prepared, strokes, options);
+    if (has_polygons)
+        AddPreparedParts(prepared, polygons, options);
+    prepared.source = AuthoredMesh();
+
+    for (PreparedMeshPart &part : prepared.parts)
+        PreparePart(part, options);
+}
+
+static SC::Store::MaterialKey
+UniformColorMaterial(SC::Store::Model &model, UniformColor const &color)
+{
+    SC::Store::RGBA32 const &rgba = color.rgba;
+    return model.FindOrInsert(SC::Store::Color(rgba.r / 255.0f, rgba.g / 255.0f, rgba.b / 255.0f, rgba.a / 255.0f));
+}
+
+// The colors EncodeAuthoredMesh() took out of constant RGBA32 streams become the mesh's materials.
+static void
+SetUniformColorMaterials(SC::Store::Model &model, AuthoredMesh &authored)
+{
+    if (authored.face_color.set)
+        authored.mesh.mesh_face_material = UniformColorMaterial(model, authored.face_color);
+    if (authored.line_color.set)
+        authored.mesh.mesh_line_material = UniformColorMaterial(model, authored.line_color);
+    if (authored.point_color.set)
+        authored.mesh.mesh_point_material = UniformColorMaterial(model, authored.point_color);
+}
 
-    // Add second face triangle
-    for (size_t i = 0; i < 3; ++i)
+// Inserts the geometry of a prepared part, or finds identical geometry inserted earlier in this
+// run, and instances it. Identical geometry, wherever it was pasted, is stored once.
+static SC::Store::InstanceKey
+InstancePreparedPart(SC::Store::Model &model, MeshInstanceIndex &mesh_index, MatrixKeyCache &matrix_cache,
+                     PreparedMeshPart &part, bool &reused)
+{
+    SC::Store::MeshKey meshKey;
+    reused = mesh_index.Find(part.content_hash, part.authored, meshKey);
+    if (!reused)
     {
-        face.indices.push_back(point_indices[(i + 2) % 4]);
-        face.indices.push_back(normal_index);
-        face.indices.push_back(rgba_index);
+        TraceScope span("Insert(Mesh)");
+        SetUniformColorMaterials(model, part.authored);
+        meshKey = model.Insert(part.authored.Bind());
+        if (!part.lods.empty())
+        {
+            // A mesh selector, highest detail first, lets the stream cache send coarse levels first.
+            SC::Store::MeshKeys levelKeys(1, meshKey);
+            for (AuthoredMesh &lod : part.lods)
+            {
+                SetUniformColorMaterials(model, lod);
+                levelKeys.push_back(model.Insert(lod.Bind()));
+                ProgressLog("info", "Mesh node %i LOD %zu  ::  %zu points  ::  %zu normals", part.authored.node_id,
+                            levelKeys.size() - 1, lod.points.size(), lod.normals.size());
+            }
+            meshKey = model.Insert(levelKeys);
+        }
+        mesh_index.Add(part.content_hash, part.authored, meshKey);
     }
 
-    // Add face edges
-    for (size_t i = 0; i < 4; ++i)
+    SC::Store::MatrixKey matrixKey;
+    if (part.origin.x != 0.0f || part.origin.y != 0.0f || part.origin.z != 0.0f)
     {
-        mesh.polyline_elements.emplace_back();
-        SC::Store::MeshElement &edges = mesh.polyline_elements.back();
-        edges.indices.push_back(point_indices[i % 4]);
-        edges.indices.push_back(rgba_index);
-        edges.indices.push_back(point_indices[(i + 1) % 4]);
-        edges.indices.push_back(rgba_index);
-        // Set bits on edges so that they are selectable for measurement
-        mesh.polyline_elements_bits.push_back(SC::Store::SelectionBitsEdgeHasMeasurementData);
+        SC::Store::Matrix3d translation;
+        translation.SetIdentity();
+        translation.SetTranslation(part.origin.x, part.origin.y, part.origin.z);
+        matrixKey = matrix_cache.FindOrInsert(translation);
     }
-    // Set bits on faces so that they are selectable for measurement
-    mesh.face_elements_bits.push_back(
-        SC::Store::SelectionBitsFaceHasMeasurementData | SC::Store::SelectionBitsFacePlanar);
+    return model.Instance(meshKey, matrixKey);
 }
 
 int StoreSample(const std::string &model_output_path, const std::string &model_name = "sc-model-default", const std::string &json_update = "")
 {
+    InstallCancelHandler();
+
     std::string json_input_string = json_update;
     json_input_string.erase(std::remove_if(json_input_string.begin(), json_input_string.end(), isspace), json_input_string.end());
+    // No change set only reverts the model to its original files.
+    if (json_input_string.empty())
+        json_input_string = "{}";
 
     ApplicationLogger logger;
+    ProgressPhase authoring_phase("authoring");
+    authoring_phase.SetBytes(json_input_string.length());
 
     try
     {
         // Open the cache and clean up files that we are using.
-        SC::Store::Database::SetLicense(HOOPS_LICENSE);
+        {
+            ProgressPhase license_phase("license");
+            SC::Store::Database::SetLicense(HOOPS_LICENSE);
+        }
+        ProgressPhase open_cache_phase("open_cache");
         SC::Store::Cache cache = SC::Store::Database::Open(logger);
+        open_cache_phase.End();
 
         std::string output_path = model_output_path;
         output_path += "/";
@@ -116,22 +384,60 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
         std::string xml_output_path = output_path + ".xml";
         std::ifstream scs_orig_file(scs_output_path + ".orig", std::ios::binary);
 
-        std::__fs::filesystem::remove_all(output_path);
-
-        if (scs_orig_file.good())
+        ///// PROCESS JSON IMPORT
+        // The whole change set is parsed and validated before any file is touched, so a bad one is
+        // rejected without decompressing or loading the model, with every error reported at once.
+        std::vector<char> source(json_input_string.begin(), json_input_string.end());
+        // do not forget terminate source string with 0
+        source.push_back('\0');
+        char *endptr;
+        JsonValue value;
+        JsonAllocator allocator;
+        ProgressPhase parse_phase("parse_json");
+        parse_phase.SetBytes(json_input_string.length());
+        int status = jsonParse(source.data(), &endptr, &value, allocator);
+        parse_phase.End();
+        if (status != JSON_OK) {
+            ProgressLog("error", "%s at %zd", jsonStrError(status), endptr - source.data());
+            return StoreSampleInvalid;
+        }
         {
-            // Start with a fresh copy on each instantiation fort he time being if an original file exists.
-            revertFilesFromOrig(scs_output_path);
-            revertFilesFromOrig(scz_output_path);
-            revertFilesFromOrig(xml_output_path);
+            ProgressPhase validate_phase("validate");
+            uint64_t entries = 0;
+            for (auto changeRequestItem : value)
+                entries += ChangeEntryCount(changeRequestItem->value);
+            validate_phase.SetCount(entries);
+            // The run starts from the .orig files when they exist; index the XML it will load.
+            std::string const baseline_xml_path = scs_orig_file.good() ? xml_output_path + ".orig" : xml_output_path;
+            NodeIndex nodeIndex;
+            std::string error;
+            if (!nodeIndex.Load(baseline_xml_path, error)) {
+                ProgressLog("error", "Cannot validate the change set: %s", error.c_str());
+                return StoreSampleInvalid;
+            }
+            std::vector<std::string> errors;
+            if (!ValidateChangeSet(value, nodeIndex, AttributeTableDirectory(model_output_path), errors)) {
+                for (std::string const &validationError : errors)
+                    ProgressLog("error", "%s", validationError.c_str());
+                ProgressLog("error", "Change set rejected with %zu errors; the model was not modified.", errors.size());
+                return StoreSampleInvalid;
+            }
         }
-        else
+
+        std::__fs::filesystem::remove_all(output_path);
+
+        if (!scs_orig_file.good())
         {
             // If the original file does not exists, copy the assumed baseline files to the ".orig" extension
             backupFiletoOrig(scs_output_path);
             backupFiletoOrig(scz_output_path);
             backupFiletoOrig(xml_output_path);
         }
+        // Every run starts from a fresh copy of the originals. They are read in place rather than
+        // copied over the published files, which only change when the transaction commits.
+        std::string const scz_baseline_path = scz_output_path + ".orig";
+        std::string const xml_baseline_path = xml_output_path + ".orig";
+        ChangeTransaction transaction;
 
         // // Does the model in question exist?
         // if (cache.Exists(file_path_string.c_str())) {
@@ -144,60 +450,169 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
 
         if (!std::__fs::filesystem::exists(output_path))
         {
-            SC::Store::Database::DecompressSCZ(scz_output_path.c_str(), output_path.c_str(), logger);
+            ProgressPhase decompress_phase("decompress");
+            decompress_phase.SetBytes(FileSize(scz_baseline_path));
+            SC::Store::Database::DecompressSCZ(scz_baseline_path.c_str(), output_path.c_str(), logger);
         }
 
         // Open (or Create) the model we care about.
+        ProgressPhase open_model_phase("open_model");
         SC::Store::Model model = cache.Open(output_path.c_str());
+        open_model_phase.End();
         auto modelName = model.GetName();
-        printf("Opened and Loaded SC Model. Model Name: %s\n", modelName);
+        ProgressLog("info", "Opened and Loaded SC Model. Model Name: %s", modelName);
 
         SC::Store::AssemblyTree assembly_tree(logger);
         // Load/Author assembly tree.
         {
-            if (assembly_tree.DeserializeFromXML(xml_output_path.c_str()))
+            // AssemblyTree cannot reparent nodes, so "moves" rewrite the XML before it is loaded.
+            std::string xml_input_path = xml_baseline_path;
+            for (auto changeRequestItem : value) {
+                if (strcmp(changeRequestItem->key, "moves") != 0)
+                    continue;
+                /*"moves":[{"nodeId":12,"parentNodeId":3}]*/
+                ProgressPhase moves_phase("apply.moves");
+                moves_phase.SetCount(ChangeEntryCount(changeRequestItem->value));
+                std::vector<NodeMove> moves;
+                std::string error;
+                if (!ReadNodeMoves(changeRequestItem->value, moves, error)) {
+                    ProgressLog("error", "Invalid moves: %s", error.c_str());
+                    transaction.Record("ReadNodeMoves", -1, false, error);
+                    continue;
+                }
+                size_t moved = 0;
+                std::vector<std::string> errors;
+                std::string const moved_xml_path = xml_output_path + ".moved";
+                if (ApplyNodeMoves(xml_input_path, moved_xml_path, moves, moved, errors))
+                    xml_input_path = moved_xml_path;
+                for (std::string const &moveError : errors) {
+                    ProgressLog("error", "Failed to move node: %s", moveError.c_str());
+                    transaction.Record("MoveNode", -1, false, moveError);
+                }
+                ProgressLog("info", "Moved %zu of %zu nodes", moved, moves.size());
+            }
+
+            ProgressPhase deserialize_phase("deserialize_xml");
+            deserialize_phase.SetBytes(FileSize(xml_input_path));
+            bool deserialized = assembly_tree.DeserializeFromXML(xml_input_path.c_str());
+            deserialize_phase.End();
+            if (xml_input_path != xml_baseline_path)
+                std::remove(xml_input_path.c_str());
+
+            if (deserialized)
             {
-                printf("Successfully Read and Loaded XML Assembly\n");
+                ProgressLog("info", "Successfully Read and Loaded XML Assembly");
                 // assembly_tree.SetNodeName(0, "chris overwrite");
                 // // Add an attribute on that node.
                 // assembly_tree.AddAttribute(
                 //     34, "chris's attribute", SC::Store::AssemblyTree::AttributeTypeString,
                 //     "dope if this works");
 
-                ///// PROCESS JSON IMPORT
-                char *source = new char[json_input_string.length() + 1];
-                strcpy(source, json_input_string.c_str());
-
-                // do not forget terminate source string with 0
-                char *endptr;
-                JsonValue value;
-                JsonAllocator allocator;
-                int status = jsonParse(source, &endptr, &value, allocator);
-                if (status != JSON_OK) {
-                    fprintf(stderr, "%s at %zd\n", jsonStrError(status), endptr - source);
-                } else {
+                // Bounds of the nodes this change set creates, written to the tree before serializing.
+                NodeBoundsRollup boundsRollup;
+
+                {
+                    // Shared by every category: repeated transforms resolve to one MatrixKey.
+                    MatrixKeyCache matrixCache(model);
+                    // Client node id -> assembly tree node of the meshes created by this change set.
+                    std::map<int, SC::Store::NodeId> authoredNodeIds;
+                    // Negative ids refer to nodes created earlier in the same change set.
+                    auto treeNodeId = [&](int nodeId) {
+                        auto authoredNode = authoredNodeIds.find(nodeId);
+                        return authoredNode != authoredNodeIds.end() ? authoredNode->second : (SC::Store::NodeId)nodeId;
+                    };
+                    // Authored instances are referenced from the assembly tree through the model's own inclusion.
+                    SC::Store::InclusionKey inclusionKey;
+                    bool hasSelfInclusion = false;
+                    auto selfInclusion = [&]() {
+                        if (!hasSelfInclusion) {
+                            inclusionKey = model.Include(model);
+                            hasSelfInclusion = true;
+                        }
+                        return inclusionKey;
+                    };
                     for (auto changeRequestItem : value) {
+                        // Moves were applied to the XML, in their own phase, before the tree was loaded.
+                        if (strcmp(changeRequestItem->key, "moves") == 0)
+                            continue;
+                        ProgressPhase apply_phase(std::string("apply.") + changeRequestItem->key);
+                        apply_phase.SetCount(ChangeEntryCount(changeRequestItem->value));
                         if (strcmp(changeRequestItem->key, "attributes") == 0) {
                             /*"attributes":[
                                 {"nodeId":67,"Material":"Inconel"},
                                 {"nodeId":28,"Material":"Steel"},
                                 {"nodeId":59,"Material":"Wood"},
-                                {"nodeId":95,"Manufacture Date":"10/22/2021"}]
+                                {"nodeId":95,"Manufacture Date":"2021-10-22"},
+                                {"nodeId":95,"Mass":12.5,"Quantity":4,"Purchased":true}]
                             */
-                            // The attributes will always be stored in an array so access the array in the "value" of the first child and then get the node of the array
+                            // Numbers, booleans and ISO dates keep their type (see sc_update_attribute_value.h).
                             for (auto attributes : changeRequestItem->value) {
                                 auto attribute = attributes->value.toNode();
                                 // for(auto attribute: attributePair->value){
-                                if (strcmp(attribute->key, "nodeId") == 0) {
+                                if (attribute != nullptr && strcmp(attribute->key, "nodeId") == 0) {
                                     auto nodeId = (int)attribute->value.toNumber();
-                                    auto attributeName = attribute->next->key;
-                                    auto attributeValue = attribute->next->value.toString();
-                                    printf("Attribute written to node %i  ::  Attribute Name: %s  ::  Attribute Value: %s \n", nodeId, attributeName, attributeValue);
-                                    if (!assembly_tree.AddAttribute(nodeId, attributeName, SC::Store::AssemblyTree::AttributeTypeString, attributeValue)) {
-                                        printf("ERROR: Failed to add attribute %s on node %i . \n", attributeName, nodeId);
+                                    for (auto field = attribute->next; field != nullptr; field = field->next) {
+                                        auto attributeName = field->key;
+                                        TypedAttributeValue attributeValue;
+                                        if (!ReadTypedAttributeValue(field->value, attributeValue)) {
+                                            ProgressLog("error", "Attribute %s on node %i has no scalar value.", attributeName, nodeId);
+                                            transaction.Record("AddAttribute", nodeId, false, attributeName);
+                                            continue;
+                                        }
+                                        ProgressLog("info", "Attribute written to node %i  ::  Attribute Name: %s  ::  Attribute Value (%s): %s", nodeId,
+                                                    attributeName, AttributeTypeName(attributeValue.type), attributeValue.text);
+                                        TraceScope span("AddAttribute", nodeId);
+                                        bool const added = assembly_tree.AddAttribute(nodeId, attributeName, attributeValue.type, attributeValue.text);
+                                        transaction.Record("AddAttribute", nodeId, added, attributeName);
+                                        if (!added) {
+                                            ProgressLog("error", "Failed to add attribute %s on node %i.", attributeName, nodeId);
+                                        }
                                     }
                                 }
                             }
+                        } else if (strcmp(changeRequestItem->key, "attributeTables") == 0) {
+                            /*"attributeTables":[{"file":"plm-export.tsv","keyAttribute":"PartNumber"}]*/
+                            std::vector<AttributeTableSource> tables;
+                            std::string error;
+                            if (!ReadAttributeTableSources(changeRequestItem->value, tables, error)) {
+                                ProgressLog("error", "Invalid attributeTables: %s", error.c_str());
+                                transaction.Record("ImportAttributeTable", -1, false, error);
+                                continue;
+                            }
+                            std::string const directory = AttributeTableDirectory(model_output_path);
+                            std::map<std::string, AttributeKeyIndex> indexes;
+                            for (AttributeTableSource const &table : tables) {
+                                std::string path;
+                                if (!ResolveAttributeTablePath(directory, table.file, path, error)) {
+                                    ProgressLog("error", "%s", error.c_str());
+                                    transaction.Record("ImportAttributeTable", -1, false, error);
+                                    continue;
+                                }
+                                // The XML on disk carries the same attributes as the tree loaded from it.
+                                AttributeKeyIndex &index = indexes[table.key_attribute];
+                                if (index.KeyAttribute().empty()) {
+                                    TraceScope span("IndexAttributeKeys");
+                                    if (!index.Load(xml_baseline_path, table.key_attribute, error)) {
+                                        ProgressLog("error", "Failed to index %s values: %s", table.key_attribute.c_str(), error.c_str());
+                                        transaction.Record("ImportAttributeTable", -1, false, error);
+                                        indexes.erase(table.key_attribute);
+                                        continue;
+                                    }
+                                }
+                                AttributeTableResult result;
+                                TraceScope span("ImportAttributeTable");
+                                if (!ImportAttributeTable(assembly_tree, index, path, table.delimiter, result, error)) {
+                                    ProgressLog("error", "Failed to import attribute table: %s", error.c_str());
+                                    transaction.Record("ImportAttributeTable", -1, false, error);
+                                    continue;
+                                }
+                                for (std::string const &rowError : result.errors)
+                                    ProgressLog("error", "%s %s", table.file.c_str(), rowError.c_str());
+                                // Rows no node matches are reported but do not fail the change set; rejected AddAttribute calls do.
+                                transaction.Record("ImportAttributeTable", -1, result.failed == 0, table.file);
+                                ProgressLog("info", "Imported %zu attributes from %zu rows of %s (%zu unresolved, %zu malformed, %zu rejected)",
+                                            result.attributes, result.rows, table.file.c_str(), result.unresolved, result.malformed, result.failed);
+                            }
                         } else if (strcmp(changeRequestItem->key, "nodeNames") == 0) {
                             /*"nodeNames":[
                                 {"nodeId":0,"nodeName":"HC Node"},
@@ -212,9 +627,12 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
                                     auto nodeId = (int)nodeName->value.toNumber();
                                     if (strcmp(nodeName->next->key, "nodeName") == 0) {
                                         auto nodeNameValue = nodeName->next->value.toString();
-                                        printf("Node %i  was renamed to %s. \n", nodeId, nodeNameValue);
-                                        if (!assembly_tree.SetNodeName(nodeId, nodeNameValue)) {
-                                            printf("ERROR: Failed to rename node %i to %s. \n", nodeId, nodeNameValue);
+                                        ProgressLog("info", "Node %i  was renamed to %s.", nodeId, nodeNameValue);
+                                        TraceScope span("SetNodeName", nodeId);
+                                        bool const renamed = assembly_tree.SetNodeName(nodeId, nodeNameValue);
+                                        transaction.Record("SetNodeName", nodeId, renamed);
+                                        if (!renamed) {
+                                            ProgressLog("error", "Failed to rename node %i to %s.", nodeId, nodeNameValue);
                                         }
                                     }
                                 }
@@ -261,7 +679,7 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
                                     //         }
                                     //     }
                                     // }
-                                    printf("We don't process nodeIds");
+                                    ProgressLog("warning", "We don't process nodeIds");
                                 } else if (strcmp(colorNode->key, "nodeId") == 0) {
                                     auto color = colorNode->next;
                                     if (strcmp(color->key, "color") == 0) {
@@ -282,6 +700,7 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
                                     }
 
                                     auto nodeId = (int)colorNode->value.toNumber();
+                                    TraceScope span("SetInstanceMaterial", nodeId);
                                     auto inputMaterial = SC::Store::Material(SC::Store::Color(red, green, blue, 1.0));
                                     auto inputMaterialKey = model.Insert(inputMaterial);
                                     auto materialBlack = SC::Store::Material(SC::Store::Color(0, 0, 0, 1.0));
@@ -291,8 +710,9 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
                                     //     printf("ERROR: Failed to set color on instance %i . \n", nodeId);
                                     // } // TODO: publish color updates
                                     // Need to send over scInstanceId from client. Passing 13 for now.
-                                    printf("Setting color to node %i  ::  ScInstanceId: %i  ::  Color: %f %f %f  \n", nodeId, (int)scInstanceId->value.toNumber(), red, green, blue);
+                                    ProgressLog("info", "Setting color to node %i  ::  ScInstanceId: %i  ::  Color: %f %f %f", nodeId, (int)scInstanceId->value.toNumber(), red, green, blue);
                                     model.Set(scInstanceKey, inputMaterialKey, materialKeyBlack, materialKeyBlack);
+                                    transaction.Record("SetInstanceMaterial", nodeId, true);
                                 }
                             }
                         } else if (strcmp(changeRequestItem->key, "defaultCamera") == 0) {
@@ -389,229 +809,420 @@ int StoreSample(const std::string &model_output_path, const std::string &model_n
                                 }
                             }
                             // TODO: Write the default camera settings to the file.
-                            printf("Default Camera Overwritten\n");
+                            ProgressLog("info", "Default Camera Overwritten");
                             model.Set(defaultCamera);
+                            transaction.Record("SetDefaultCamera", -1, true);
                         } else if (strcmp(changeRequestItem->key, "meshes") == 0) {
-                            // The meshes will always be stored in an array so access the array in the "value" of the first child and then get the node of the array
-                            for (auto meshTemplates : changeRequestItem->value) {
-                                std::vector<SC::Store::MeshElement> faceMeshElements;
-                                for(auto meshTemplate : meshTemplates->value){
-                                    int nodeId, parentNodeId = 0;
-
-                                    SC::Store::Mesh mesh;
-                                    int face_count = 0;
-                                    mesh.flags = (SC::Store::Mesh::Bits)(
-                                        SC::Store::Mesh::ClockwiseWinding | SC::Store::Mesh::FaceNormals | SC::Store::Mesh::FaceRGBA32s | SC::Store::Mesh::LineRGBA32s | SC::Store::Mesh::Manifold);
-
-                                    // for(auto attribute: attributePair->value){
-                                    if (strcmp(meshTemplate->key, "nodeId") == 0) {
-                                        nodeId= (int)meshTemplate->value.toNumber();
-                                    } else if (strcmp(meshTemplate->key, "parentNodeId") == 0) {
-                                        parentNodeId = (int)meshTemplate->value.toNumber();
-                                        
-                                        /*"{\"meshes\":[{\"nodeId\":-64,\"parentNodeId\":-2,\
-                                        "faces\":[{\"position\":[-10,10,10,10,10,10,-10,-10,10,10,10,10,10,-10,10,-10,-10,10,10,10,-10,-10,10,-10,-10,-10,-10,10,10,-10,-10,-10,-10,10,-10,-10,-10,10,-10,10,10,-10,10,10,10,-10,10,-10,10,10,10,-10,10,10,-10,-10,-10,10,-10,10,10,-10,-10,-10,-10,-10,-10,-10,10,10,-10,10,-10,10,-10,-10,10,10,-10,-10,-10,-10,10,10,-10,-10,10,-10,-10,-10,10,10,10,10,10,-10,10,-10,-10,10,10,10,10,-10,-10,10,-10,10]}],\
-                                        "lines\":[],\
-                                        "points\":[]}]}";*/
-                                        
-                                        //"{\"nodeNames\":[{\"nodeId\":0,\"nodeName\":\"HC Node\"},{\"nodeId\":2,\"nodeName\":\"HC Node 2\"}]\"attributes\":[{\"nodeId\":6,\"Material\":\"Inconel\"},{\"nodeId\":4,\"Material\":\"Steel\"},{\"nodeId\":34,\"Material\":\"Wood\"},{\"nodeId\":95,\"Manufacture Date\":\"10/22/2021\"}],\"defaultCamera\":{\"_position\":{\"x\":81.22082242242087,\"y\":-99.85364263567925,\"z\":-14.745490335642312},\"_target\":{\"x\":42.01403360616819,\"y\":28.500000953674316,\"z\":-45.15500047683717},\"_up\":{\"x\":0.014413796198195017,\"y\":0.23468066183916042,\"z\":0.9719656523961587},\"_width\":137.61020125980392,\"_height\":137.61020125980392,\"_projection\":0,\"_nearLimit\":0.01,\"_cameraFlags\":0},\"colors\":[{\"nodeIds\":[8,9,10,11],\"color\":{\"r\":255,\"g\":0,\"b\":0}}],\"colors\":[{\"nodeId\":8,\"color\":{\"r\":0,\"g\":255,\"b\":0}},{\"nodeId\":9,\"color\":{\"r\":0,\"g\":255,\"b\":0}},{\"nodeId\":10,\"color\":{\"r\":0,\"g\":255,\"b\":0}},{\"nodeId\":11,\"color\":{\"r\":0,\"g\":255,\"b\":0}}]}";
-                                    } else if (strcmp(meshTemplate->key, "faces") == 0) {
-                                        auto meshFacesNode = meshTemplate->value.toNode();
-                                        for (auto meshElementFaces : meshFacesNode->value) {
-                                            auto faceElementData = meshElementFaces->value.toNode();
-                                            bool hasNormals, hasRGBAs, hasUVs;
-
-                                            if (strcmp(meshElementFaces->key, "position") == 0){
-                                                SC::Store::Point points[] = {};
-                                                auto facePoint = meshElementFaces->value.toNode();
-                                                int pointCount = 0;
-                                                int xyzCount = 0;
-                                                float pointX = 0.0f;
-                                                float pointY = 0.0f;
-                                                bool bListComplete = false;
-                                                while(!bListComplete){
-                                                    if(xyzCount == 0){
-                                                        pointX = facePoint->value.toNumber();
-                                                        xyzCount = xyzCount + 1;
-                                                    } else if(xyzCount == 1){
-                                                        pointY = facePoint->value.toNumber();
-                                                        xyzCount = xyzCount + 1;
-                                                    } else {
-                                                        float pointZ = facePoint->value.toNumber();
-                                                        //points.push_back(SC::Store::Point(pointX, pointY, pointZ));
-                                                        points[pointCount] = SC::Store::Point(pointX, pointY, pointZ);
-                                                        pointCount = pointCount + 1;
-                                                        xyzCount = 0;
-                                                    }
-                                                    if(!facePoint->next) bListComplete = true;
-                                                    else facePoint = facePoint->next;
-                                                }
-
-                                                mesh.points = points;
-                                                mesh.point_count = pointCount;
-                                            } else if(strcmp(faceElementData->key, "normals") == 0){
-                                                SC::Store::Normal normals[] = {
-                                                    {0, -1, 0}, // 0
-                                                    {0, 0, 1},  // 1
-                                                    {0, 1, 0},  // 2
-                                                    {0, 0, -1}, // 3
-                                                    {1, 0, 0},  // 4
-                                                    {-1, 0, 0}, // 5
-                                                };
-                                                mesh.normals = normals;
-                                                face_count = 6;
-                                                mesh.normal_count = face_count;
-                                            } else if(strcmp(faceElementData->key, "rgba32s") == 0){
-                                                SC::Store::RGBA32 rgba32s[] = {
-                                                    {255, 0, 0, 255},   // 0
-                                                    {255, 0, 0, 255},   // 1
-                                                    {255, 0, 0, 255},   // 2
-                                                    {255, 0, 0, 255}, // 3
-                                                    {255, 0, 0, 255}, // 4
-                                                    {255, 0, 0, 255}, // 5
-                                                };
-                                                mesh.rgba32s = rgba32s;
-                                                mesh.rgba32_count = 6;
-                                            }
-                                            // SC::Store::Mesh faceMesh;
-                                            // // faceMesh.flags = SC::Store::Mesh::Bits::
-                                            // auto i = 0;
-                                            // auto pointCount = 0;
-                                            // std::vector<SC::Store::Point> vertices = {};
-                                            // for (auto position : faceElementData->value)
-                                            // {
-                                            //     SC::Store::Point vertex;
-                                            //     switch (i)
-                                            //     {
-                                            //     case 0:
-                                            //         vertex.x = position->value.toNumber();
-                                            //         i++;
-                                            //         break;
-                                            //     case 1:
-                                            //         vertex.y = position->value.toNumber();
-                                            //         i++;
-                                            //         break;
-                                            //     case 2:
-                                            //         vertex.z = position->value.toNumber();
-                                            //         i = 0;
-                                            //         vertices.push_back(vertex);
-                                            //         pointCount++;
-                                            //         break;
-                                            //     }
-                                            // }
-                                            // faceMesh.point_count = pointCount;
-                                            // SC::Store::Point *points = &vertices[0];
-                                            // faceMesh.points = points;
-                                            // SC::Store::MeshElement faceElement;
-                                            // std::vector<SC::Store::NodeId> indices =
-                                            //     {
-                                            //         // front
-                                            //         0, 1, 3,
-                                            //         1, 2, 3,
-                                            //         // back
-                                            //         4, 5, 7,
-                                            //         5, 6, 7,
-                                            //         // right
-                                            //         0, 1, 4,
-                                            //         1, 4, 5,
-                                            //         // left
-                                            //         2, 3, 7,
-                                            //         2, 6, 7,
-                                            //         // top
-                                            //         0, 3, 4,
-                                            //         3, 4, 7,
-                                            //         // bottom
-                                            //         1, 2, 5,
-                                            //         2, 5, 6
-                                            // };
-                                            // faceElement.indices = indices;
-                                            // faceMesh.face_elements.push_back(faceElement);
-                                            // auto meshKey = model.Insert(faceMesh);
-
-                                            //for(int faceIndex = 0; faceIndex < face_count; faceIndex++)
-                                            {
-                                                uint32_t point_indices[] = {0, 1, 3, 2};
-                                                uint32_t normal_index = 0;
-                                                uint32_t rgba32_index = 0;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            {
-                                                uint32_t point_indices[] = {6, 4, 1, 0};
-                                                uint32_t normal_index = 1;
-                                                uint32_t rgba32_index = 1;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            {
-                                                uint32_t point_indices[] = {7, 5, 4, 6};
-                                                uint32_t normal_index = 2;
-                                                uint32_t rgba32_index = 2;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            {
-                                                uint32_t point_indices[] = {2, 3, 5, 7};
-                                                uint32_t normal_index = 3;
-                                                uint32_t rgba32_index = 3;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            {
-                                                uint32_t point_indices[] = {1, 4, 5, 3};
-                                                uint32_t normal_index = 4;
-                                                uint32_t rgba32_index = 4;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            {
-                                                uint32_t point_indices[] = {6, 0, 2, 7};
-                                                uint32_t normal_index = 5;
-                                                uint32_t rgba32_index = 5;
-                                                AddSquareFace(mesh, point_indices, normal_index, rgba32_index);
-                                            }
-                                            auto meshKey = model.Insert(mesh);
-                                            auto instanceKey = model.Instance(meshKey);
-                                            SC::Store::NodeId childNodeId = nodeId;
-                                            SC::Store::NodeId bodyInstanceNode = 0;
-                                            assembly_tree.CreateChild(parentNodeId, childNodeId);
-                                            assembly_tree.CreateAndAddBodyInstance(childNodeId, bodyInstanceNode);
+                            /*"meshes":[
+                                {"nodeId":-64,"parentNodeId":2,
+                                 "faces":[{"position":[-10,10,10, ...],"normal":[0,0,1, ...],"rgba":[],"uv":[]}],
+                                 "lines":[],"points":[],"polygons":[{"position":[...],"normal":[...],"rgba":[...]}],
+                                 "winding":"clockwise","isTwoSided":0,"isManifold":0}]
+                            */
+                            MeshInstanceIndex meshIndex;
+                            size_t reusedMeshCount = 0;
+                            // Mesh preparation is independent per entry and runs on the worker threads;
+                            // everything that touches the model or assembly tree stays on this thread.
+                            std::vector<PreparedMesh> preparedMeshes;
+                            if (changeRequestItem->value.getTag() == JSON_ARRAY) {
+                                preparedMeshes.resize((size_t)ChangeEntryCount(changeRequestItem->value));
+                                size_t meshIndexInRequest = 0;
+                                for (auto meshTemplates : changeRequestItem->value)
+                                    preparedMeshes[meshIndexInRequest++].mesh_template = &meshTemplates->value;
+                                ProgressPhase prepare_phase("prepare_meshes");
+                                prepare_phase.SetCount(preparedMeshes.size());
+                                MeshPreparationOptions preparationOptions;
+                                preparationOptions.lod = LodOptionsFromEnvironment();
+                                preparationOptions.chunk = ChunkOptionsFromEnvironment();
+                                preparationOptions.line_stroke = LineStrokeOptionsFromEnvironment();
+                                preparationOptions.measure = MeasurementOptionsFromEnvironment();
+                                ParallelFor(preparedMeshes.size(), [&](size_t i) { BuildPreparedMesh(preparedMeshes[i], preparationOptions); });
+
+                                // Thick-line tessellation and polygon triangulation are spread over the polylines
+                                // and polygons of every entry, so one large markup does not hold up a single thread.
+                                std::vector<std::pair<PreparedMesh *, TessellatedStroke *>> strokeJobs;
+                                std::vector<PolygonFace *> polygonJobs;
+                                for (PreparedMesh &prepared : preparedMeshes) {
+                                    for (TessellatedStroke &stroke : prepared.strokes)
+                                        strokeJobs.push_back(std::make_pair(&prepared, &stroke));
+                                    for (PolygonFace &polygon : prepared.polygons)
+                                        polygonJobs.push_back(&polygon);
+                                }
+                                ParallelFor(strokeJobs.size() + polygonJobs.size(), [&](size_t i) {
+                                    if (cancel_requested)
+                                        return;
+                                    if (i < strokeJobs.size()) {
+                                        TraceScope span("CreateThickLine");
+                                        PreparedMesh const &prepared = *strokeJobs[i].first;
+                                        TessellateStroke(prepared.source, prepared.line_stroke, *strokeJobs[i].second);
+                                    } else {
+                                        TraceScope span("TriangulateFace");
+                                        TriangulatePolygonFace(*polygonJobs[i - strokeJobs.size()]);
+                                    }
+                                });
+
+                                ParallelFor(preparedMeshes.size(), [&](size_t i) { FinishPreparedMesh(preparedMeshes[i], preparationOptions); });
+                            }
+                            if (cancel_requested)
+                                break;
+
+                            for (PreparedMesh &prepared : preparedMeshes) {
+                                TraceScope mesh_span("mesh");
+                                if (!prepared.valid) {
+                                    ProgressLog("error", "Failed to build mesh: %s", prepared.error.c_str());
+                                    transaction.Record("BuildMesh", prepared.node_id, false, prepared.error);
+                                    continue;
+                                }
+
+                                EncodingStats const &encodingStats = prepared.encoding_stats;
+                                ProgressLog("info", "Encoded mesh node %i  ::  flags 0x%x -> 0x%x  ::  %u flat / %u smooth triangles  ::  %llu -> %llu bytes",
+                                            prepared.node_id, encodingStats.flags_before, encodingStats.flags_after,
+                                            encodingStats.flat_triangles, encodingStats.smooth_triangles,
+                                            (unsigned long long)encodingStats.bytes_before, (unsigned long long)encodingStats.bytes_after);
+
+                                if (prepared.stroked_polylines > 0) {
+                                    ProgressLog("info", "Mesh node %i  ::  %zu polylines tessellated into thick lines of width %g",
+                                                prepared.node_id, prepared.stroked_polylines, prepared.line_stroke.thickness);
+                                }
+
+                                if (prepared.triangulated_polygons > 0) {
+                                    ProgressLog("info", "Mesh node %i  ::  %zu polygons triangulated",
+                                                prepared.node_id, prepared.triangulated_polygons);
+                                }
+
+                                WeldStats const &weldStats = prepared.weld_stats;
+                                ProgressLog("info", "Welded mesh node %i  ::  points %u -> %u  ::  normals %u -> %u  ::  uvs %u -> %u  ::  colors %u -> %u",
+                                            prepared.node_id, weldStats.points_before, weldStats.points_after, weldStats.normals_before,
+                                            weldStats.normals_after, weldStats.uvs_before, weldStats.uvs_after, weldStats.rgba32s_before,
+                                            weldStats.rgba32s_after);
+
+                                SC::Store::NodeId childNodeId = 0;
+                                SC::Store::NodeId const parentNodeId = treeNodeId(prepared.parent_node_id);
+                                if (!assembly_tree.CreateChild(parentNodeId, childNodeId)) {
+                                    ProgressLog("error", "Failed to add mesh node %i under node %i.", prepared.node_id, prepared.parent_node_id);
+                                    transaction.Record("CreateChild", prepared.node_id, false);
+                                    continue;
+                                }
+                                authoredNodeIds[prepared.node_id] = childNodeId;
+                                transaction.RecordCreated(prepared.node_id);
+                                boundsRollup.AddNode(childNodeId, parentNodeId);
+                                if (prepared.has_local_transform) {
+                                    boundsRollup.SetLocalTransform(childNodeId, prepared.local_transform);
+                                    if (!assembly_tree.SetNodeLocalTransform(childNodeId, prepared.local_transform)) {
+                                        ProgressLog("error", "Failed to set the local transform of mesh node %i.", prepared.node_id);
+                                        transaction.Record("SetNodeLocalTransform", prepared.node_id, false);
+                                    }
+                                }
+
+                                // Derived measurement data lives on bodies of a part node, one body per body instance.
+                                SC::Store::NodeId measuredPartNodeId = 0;
+                                bool hasMeasurements = false;
+                                size_t planes = 0, cylinders = 0, edges = 0;
+                                for (PreparedMeshPart const &part : prepared.parts) {
+                                    hasMeasurements = hasMeasurements || !part.measurement.Empty();
+                                    for (FaceMeasurement const &face : part.measurement.faces)
+                                        (face.kind == FaceMeasurement::Plane ? planes : cylinders) += 1;
+                                    edges += part.measurement.edges.size();
+                                }
+                                if (hasMeasurements) {
+                                    measuredPartNodeId = assembly_tree.CreatePart();
+                                    if (!assembly_tree.SetPart(childNodeId, measuredPartNodeId)) {
+                                        ProgressLog("error", "Failed to add a part to mesh node %i.", prepared.node_id);
+                                        transaction.Record("SetPart", prepared.node_id, false);
+                                        hasMeasurements = false;
+                                    }
+                                }
+
+                                // Oversized meshes arrive as several chunks, each its own body instance and stream unit.
+                                size_t instancedParts = 0;
+                                for (PreparedMeshPart &part : prepared.parts) {
+                                    AuthoredMesh &authoredMesh = part.authored;
+                                    if (part.vertex_cache_stats.triangles > 0) {
+                                        ProgressLog("info", "Vertex cache order for mesh node %i  ::  %u triangles  ::  ACMR %.3f -> %.3f",
+                                                    prepared.node_id, part.vertex_cache_stats.triangles,
+                                                    part.vertex_cache_stats.acmr_before, part.vertex_cache_stats.acmr_after);
+                                    }
+
+                                    bool reused = false;
+                                    auto instanceKey = InstancePreparedPart(model, meshIndex, matrixCache, part, reused);
+                                    reusedMeshCount += reused ? 1 : 0;
+
+                                    SC::Store::NodeId bodyInstanceNode = 0;
+                                    if (!assembly_tree.CreateAndAddBodyInstance(childNodeId, bodyInstanceNode) ||
+                                        !assembly_tree.SetBodyInstanceMeshInstanceKey(bodyInstanceNode, SC::Store::InstanceInc(selfInclusion(), instanceKey))) {
+                                        ProgressLog("error", "Failed to add a body instance to mesh node %i.", prepared.node_id);
+                                        transaction.Record("CreateAndAddBodyInstance", prepared.node_id, false);
+                                        continue;
+                                    }
+                                    SC::Store::NodeId bodyNode = 0;
+                                    if (hasMeasurements && (!assembly_tree.CreateAndAddBody(measuredPartNodeId, bodyNode, SC::Store::Tessellation) ||
+                                                            SetMeasurementData(assembly_tree, bodyNode, part.measurement) !=
+                                                                part.measurement.faces.size() + part.measurement.edges.size())) {
+                                        ProgressLog("error", "Failed to set measurement data of mesh node %i.", prepared.node_id);
+                                        transaction.Record("SetMeasurementData", prepared.node_id, false);
+                                    }
+                                    Bounds partBounds;
+                                    partBounds.Add(authoredMesh.bounds_min, authoredMesh.bounds_max);
+                                    assembly_tree.SetBoundingBox(bodyInstanceNode, partBounds.ToBBox());
+                                    boundsRollup.AddContent(childNodeId, partBounds);
+                                    ++instancedParts;
+                                    ProgressLog("info", "Mesh node %i added as node %u  ::  mesh instance %u%s  ::  %zu points  ::  %zu faces  ::  %zu polylines  ::  %zu point elements",
+                                                prepared.node_id, childNodeId, (uint32_t)instanceKey, reused ? " (instanced)" : "",
+                                                authoredMesh.points.size(), authoredMesh.mesh.face_elements.size(),
+                                                authoredMesh.mesh.polyline_elements.size(), authoredMesh.mesh.point_elements.size());
+                                }
+                                if (prepared.parts.size() > 1) {
+                                    ProgressLog("info", "Mesh node %i split into %zu chunks (%zu added)", prepared.node_id,
+                                                prepared.parts.size(), instancedParts);
+                                }
+                                transaction.Record("AddMesh", prepared.node_id, instancedParts == prepared.parts.size());
+                                if (hasMeasurements) {
+                                    ProgressLog("info", "Measurement data for mesh node %i  ::  %zu planes  ::  %zu cylinders  ::  %zu straight edges",
+                                                prepared.node_id, planes, cylinders, edges);
+                                }
+                            }
+                            ProgressLog("info", "Mesh instancing: %zu meshes reused an existing MeshKey, index holds %zu meshes",
+                                        reusedMeshCount, meshIndex.Size());
+                        } else if (strcmp(changeRequestItem->key, "pointClouds") == 0) {
+                            /*"pointClouds":[
+                                {"nodeId":-80,"parentNodeId":2,"positionData":"<base64 float32 x,y,z>","rgbaData":"<base64 uint8 r,g,b,a>"},
+                                {"nodeId":-81,"parentNodeId":2,"position":[0,0,0, ...],"rgba":[255,0,0,255, ...]}]
+                            */
+                            std::vector<PreparedPointCloud> preparedClouds;
+                            if (changeRequestItem->value.getTag() == JSON_ARRAY) {
+                                preparedClouds.resize((size_t)ChangeEntryCount(changeRequestItem->value));
+                                size_t cloudIndex = 0;
+                                for (auto cloudTemplates : changeRequestItem->value)
+                                    preparedClouds[cloudIndex++].cloud_template = &cloudTemplates->value;
+                                ProgressPhase prepare_phase("prepare_point_clouds");
+                                prepare_phase.SetCount(preparedClouds.size());
+                                PointCloudOptions const cloudOptions = PointCloudOptionsFromEnvironment();
+                                ParallelFor(preparedClouds.size(), [&](size_t i) {
+                                    PreparedPointCloud &prepared = preparedClouds[i];
+                                    TraceScope span("PreparePointCloud");
+                                    if (cancel_requested)
+                                        return;
+                                    prepared.valid = BuildPointCloud(*prepared.cloud_template, prepared.cloud, prepared.error);
+                                    if (prepared.valid)
+                                        BucketPointCloud(prepared.cloud, cloudOptions, prepared.batches);
+                                });
+                            }
+                            if (cancel_requested)
+                                break;
+
+                            for (PreparedPointCloud &prepared : preparedClouds) {
+                                TraceScope cloud_span("point_cloud");
+                                PointCloud &cloud = prepared.cloud;
+                                if (!prepared.valid) {
+                                    ProgressLog("error", "Failed to build point cloud: %s", prepared.error.c_str());
+                                    transaction.Record("BuildPointCloud", cloud.node_id, false, prepared.error);
+                                    continue;
+                                }
+                                SC::Store::NodeId cloudNodeId = 0;
+                                SC::Store::NodeId const parentNodeId = treeNodeId(cloud.parent_node_id);
+                                if (!assembly_tree.CreateChild(parentNodeId, cloudNodeId)) {
+                                    ProgressLog("error", "Failed to add point cloud node %i under node %i.", cloud.node_id, cloud.parent_node_id);
+                                    transaction.Record("CreateChild", cloud.node_id, false);
+                                    continue;
+                                }
+                                authoredNodeIds[cloud.node_id] = cloudNodeId;
+                                transaction.RecordCreated(cloud.node_id);
+                                boundsRollup.AddNode(cloudNodeId, parentNodeId);
+                                if (cloud.has_local_transform) {
+                                    boundsRollup.SetLocalTransform(cloudNodeId, cloud.local_transform);
+                                    if (!assembly_tree.SetNodeLocalTransform(cloudNodeId, cloud.local_transform)) {
+                                        ProgressLog("error", "Failed to set the local transform of point cloud node %i.", cloud.node_id);
+                                        transaction.Record("SetNodeLocalTransform", cloud.node_id, false);
+                                    }
+                                }
+
+                                // Every batch covers a compact region and gets its own body instance and bounds.
+                                size_t meshCount = 0;
+                                for (PointCloudBatch const &batch : prepared.batches) {
+                                    SC::Store::MeshKeys meshKeys;
+                                    {
+                                        TraceScope span("CreatePointMeshes");
+                                        if (!SC::Store::Utils::CreatePointMeshes(model, &cloud.points[batch.begin],
+                                                                                 cloud.rgba32s.empty() ? nullptr : &cloud.rgba32s[batch.begin],
+                                                                                 batch.count, meshKeys)) {
+                                            ProgressLog("error", "Failed to create point meshes for point cloud node %i.", cloud.node_id);
+                                            transaction.Record("CreatePointMeshes", cloud.node_id, false);
+                                            continue;
+                                        }
+                                    }
+                                    for (SC::Store::MeshKey meshKey : meshKeys) {
+                                        SC::Store::NodeId bodyInstanceNode = 0;
+                                        auto instanceKey = model.Instance(meshKey);
+                                        if (!assembly_tree.CreateAndAddBodyInstance(cloudNodeId, bodyInstanceNode) ||
+                                            !assembly_tree.SetBodyInstanceMeshInstanceKey(bodyInstanceNode, SC::Store::InstanceInc(selfInclusion(), instanceKey))) {
+                                            ProgressLog("error", "Failed to add a body instance to point cloud node %i.", cloud.node_id);
+                                            transaction.Record("CreateAndAddBodyInstance", cloud.node_id, false);
+                                            continue;
                                         }
+                                        Bounds batchBounds;
+                                        batchBounds.Add(batch.bounds_min, batch.bounds_max);
+                                        assembly_tree.SetBoundingBox(bodyInstanceNode, batchBounds.ToBBox());
+                                        boundsRollup.AddContent(cloudNodeId, batchBounds);
+                                        ++meshCount;
                                     }
                                 }
+                                transaction.Record("AddPointCloud", cloud.node_id, true);
+                                ProgressLog("info", "Point cloud node %i added as node %u  ::  %zu points  ::  %zu batches  ::  %zu point meshes",
+                                            cloud.node_id, cloudNodeId, cloud.points.size(), prepared.batches.size(), meshCount);
+
+                                // The store has its own copy now; release the buffers before the next cloud.
+                                std::vector<SC::Store::Point>().swap(cloud.points);
+                                std::vector<SC::Store::RGBA32>().swap(cloud.rgba32s);
+                            }
+                        } else if (strcmp(changeRequestItem->key, "transforms") == 0) {
+                            /*"transforms":[
+                                {"nodeId":12,"localTransform":[1,0,0,0, 0,1,0,0, 0,0,1,0, 25,0,0,1]},
+                                {"nodeId":-64,"localTransform":[...]}]
+                            */
+                            // Moving a node only replaces its matrix; the geometry below it is untouched.
+                            // Negative ids refer to nodes created earlier in the same change set.
+                            for (auto transforms : changeRequestItem->value) {
+                                bool hasNodeId = false;
+                                int nodeId = 0;
+                                JsonValue const *localTransform = nullptr;
+                                for (auto item : transforms->value) {
+                                    if (strcmp(item->key, "nodeId") == 0 && item->value.getTag() == JSON_NUMBER) {
+                                        nodeId = (int)item->value.toNumber();
+                                        hasNodeId = true;
+                                    } else if (strcmp(item->key, "localTransform") == 0) {
+                                        localTransform = &item->value;
+                                    }
+                                }
+                                SC::Store::Matrix3d matrix;
+                                std::string error;
+                                if (!hasNodeId || localTransform == nullptr) {
+                                    ProgressLog("error", "Transform entry needs nodeId and localTransform.");
+                                    transaction.Record("SetNodeLocalTransform", -1, false);
+                                    continue;
+                                }
+                                if (!ParseLocalTransform(*localTransform, matrix, error)) {
+                                    ProgressLog("error", "Invalid transform for node %i: %s", nodeId, error.c_str());
+                                    transaction.Record("SetNodeLocalTransform", nodeId, false, error);
+                                    continue;
+                                }
+                                SC::Store::NodeId const transformNodeId = treeNodeId(nodeId);
+                                TraceScope span("SetNodeLocalTransform", nodeId);
+                                if (!assembly_tree.SetNodeLocalTransform(transformNodeId, matrix)) {
+                                    ProgressLog("error", "Failed to set the local transform of node %i.", nodeId);
+                                    transaction.Record("SetNodeLocalTransform", nodeId, false);
+                                    continue;
+                                }
+                                boundsRollup.SetLocalTransform(transformNodeId, matrix);
+                                transaction.Record("SetNodeLocalTransform", nodeId, true);
+                                ProgressLog("info", "Node %i moved  ::  translation (%g, %g, %g)", nodeId, matrix.m[9], matrix.m[10], matrix.m[11]);
                             }
                         } else {
                             // Unhandled JSON top level item
-                            printf("ERROR: Unknown change insertion in JSON file\n");
+                            ProgressLog("error", "Unknown change insertion in JSON file: %s", changeRequestItem->key);
+                            transaction.Record("UnknownCategory", -1, false, changeRequestItem->key);
                         }
                     }
+                    if (matrixCache.Size() > 0) {
+                        ProgressLog("info", "Matrix cache: %zu MatrixKeys, %zu lookups shared an existing key", matrixCache.Size(),
+                                    matrixCache.Hits());
+                    }
+                    // Lets the viewer fit and cull new nodes before their geometry streams in.
+                    size_t const boundedNodes = boundsRollup.Apply(assembly_tree);
+                    if (boundedNodes > 0) {
+                        Bounds const &total = boundsRollup.Total();
+                        ProgressLog("info", "Bounding boxes set on %zu authored nodes  ::  (%g, %g, %g) - (%g, %g, %g)", boundedNodes,
+                                    total.min.x, total.min.y, total.min.z, total.max.x, total.max.y, total.max.z);
+                    }
                 }
 
-                delete[] source;
-
                 // printf("%s\n", json_update.c_str());
                 ///// END JSON IMPORT
 
-                // Serialize authored content to model and xml output
+                if (CancelRequested("apply"))
+                    return StoreSampleCancelled;
+
+                // All or nothing: one failed operation discards the run. Nothing has been written
+                // yet, so leaving drops the in-memory edits and the published model stays as it was.
+                if (transaction.Failures() > 0) {
+                    for (std::string const &failure : transaction.FailureSummary(16))
+                        ProgressLog("error", "Failed operation: %s", failure.c_str());
+                    ProgressLog("error", "Change set rolled back: %zu of %zu operations failed, %zu created nodes discarded; the model was not modified.",
+                                transaction.Failures(), transaction.Operations(), transaction.Created().size());
+                    return StoreSampleRolledBack;
+                }
+
+                // Serialize authored content to the model. The XML, SCS and SCZ files are written
+                // to staged paths and published together on commit, so a cancelled or failed run
+                // never publishes a partial set.
+                ProgressPhase serialize_model_phase("serialize_model");
                 auto passed = assembly_tree.SerializeToModel(model);
-                passed = assembly_tree.SerializeToXML(xml_output_path.c_str());
-                printf("Serialized Assembly Tree to Model and XML\n");
+                serialize_model_phase.End();
+                ProgressLog("info", "Serialized Assembly Tree to Model");
+                if (CancelRequested("SerializeToModel"))
+                    return StoreSampleCancelled;
 
                 // Prepare the model for streaming.
-                model.PrepareStream();
-                printf("Preparing Stream and authoring SCZ and SCS models.\n");
+                {
+                    ProgressPhase phase("prepare_stream");
+                    model.PrepareStream();
+                }
+                if (BoundsVerificationFromEnvironment() && !boundsRollup.Total().empty) {
+                    // Cross-check only: ComputeBounding walks the prepared stream, the rolled up bounds are already in the tree.
+                    SC::Store::Point modelMin, modelMax;
+                    model.ComputeBounding(modelMin, modelMax);
+                    Bounds const &total = boundsRollup.Total();
+                    ProgressLog("info", "Bounds check  ::  model (%g, %g, %g) - (%g, %g, %g)  ::  authored nodes in their parents' frames (%g, %g, %g) - (%g, %g, %g)",
+                                modelMin.x, modelMin.y, modelMin.z, modelMax.x, modelMax.y, modelMax.z,
+                                total.min.x, total.min.y, total.min.z, total.max.x, total.max.y, total.max.z);
+                }
+                if (CancelRequested("PrepareStream"))
+                    return StoreSampleCancelled;
 
-                model.GenerateSCSFile(scs_output_path.c_str());
-                model.GenerateSCZFile(scz_output_path.c_str());
-                printf("Authoring Complete.\n");
+                ProgressLog("info", "Preparing Stream and authoring XML, SCZ and SCS models.");
+                // Published in this order: the .scs the viewer loads goes last.
+                std::string const xml_staged_path = transaction.Stage(xml_output_path);
+                std::string const scz_staged_path = transaction.Stage(scz_output_path);
+                std::string const scs_staged_path = transaction.Stage(scs_output_path);
+                {
+                    ProgressPhase phase("serialize_xml");
+                    passed = assembly_tree.SerializeToXML(xml_staged_path.c_str());
+                    phase.SetBytes(FileSize(xml_staged_path));
+                }
+                if (!passed) {
+                    ProgressLog("error", "Failed to serialize the assembly tree; the model was not modified.");
+                    return StoreSampleRolledBack;
+                }
+                {
+                    ProgressPhase phase("generate_scs");
+                    model.GenerateSCSFile(scs_staged_path.c_str());
+                    phase.SetBytes(FileSize(scs_staged_path));
+                }
+                {
+                    ProgressPhase phase("generate_scz");
+                    model.GenerateSCZFile(scz_staged_path.c_str());
+                    phase.SetBytes(FileSize(scz_staged_path));
+                }
+                if (CancelRequested("generate"))
+                    return StoreSampleCancelled;
+                {
+                    ProgressPhase phase("commit");
+                    std::string error;
+                    if (!transaction.Commit(error)) {
+                        ProgressLog("error", "Failed to publish the model: %s", error.c_str());
+                        return 1;
+                    }
+                }
+                ProgressLog("info", "Authoring Complete  ::  %zu operations committed.", transaction.Operations());
             }
             else
             {
-                printf("Could not load XML. Assembly Tree Major Version must be >= %u\n", SC::Store::AssemblyTree::MAJOR_VERSION);
+                ProgressLog("error", "Could not load XML. Assembly Tree Major Version must be >= %u", SC::Store::AssemblyTree::MAJOR_VERSION);
             }
         }
     }
     catch (std::exception const &e)
     {
-        std::string message("Exception: ");
-        message.append(e.what());
-        message.append("\n");
-        logger.Message(message.c_str());
+        ProgressLog("error", "Exception: %s", e.what());
         return 1;
     }
 
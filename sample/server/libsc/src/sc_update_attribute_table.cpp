@@ -0,0 +1,512 @@
+#include "sc_update_attribute_table.h"
+
+#include <algorithm>
+#include <ctype.h>
+#include <fcntl.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <utility>
+
+#include "sc_update_parallel.h"
+#include "sc_update_validate.h"
+
+namespace
+{
+    // Read-only mapping of a whole file. Empty files map to an empty range.
+    class MappedFile
+    {
+    public:
+        ~MappedFile()
+        {
+            if (_data != nullptr)
+                munmap(_data, _size);
+        }
+
+        bool Open(std::string const &path, std::string &error)
+        {
+            int const fd = open(path.c_str(), O_RDONLY);
+            if (fd < 0)
+            {
+                error = "cannot open " + path;
+                return false;
+            }
+            struct stat file_stat;
+            bool ok = fstat(fd, &file_stat) == 0;
+            if (ok && file_stat.st_size > 0)
+            {
+                void *data = mmap(nullptr, (size_t)file_stat.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+                ok = data != MAP_FAILED;
+                if (ok)
+                {
+                    _data = data;
+                    _size = (size_t)file_stat.st_size;
+                    madvise(_data, _size, MADV_SEQUENTIAL);
+                }
+            }
+            close(fd);
+            if (!ok)
+                error = "cannot map " + path;
+            return ok;
+        }
+
+        char const *Begin() const { return (char const *)_data; }
+        char const *End() const { return (char const *)_data + _size; }
+        size_t Size() const { return _size; }
+
+    private:
+        void *_data = nullptr;
+        size_t _size = 0;
+    };
+
+    bool
+    IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    bool
+    EqualsIgnoringCase(std::string const &a, char const *b)
+    {
+        size_t const length = strlen(b);
+        if (a.size() != length)
+            return false;
+        for (size_t i = 0; i < length; ++i)
+        {
+            if (tolower((unsigned char)a[i]) != tolower((unsigned char)b[i]))
+                return false;
+        }
+        return true;
+    }
+
+    void
+    DecodeXml(char const *begin, char const *end, std::string &out)
+    {
+        out.clear();
+        while (begin < end)
+        {
+            char const *amp = (char const *)memchr(begin, '&', (size_t)(end - begin));
+            if (amp == nullptr)
+            {
+                out.append(begin, end);
+                return;
+            }
+            out.append(begin, amp);
+            char const *semicolon = (char const *)memchr(amp, ';', (size_t)(end - amp));
+            if (semicolon == nullptr)
+            {
+                out.append(amp, end);
+                return;
+            }
+            std::string const entity(amp + 1, semicolon);
+            if (entity == "amp")
+                out += '&';
+            else if (entity == "lt")
+                out += '<';
+            else if (entity == "gt")
+                out += '>';
+            else if (entity == "quot")
+                out += '"';
+            else if (entity == "apos")
+                out += '\'';
+            else if (entity.size() > 1 && entity[0] == '#')
+            {
+                unsigned long const code = entity[1] == 'x' ? strtoul(entity.c_str() + 2, nullptr, 16) : strtoul(entity.c_str() + 1, nullptr, 10);
+                // UTF-8 encode.
+                if (code < 0x80)
+                    out += (char)code;
+                else if (code < 0x800)
+                    out += (char)(0xC0 | (code >> 6)), out += (char)(0x80 | (code & 0x3F));
+                else if (code < 0x10000)
+                    out += (char)(0xE0 | (code >> 12)), out += (char)(0x80 | ((code >> 6) & 0x3F)), out += (char)(0x80 | (code & 0x3F));
+                else
+                    out += (char)(0xF0 | (code >> 18)), out += (char)(0x80 | ((code >> 12) & 0x3F)), out += (char)(0x80 | ((code >> 6) & 0x3F)),
+                        out += (char)(0x80 | (code & 0x3F));
+            }
+            else
+                out.append(amp, semicolon + 1);
+            begin = semicolon + 1;
+        }
+    }
+
+    // One field of a delimited line starting at cursor. Leaves cursor after the delimiter, or at
+    // line_end after the last field. Returns false for a malformed quoted field.
+    bool
+    ReadField(char const *&cursor, char const *line_end, char delimiter, std::string &out)
+    {
+        out.clear();
+        if (cursor < line_end && *cursor == '"')
+        {
+            ++cursor;
+            for (;;)
+            {
+                char const *quote = (char const *)memchr(cursor, '"', (size_t)(line_end - cursor));
+                if (quote == nullptr)
+                    return false;
+                out.append(cursor, quote);
+                cursor = quote + 1;
+                if (cursor < line_end && *cursor == '"')
+                {
+                    out += '"';
+                    ++cursor;
+                    continue;
+                }
+                break;
+            }
+            if (cursor < line_end && *cursor != delimiter)
+                return false;
+        }
+        else
+        {
+            char const *next = (char const *)memchr(cursor, delimiter, (size_t)(line_end - cursor));
+            char const *field_end = next != nullptr ? next : line_end;
+            out.append(cursor, field_end);
+            cursor = field_end;
+        }
+        if (cursor < line_end)
+            ++cursor;
+        return true;
+    }
+
+    struct ParsedRow
+    {
+        std::vector<SC::Store::NodeId> const *nodes;
+        char const *name, *value; // Interned in Chunk::strings.
+    };
+
+    struct Chunk
+    {
+        char const *begin = nullptr, *end = nullptr;
+        size_t lines = 0;
+        size_t rows = 0, unresolved = 0, malformed = 0;
+        StringPool strings; // Names and values; the same few names repeat on every row.
+        std::vector<ParsedRow> parsed;
+        std::vector<std::pair<size_t, std::string>> issues; // Chunk-local line, message.
+    };
+
+    size_t const max_issues = 16;
+
+    void
+    ParseChunk(Chunk &chunk, AttributeKeyIndex const &index, char delimiter, bool skip_header)
+    {
+        std::string key, name, value;
+        auto issue = [&chunk](std::string const &message) {
+            if (chunk.issues.size() < max_issues)
+                chunk.issues.emplace_back(chunk.lines, message);
+        };
+
+        for (char const *line = chunk.begin; line < chunk.end;)
+        {
+            char const *newline = (char const *)memchr(line, '\n', (size_t)(chunk.end - line));
+            char const *line_end = newline != nullptr ? newline : chunk.end;
+            char const *next_line = newline != nullptr ? newline + 1 : chunk.end;
+            if (line_end > line && line_end[-1] == '\r')
+                --line_end;
+            ++chunk.lines;
+            char const *cursor = line;
+            line = next_line;
+            if (cursor == line_end)
+                continue;
+
+            if (!ReadField(cursor, line_end, delimiter, key))
+            {
+                ++chunk.rows, ++chunk.malformed;
+                issue("unterminated quote");
+                continue;
+            }
+            if (skip_header)
+            {
+                skip_header = false;
+                if (EqualsIgnoringCase(key, index.KeyAttribute().c_str()) || EqualsIgnoringCase(key, "partNumber"))
+                    continue;
+            }
+            ++chunk.rows;
+            bool const has_name = cursor < line_end && ReadField(cursor, line_end, delimiter, name) && !name.empty();
+            if (!has_name || key.empty() || !ReadField(cursor, line_end, delimiter, value) || cursor != line_end)
+            {
+                ++chunk.malformed;
+                issue("expected key, attribute and value");
+                continue;
+            }
+            std::vector<SC::Store::NodeId> const *nodes = index.Find(key);
+            if (nodes == nullptr)
+            {
+                ++chunk.unresolved;
+                issue("no node has " + index.KeyAttribute() + " " + key);
+                continue;
+            }
+            ParsedRow row;
+            row.nodes = nodes;
+            row.name = chunk.strings.Intern(name);
+            row.value = chunk.strings.Intern(value);
+            chunk.parsed.push_back(row);
+        }
+    }
+
+    char
+    DetectDelimiter(std::string const &path, char const *begin, char const *end)
+    {
+        size_t const dot = path.find_last_of('.');
+        if (dot != std::string::npos && (path.compare(dot, std::string::npos, ".tsv") == 0 || path.compare(dot, std::string::npos, ".tab") == 0))
+            return '\t';
+        for (char const *c = begin; c < end && *c != '\n'; ++c)
+        {
+            if (*c == '\t' || *c == ',')
+                return *c;
+        }
+        return ',';
+    }
+}
+
+bool
+ReadAttributeTableSources(JsonValue const &tables, std::vector<AttributeTableSource> &out, std::string &error)
+{
+    out.clear();
+    if (tables.getTag() != JSON_ARRAY)
+    {
+        error = "attributeTables must be an array";
+        return false;
+    }
+    for (auto entry : tables)
+    {
+        AttributeTableSource source;
+        if (entry->value.getTag() == JSON_OBJECT)
+        {
+            for (auto item : entry->value)
+            {
+                if (item->value.getTag() != JSON_STRING)
+                    continue;
+                if (strcmp(item->key, "file") == 0)
+                    source.file = item->value.toString();
+                else if (strcmp(item->key, "keyAttribute") == 0)
+                    source.key_attribute = item->value.toString();
+                else if (strcmp(item->key, "delimiter") == 0 && strlen(item->value.toString()) == 1)
+                    source.delimiter = item->value.toString()[0];
+            }
+        }
+        if (source.file.empty() || source.key_attribute.empty())
+        {
+            error = "attribute table entry needs a file and keyAttribute";
+            return false;
+        }
+        out.push_back(source);
+    }
+    return true;
+}
+
+std::string
+AttributeTableDirectory(std::string const &model_folder)
+{
+    const char *directory = getenv("SC_UPDATE_ATTRIBUTE_DIR");
+    if (directory != nullptr && directory[0] != '\0')
+        return directory;
+    return model_folder + "/attributes";
+}
+
+bool
+ResolveAttributeTablePath(std::string const &directory, std::string const &file, std::string &path, std::string &error)
+{
+    if (file.empty() || file[0] == '/' || file.find('\\') != std::string::npos)
+    {
+        error = "attribute table " + file + " must be a relative path";
+        return false;
+    }
+    for (size_t begin = 0; begin <= file.size();)
+    {
+        size_t end = file.find('/', begin);
+        if (end == std::string::npos)
+            end = file.size();
+        if (file.compare(begin, end - begin, "..") == 0)
+        {
+            error = "attribute table " + file + " may not leave the attribute directory";
+            return false;
+        }
+        begin = end + 1;
+    }
+    path = directory + "/" + file;
+    return true;
+}
+
+bool
+AttributeKeyIndex::Load(std::string const &xml_path, std::string const &key_attribute, std::string &error)
+{
+    _key_attribute = key_attribute;
+    _keys = StringPool();
+    _nodes.clear();
+
+    MappedFile xml;
+    if (!xml.Open(xml_path, error))
+        return false;
+
+    // Owner of the attributes at each open element: its own Id if it is a tree node, otherwise the
+    // enclosing node's. Face and Edge ids are local to their body and never own attributes.
+    SC::Store::NodeId const no_owner = (SC::Store::NodeId)-1;
+    std::vector<SC::Store::NodeId> owners;
+    std::string key;
+    char const *const end = xml.End();
+    for (char const *cursor = xml.Begin(); cursor < end;)
+    {
+        char const *tag = (char const *)memchr(cursor, '<', (size_t)(end - cursor));
+        if (tag == nullptr || tag + 1 >= end)
+            break;
+        if (tag[1] == '/' || tag[1] == '?' || tag[1] == '!')
+        {
+            if (tag[1] == '/' && !owners.empty())
+                owners.pop_back();
+            char const *close = (char const *)memchr(tag, '>', (size_t)(end - tag));
+            if (tag[1] == '!' && end - tag >= 4 && memcmp(tag, "<!--", 4) == 0)
+            {
+                static char const comment_close[] = "-->";
+                char const *comment_end = std::search(tag + 4, end, comment_close, comment_close + 3);
+                close = comment_end < end ? comment_end + 2 : nullptr;
+            }
+            if (close == nullptr)
+                break;
+            cursor = close + 1;
+            continue;
+        }
+
+        char const *name_end = tag + 1;
+        while (name_end < end && !IsSpace(*name_end) && *name_end != '>' && *name_end != '/')
+            ++name_end;
+        bool const is_attr = name_end - tag - 1 == 4 && memcmp(tag + 1, "Attr", 4) == 0;
+        bool const is_node = IsAssemblyNodeElement(tag + 1, (size_t)(name_end - tag - 1));
+
+        bool has_id = false, is_key = false;
+        SC::Store::NodeId id = 0;
+        char const *value_begin = nullptr, *value_end = nullptr;
+        bool self_closing = false;
+        cursor = name_end;
+        for (;;)
+        {
+            while (cursor < end && IsSpace(*cursor))
+                ++cursor;
+            if (cursor >= end)
+            {
+                error = "unterminated element in " + xml_path;
+                return false;
+            }
+            if (*cursor == '>' || *cursor == '/')
+            {
+                self_closing = *cursor == '/';
+                cursor = (char const *)memchr(cursor, '>', (size_t)(end - cursor));
+                cursor = cursor != nullptr ? cursor + 1 : end;
+                break;
+            }
+            char const *equals = (char const *)memchr(cursor, '=', (size_t)(end - cursor));
+            if (equals == nullptr || equals + 1 >= end || (equals[1] != '"' && equals[1] != '\''))
+            {
+                error = "malformed attribute in " + xml_path;
+                return false;
+            }
+            char const *attribute_value = equals + 2;
+            char const *attribute_end = (char const *)memchr(attribute_value, equals[1], (size_t)(end - attribute_value));
+            if (attribute_end == nullptr)
+            {
+                error = "unterminated attribute in " + xml_path;
+                return false;
+            }
+            size_t const attribute_length = (size_t)(equals - cursor);
+            if (is_attr)
+            {
+                if (attribute_length == 4 && memcmp(cursor, "Name", 4) == 0)
+                    is_key = (size_t)(attribute_end - attribute_value) == _key_attribute.size() &&
+                             memcmp(attribute_value, _key_attribute.data(), _key_attribute.size()) == 0;
+                else if (attribute_length == 5 && memcmp(cursor, "Value", 5) == 0)
+                    value_begin = attribute_value, value_end = attribute_end;
+            }
+            else if (is_node && attribute_length == 2 && memcmp(cursor, "Id", 2) == 0)
+            {
+                id = (SC::Store::NodeId)strtoul(attribute_value, nullptr, 10);
+                has_id = true;
+            }
+            cursor = attribute_end + 1;
+        }
+
+        SC::Store::NodeId const owner = has_id ? id : (owners.empty() ? no_owner : owners.back());
+        if (is_attr && is_key && value_begin != nullptr && owner != no_owner)
+        {
+            DecodeXml(value_begin, value_end, key);
+            std::vector<SC::Store::NodeId> &nodes = _nodes[_keys.Intern(key)];
+            if (nodes.empty() || nodes.back() != owner)
+                nodes.push_back(owner);
+        }
+        if (!self_closing)
+            owners.push_back(owner);
+    }
+    return true;
+}
+
+std::vector<SC::Store::NodeId> const *
+AttributeKeyIndex::Find(std::string const &key) const
+{
+    char const *interned = _keys.Find(key);
+    if (interned == nullptr)
+        return nullptr;
+    auto found = _nodes.find(interned);
+    return found != _nodes.end() ? &found->second : nullptr;
+}
+
+bool
+ImportAttributeTable(SC::Store::AssemblyTree &assembly_tree, AttributeKeyIndex const &index, std::string const &path,
+                     char delimiter, AttributeTableResult &result, std::string &error)
+{
+    result = AttributeTableResult();
+    MappedFile table;
+    if (!table.Open(path, error))
+        return false;
+    char const *const begin = table.Begin();
+    char const *const end = table.End();
+    if (delimiter == 0)
+        delimiter = DetectDelimiter(path, begin, end);
+
+    // Chunks of whole lines, a few per worker so uneven lines balance out.
+    size_t const min_chunk_bytes = 1 << 20;
+    size_t const chunk_bytes = std::max(min_chunk_bytes, table.Size() / (ParallelWorkerCount() * 4 + 1) + 1);
+    std::vector<Chunk> chunks;
+    for (char const *chunk_begin = begin; chunk_begin < end;)
+    {
+        char const *chunk_end = chunk_begin + std::min(chunk_bytes, (size_t)(end - chunk_begin));
+        if (chunk_end < end)
+        {
+            char const *newline = (char const *)memchr(chunk_end, '\n', (size_t)(end - chunk_end));
+            chunk_end = newline != nullptr ? newline + 1 : end;
+        }
+        Chunk chunk;
+        chunk.begin = chunk_begin;
+        chunk.end = chunk_end;
+        chunks.push_back(std::move(chunk));
+        chunk_begin = chunk_end;
+    }
+
+    ParallelFor(chunks.size(), [&](size_t i) { ParseChunk(chunks[i], index, delimiter, i == 0); });
+
+    // The tree is not thread-safe: apply on this thread, in file order.
+    size_t first_line = 1;
+    for (Chunk const &chunk : chunks)
+    {
+        result.rows += chunk.rows;
+        result.unresolved += chunk.unresolved;
+        result.malformed += chunk.malformed;
+        for (auto const &issue : chunk.issues)
+        {
+            if (result.errors.size() < max_issues)
+                result.errors.push_back("line " + std::to_string(first_line + issue.first - 1) + ": " + issue.second);
+        }
+        for (ParsedRow const &row : chunk.parsed)
+        {
+            for (SC::Store::NodeId node_id : *row.nodes)
+            {
+                if (assembly_tree.AddAttribute(node_id, row.name, SC::Store::AssemblyTree::AttributeTypeString, row.value))
+                    ++result.attributes;
+                else
+                    ++result.failed;
+            }
+        }
+        first_line += chunk.lines;
+    }
+    return true;
+}
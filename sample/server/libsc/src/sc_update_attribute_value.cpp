@@ -0,0 +1,125 @@
+#include "sc_update_attribute_value.h"
+
+#include <cmath>
+#include <stdio.h>
+#include <stdlib.h>
+
+namespace
+{
+    // Reads exactly count digits, within [min, max].
+    bool
+    ReadDigits(char const *&text, int count, int min, int max)
+    {
+        int value = 0;
+        for (int i = 0; i < count; ++i, ++text)
+        {
+            if (*text < '0' || *text > '9')
+                return false;
+            value = value * 10 + (*text - '0');
+        }
+        return value >= min && value <= max;
+    }
+
+    bool
+    ReadSeparator(char const *&text, char separator)
+    {
+        if (*text != separator)
+            return false;
+        ++text;
+        return true;
+    }
+}
+
+bool
+IsIsoDate(char const *text)
+{
+    if (!ReadDigits(text, 4, 0, 9999) || !ReadSeparator(text, '-') || !ReadDigits(text, 2, 1, 12) || !ReadSeparator(text, '-') ||
+        !ReadDigits(text, 2, 1, 31))
+        return false;
+    if (*text == '\0')
+        return true;
+    if (!ReadSeparator(text, 'T') || !ReadDigits(text, 2, 0, 23) || !ReadSeparator(text, ':') || !ReadDigits(text, 2, 0, 59))
+        return false;
+    if (*text == ':')
+    {
+        ++text;
+        // 60 allows a leap second.
+        if (!ReadDigits(text, 2, 0, 60))
+            return false;
+        if (*text == '.')
+        {
+            char const *fraction = ++text;
+            while (*text >= '0' && *text <= '9')
+                ++text;
+            if (text == fraction)
+                return false;
+        }
+    }
+    if (*text == 'Z')
+        return text[1] == '\0';
+    if (*text == '+' || *text == '-')
+    {
+        ++text;
+        return ReadDigits(text, 2, 0, 23) && ReadSeparator(text, ':') && ReadDigits(text, 2, 0, 59) && *text == '\0';
+    }
+    return *text == '\0';
+}
+
+bool
+ReadTypedAttributeValue(JsonValue const &value, TypedAttributeValue &out)
+{
+    switch (value.getTag())
+    {
+    case JSON_NUMBER:
+    {
+        double const number = value.toNumber();
+        // Integral values that survive the round trip through a 64-bit integer.
+        if (std::floor(number) == number && std::fabs(number) < 9.0e15)
+        {
+            out.type = SC::Store::AssemblyTree::AttributeTypeInt;
+            snprintf(out.buffer, sizeof(out.buffer), "%lld", (long long)number);
+        }
+        else
+        {
+            out.type = SC::Store::AssemblyTree::AttributeTypeFloat;
+            // Shortest of 15 or 17 digits that reads back as the same double.
+            snprintf(out.buffer, sizeof(out.buffer), "%.15g", number);
+            if (strtod(out.buffer, nullptr) != number)
+                snprintf(out.buffer, sizeof(out.buffer), "%.17g", number);
+        }
+        out.text = out.buffer;
+        return true;
+    }
+    case JSON_TRUE:
+    case JSON_FALSE:
+        out.type = SC::Store::AssemblyTree::AttributeTypeInt;
+        out.buffer[0] = value.getTag() == JSON_TRUE ? '1' : '0';
+        out.buffer[1] = '\0';
+        out.text = out.buffer;
+        return true;
+    case JSON_STRING:
+        out.text = value.toString();
+        out.type = IsIsoDate(out.text) ? SC::Store::AssemblyTree::AttributeTypeTime : SC::Store::AssemblyTree::AttributeTypeString;
+        return true;
+    default:
+        return false;
+    }
+}
+
+char const *
+AttributeTypeName(SC::Store::AssemblyTree::AttributeType type)
+{
+    switch (type)
+    {
+    case SC::Store::AssemblyTree::AttributeTypeInt:
+        return "int";
+    case SC::Store::AssemblyTree::AttributeTypeFloat:
+        return "float";
+    case SC::Store::AssemblyTree::AttributeTypeTime:
+        return "time";
+    case SC::Store::AssemblyTree::AttributeTypeString:
+        return "string";
+    default:
+        return "undefined";
+    }
+}
@@ -0,0 +1,173 @@
+#include "sc_update_bounds.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+#if defined(__SSE__) || defined(_M_X64)
+#include <xmmintrin.h>
+#define SC_UPDATE_BOUNDS_SSE 1
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#define SC_UPDATE_BOUNDS_NEON 1
+#endif
+
+static_assert(sizeof(SC::Store::Point) == 3 * sizeof(float), "points are read as packed float32 x,y,z");
+
+void
+Bounds::Add(SC::Store::Point const &point_min, SC::Store::Point const &point_max)
+{
+    if (empty)
+    {
+        min = point_min, max = point_max;
+        empty = false;
+        return;
+    }
+    min.x = std::min(min.x, point_min.x), max.x = std::max(max.x, point_max.x);
+    min.y = std::min(min.y, point_min.y), max.y = std::max(max.y, point_max.y);
+    min.z = std::min(min.z, point_min.z), max.z = std::max(max.z, point_max.z);
+}
+
+void
+Bounds::Add(Bounds const &that)
+{
+    if (!that.empty)
+        Add(that.min, that.max);
+}
+
+SC::Store::BBox
+Bounds::ToBBox() const
+{
+    return SC::Store::BBox(min.x, max.x, min.y, max.y, min.z, max.z);
+}
+
+void
+AddPointBounds(SC::Store::Point const *points, size_t count, Bounds &bounds)
+{
+    size_t i = 0;
+#if defined(SC_UPDATE_BOUNDS_SSE) || defined(SC_UPDATE_BOUNDS_NEON)
+    // Four packed points are three registers, xyzx yzxy zxyz; every lane keeps its own coordinate
+    // across iterations, so stored back the registers read as four points again.
+    if (count >= 4)
+    {
+        float const *values = (float const *)points;
+        float lanes_min[12], lanes_max[12];
+#if defined(SC_UPDATE_BOUNDS_SSE)
+        __m128 min0 = _mm_loadu_ps(values), min1 = _mm_loadu_ps(values + 4), min2 = _mm_loadu_ps(values + 8);
+        __m128 max0 = min0, max1 = min1, max2 = min2;
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            float const *block = values + i * 3;
+            __m128 const a = _mm_loadu_ps(block), b = _mm_loadu_ps(block + 4), c = _mm_loadu_ps(block + 8);
+            min0 = _mm_min_ps(min0, a), min1 = _mm_min_ps(min1, b), min2 = _mm_min_ps(min2, c);
+            max0 = _mm_max_ps(max0, a), max1 = _mm_max_ps(max1, b), max2 = _mm_max_ps(max2, c);
+        }
+        _mm_storeu_ps(lanes_min, min0), _mm_storeu_ps(lanes_min + 4, min1), _mm_storeu_ps(lanes_min + 8, min2);
+        _mm_storeu_ps(lanes_max, max0), _mm_storeu_ps(lanes_max + 4, max1), _mm_storeu_ps(lanes_max + 8, max2);
+#else
+        float32x4_t min0 = vld1q_f32(values), min1 = vld1q_f32(values + 4), min2 = vld1q_f32(values + 8);
+        float32x4_t max0 = min0, max1 = min1, max2 = min2;
+        for (i = 4; i + 4 <= count; i += 4)
+        {
+            float const *block = values + i * 3;
+            float32x4_t const a = vld1q_f32(block), b = vld1q_f32(block + 4), c = vld1q_f32(block + 8);
+            min0 = vminq_f32(min0, a), min1 = vminq_f32(min1, b), min2 = vminq_f32(min2, c);
+            max0 = vmaxq_f32(max0, a), max1 = vmaxq_f32(max1, b), max2 = vmaxq_f32(max2, c);
+        }
+        vst1q_f32(lanes_min, min0), vst1q_f32(lanes_min + 4, min1), vst1q_f32(lanes_min + 8, min2);
+        vst1q_f32(lanes_max, max0), vst1q_f32(lanes_max + 4, max1), vst1q_f32(lanes_max + 8, max2);
+#endif
+        for (int lane = 0; lane < 4; ++lane)
+        {
+            bounds.Add(SC::Store::Point(lanes_min[lane * 3], lanes_min[lane * 3 + 1], lanes_min[lane * 3 + 2]),
+                       SC::Store::Point(lanes_max[lane * 3], lanes_max[lane * 3 + 1], lanes_max[lane * 3 + 2]));
+        }
+    }
+#endif
+    for (; i < count; ++i)
+        bounds.Add(points[i], points[i]);
+}
+
+Bounds
+TransformBounds(Bounds const &bounds, SC::Store::Matrix3d const &matrix)
+{
+    Bounds out;
+    if (bounds.empty)
+        return out;
+    float const *m = matrix.m;
+    for (int corner = 0; corner < 8; ++corner)
+    {
+        float const x = (corner & 1) ? bounds.max.x : bounds.min.x;
+        float const y = (corner & 2) ? bounds.max.y : bounds.min.y;
+        float const z = (corner & 4) ? bounds.max.z : bounds.min.z;
+        SC::Store::Point const p(x * m[0] + y * m[3] + z * m[6] + m[9], x * m[1] + y * m[4] + z * m[7] + m[10],
+                                 x * m[2] + y * m[5] + z * m[8] + m[11]);
+        out.Add(p, p);
+    }
+    return out;
+}
+
+bool
+BoundsVerificationFromEnvironment()
+{
+    const char *verify = getenv("SC_UPDATE_VERIFY_BOUNDS");
+    return verify != nullptr && atoi(verify) != 0;
+}
+
+NodeBoundsRollup::Node *
+NodeBoundsRollup::Find(SC::Store::NodeId node_id)
+{
+    auto found = _index.find(node_id);
+    return found != _index.end() ? &_nodes[found->second] : nullptr;
+}
+
+void
+NodeBoundsRollup::AddNode(SC::Store::NodeId node_id, SC::Store::NodeId parent_node_id)
+{
+    Node node;
+    node.node_id = node_id;
+    node.parent_node_id = parent_node_id;
+    auto parent = _index.find(parent_node_id);
+    node.parent = parent != _index.end() ? parent->second : no_parent;
+    node.has_local_transform = false;
+    _index[node_id] = _nodes.size();
+    _nodes.push_back(node);
+}
+
+void
+NodeBoundsRollup::AddContent(SC::Store::NodeId node_id, Bounds const &bounds)
+{
+    if (Node *node = Find(node_id))
+        node->bounds.Add(bounds);
+}
+
+void
+NodeBoundsRollup::SetLocalTransform(SC::Store::NodeId node_id, SC::Store::Matrix3d const &matrix)
+{
+    if (Node *node = Find(node_id))
+    {
+        node->has_local_transform = true;
+        node->local_transform = matrix;
+    }
+}
+
+size_t
+NodeBoundsRollup::Apply(SC::Store::AssemblyTree &assembly_tree)
+{
+    // Children come after their parents, so walking backwards finishes every child first.
+    _total = Bounds();
+    size_t applied = 0;
+    for (size_t i = _nodes.size(); i-- > 0;)
+    {
+        Node const &node = _nodes[i];
+        if (node.bounds.empty)
+            continue;
+        if (assembly_tree.SetBoundingBox(node.node_id, node.bounds.ToBBox()))
+            ++applied;
+        Bounds const in_parent = node.has_local_transform ? TransformBounds(node.bounds, node.local_transform) : node.bounds;
+        if (node.parent != no_parent)
+            _nodes[node.parent].bounds.Add(in_parent);
+        else
+            _total.Add(in_parent);
+    }
+    return applied;
+}
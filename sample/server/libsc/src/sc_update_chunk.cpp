@@ -0,0 +1,320 @@
+#include "sc_update_chunk.h"
+
+#include <algorithm>
+#include <stdlib.h>
+
+namespace
+{
+    // Upper bound of the bytes one more index group can add to a chunk: its indices plus a new
+    // value in every attribute array.
+    const uint64_t MaxGroupBytes = 4 * sizeof(uint32_t) + sizeof(SC::Store::Point) + sizeof(SC::Store::Normal) +
+                                   sizeof(SC::Store::UV) + sizeof(SC::Store::RGBA32);
+
+    uint32_t
+    SpreadBits(uint32_t value)
+    {
+        value &= 0x3ff;
+        value = (value | (value << 16)) & 0x030000ff;
+        value = (value | (value << 8)) & 0x0300f00f;
+        value = (value | (value << 4)) & 0x030c30c3;
+        value = (value | (value << 2)) & 0x09249249;
+        return value;
+    }
+
+    // Polylines are cut into pieces of at most this many vertices, so they sort and split like
+    // the other primitives. Consecutive pieces share their end vertex and the line stays closed.
+    const uint32_t MaxLinePieceVertices = 256;
+
+    enum PrimitiveKind
+    {
+        FacePrimitive,
+        LinePrimitive,
+        PointPrimitive
+    };
+
+    // A face triangle, a polyline piece or a point vertex, ordered by the Morton code of its centroid.
+    struct Primitive
+    {
+        uint32_t morton;
+        uint32_t element;
+        uint32_t offset;
+        uint32_t corners;
+    };
+
+    // Builds chunks one at a time, copying only the attribute values each chunk references.
+    class ChunkWriter
+    {
+    public:
+        ChunkWriter(AuthoredMesh const &mesh, std::vector<AuthoredMesh> &chunks)
+            : _mesh(mesh), _chunks(chunks), _chunk_id(0), _bytes(0)
+        {
+            _local[PointAttribute].assign(mesh.points.size(), 0);
+            _local[NormalAttribute].assign(mesh.normals.size(), 0);
+            _local[UVAttribute].assign(mesh.uvs.size(), 0);
+            _local[RGBA32Attribute].assign(mesh.rgba32s.size(), 0);
+            for (int kind = 0; kind < MeshAttributeCount; ++kind)
+                _stamp[kind].assign(_local[kind].size(), 0);
+        }
+
+        void
+        Begin()
+        {
+            ++_chunk_id;
+            _bytes = 0;
+            _face_elements.assign(_mesh.mesh.face_elements.size(), -1);
+            _point_elements.assign(_mesh.mesh.point_elements.size(), -1);
+            _chunks.emplace_back();
+            AuthoredMesh &chunk = _chunks.back();
+            chunk.node_id = _mesh.node_id;
+            chunk.parent_node_id = _mesh.parent_node_id;
+            chunk.mesh.flags = _mesh.mesh.flags;
+            chunk.face_color = _mesh.face_color;
+            chunk.line_color = _mesh.line_color;
+            chunk.point_color = _mesh.point_color;
+        }
+
+        void
+        End()
+        {
+            _chunks.back().Bind();
+        }
+
+        bool
+        Empty() const
+        {
+            return _bytes == 0;
+        }
+
+        uint32_t
+        PointCount() const
+        {
+            return (uint32_t)_chunks.back().points.size();
+        }
+
+        uint64_t
+        Bytes() const
+        {
+            return _bytes;
+        }
+
+        // Points a group of corners would add to the current chunk.
+        uint32_t
+        NewPoints(std::vector<uint32_t> const &indices, uint32_t offset, uint32_t corners, uint32_t stride) const
+        {
+            uint32_t count = 0;
+            for (uint32_t c = 0; c < corners; ++c)
+                count += _stamp[PointAttribute][indices[offset + c * stride]] != _chunk_id ? 1 : 0;
+            return count;
+        }
+
+        void
+        AddCorners(std::vector<uint32_t> const &source, uint32_t offset, uint32_t corners, IndexLayout const &layout,
+                   std::vector<uint32_t> &target)
+        {
+            for (uint32_t i = 0; i < corners * layout.stride; ++i)
+                target.push_back(Local(layout.slots[i % layout.stride], source[offset + i]));
+            _bytes += corners * layout.stride * sizeof(uint32_t);
+        }
+
+        std::vector<uint32_t> &
+        FaceElement(uint32_t element)
+        {
+            return Element(_chunks.back().mesh.face_elements, _face_elements, element);
+        }
+
+        std::vector<uint32_t> &
+        PointElement(uint32_t element)
+        {
+            return Element(_chunks.back().mesh.point_elements, _point_elements, element);
+        }
+
+        // Every polyline piece is a polyline of its own; appending it to another would join them.
+        std::vector<uint32_t> &
+        LineElement()
+        {
+            std::vector<SC::Store::MeshElement> &elements = _chunks.back().mesh.polyline_elements;
+            elements.emplace_back();
+            return elements.back().indices;
+        }
+
+    private:
+        std::vector<uint32_t> &
+        Element(std::vector<SC::Store::MeshElement> &elements, std::vector<int> &map, uint32_t element)
+        {
+            if (map[element] < 0)
+            {
+                map[element] = (int)elements.size();
+                elements.emplace_back();
+            }
+            return elements[map[element]].indices;
+        }
+
+        uint32_t
+        Local(MeshAttribute kind, uint32_t index)
+        {
+            if (_stamp[kind][index] == _chunk_id)
+                return _local[kind][index];
+
+            AuthoredMesh &chunk = _chunks.back();
+            uint32_t local = 0;
+            switch (kind)
+            {
+            case PointAttribute:
+                local = (uint32_t)chunk.points.size();
+                chunk.points.push_back(_mesh.points[index]);
+                _bytes += sizeof(SC::Store::Point);
+                break;
+            case NormalAttribute:
+                local = (uint32_t)chunk.normals.size();
+                chunk.normals.push_back(_mesh.normals[index]);
+                _bytes += sizeof(SC::Store::Normal);
+                break;
+            case UVAttribute:
+                local = (uint32_t)chunk.uvs.size();
+                chunk.uvs.push_back(_mesh.uvs[index]);
+                _bytes += sizeof(SC::Store::UV);
+                break;
+            default:
+                local = (uint32_t)chunk.rgba32s.size();
+                chunk.rgba32s.push_back(_mesh.rgba32s[index]);
+                _bytes += sizeof(SC::Store::RGBA32);
+                break;
+            }
+            _stamp[kind][index] = _chunk_id;
+            _local[kind][index] = local;
+            return local;
+        }
+
+        AuthoredMesh const &_mesh;
+        std::vector<AuthoredMesh> &_chunks;
+        std::vector<uint32_t> _local[MeshAttributeCount];
+        std::vector<uint32_t> _stamp[MeshAttributeCount];
+        uint32_t _chunk_id;
+        uint64_t _bytes;
+        std::vector<int> _face_elements;
+        std::vector<int> _point_elements;
+    };
+}
+
+ChunkOptions
+ChunkOptionsFromEnvironment()
+{
+    ChunkOptions options;
+    if (const char *vertices = getenv("SC_UPDATE_CHUNK_VERTICES"))
+        options.max_vertices = (uint32_t)strtoul(vertices, nullptr, 10);
+    if (const char *bytes = getenv("SC_UPDATE_CHUNK_BYTES"))
+        options.max_bytes = strtoull(bytes, nullptr, 10);
+    return options;
+}
+
+bool
+SplitAuthoredMesh(AuthoredMesh const &mesh, ChunkOptions const &options, std::vector<AuthoredMesh> &chunks)
+{
+    chunks.clear();
+    uint32_t const max_vertices = options.max_vertices > 0 ? std::max(options.max_vertices, 3u) : ~0u;
+    uint64_t const max_bytes = options.max_bytes > 0 ? std::max<uint64_t>(options.max_bytes, 3 * MaxGroupBytes) : ~0ull;
+    if (mesh.points.size() <= max_vertices && AuthoredMeshBytes(mesh) <= max_bytes)
+        return false;
+
+    SC::Store::Point min_point = mesh.points[0], max_point = mesh.points[0];
+    for (SC::Store::Point const &point : mesh.points)
+    {
+        min_point.x = std::min(min_point.x, point.x), max_point.x = std::max(max_point.x, point.x);
+        min_point.y = std::min(min_point.y, point.y), max_point.y = std::max(max_point.y, point.y);
+        min_point.z = std::min(min_point.z, point.z), max_point.z = std::max(max_point.z, point.z);
+    }
+    float const scale_x = max_point.x > min_point.x ? 1023.0f / (max_point.x - min_point.x) : 0.0f;
+    float const scale_y = max_point.y > min_point.y ? 1023.0f / (max_point.y - min_point.y) : 0.0f;
+    float const scale_z = max_point.z > min_point.z ? 1023.0f / (max_point.z - min_point.z) : 0.0f;
+    auto morton = [&](float x, float y, float z) {
+        return SpreadBits((uint32_t)((x - min_point.x) * scale_x)) | SpreadBits((uint32_t)((y - min_point.y) * scale_y)) << 1 |
+               SpreadBits((uint32_t)((z - min_point.z) * scale_z)) << 2;
+    };
+
+    IndexLayout const face_layout = FaceIndexLayout(mesh.mesh.flags);
+    IndexLayout const line_layout = LineIndexLayout(mesh.mesh.flags);
+    IndexLayout const point_layout = PointIndexLayout(mesh.mesh.flags);
+
+    std::vector<Primitive> triangles;
+    for (uint32_t e = 0; e < (uint32_t)mesh.mesh.face_elements.size(); ++e)
+    {
+        std::vector<uint32_t> const &indices = mesh.mesh.face_elements[e].indices;
+        uint32_t const triangle_size = 3 * face_layout.stride;
+        for (uint32_t offset = 0; offset + triangle_size <= indices.size(); offset += triangle_size)
+        {
+            SC::Store::Point const &a = mesh.points[indices[offset]];
+            SC::Store::Point const &b = mesh.points[indices[offset + face_layout.stride]];
+            SC::Store::Point const &c = mesh.points[indices[offset + 2 * face_layout.stride]];
+            Primitive triangle = {morton((a.x + b.x + c.x) / 3.0f, (a.y + b.y + c.y) / 3.0f, (a.z + b.z + c.z) / 3.0f), e, offset, 3};
+            triangles.push_back(triangle);
+        }
+    }
+    std::vector<Primitive> points;
+    for (uint32_t e = 0; e < (uint32_t)mesh.mesh.point_elements.size(); ++e)
+    {
+        std::vector<uint32_t> const &indices = mesh.mesh.point_elements[e].indices;
+        for (uint32_t offset = 0; offset + point_layout.stride <= indices.size(); offset += point_layout.stride)
+        {
+            SC::Store::Point const &p = mesh.points[indices[offset]];
+            Primitive point = {morton(p.x, p.y, p.z), e, offset, 1};
+            points.push_back(point);
+        }
+    }
+    // A piece must fit in an empty chunk on its own.
+    uint32_t const piece_vertices = (uint32_t)std::max<uint64_t>(
+        2, std::min<uint64_t>(MaxLinePieceVertices, std::min<uint64_t>(max_vertices, max_bytes / MaxGroupBytes)));
+    std::vector<Primitive> pieces;
+    for (uint32_t e = 0; e < (uint32_t)mesh.mesh.polyline_elements.size(); ++e)
+    {
+        std::vector<uint32_t> const &indices = mesh.mesh.polyline_elements[e].indices;
+        uint32_t const vertices = (uint32_t)(indices.size() / line_layout.stride);
+        if (vertices == 0)
+            continue;
+        for (uint32_t first = 0;;)
+        {
+            uint32_t const corners = std::min(piece_vertices, vertices - first);
+            SC::Store::Point centroid(0.0f, 0.0f, 0.0f);
+            for (uint32_t v = first; v < first + corners; ++v)
+            {
+                SC::Store::Point const &p = mesh.points[indices[v * line_layout.stride]];
+                centroid.x += p.x, centroid.y += p.y, centroid.z += p.z;
+            }
+            float const weight = 1.0f / corners;
+            Primitive piece = {morton(centroid.x * weight, centroid.y * weight, centroid.z * weight), e, first * line_layout.stride, corners};
+            pieces.push_back(piece);
+            if (first + corners == vertices)
+                break;
+            first += corners - 1;
+        }
+    }
+    auto by_morton = [](Primitive const &a, Primitive const &b) { return a.morton < b.morton; };
+    std::stable_sort(triangles.begin(), triangles.end(), by_morton);
+    std::stable_sort(pieces.begin(), pieces.end(), by_morton);
+    std::stable_sort(points.begin(), points.end(), by_morton);
+
+    ChunkWriter writer(mesh, chunks);
+    writer.Begin();
+    auto add = [&](std::vector<Primitive> const &primitives, std::vector<SC::Store::MeshElement> const &elements,
+                   IndexLayout const &layout, PrimitiveKind kind) {
+        for (Primitive const &primitive : primitives)
+        {
+            std::vector<uint32_t> const &source = elements[primitive.element].indices;
+            uint32_t const new_points = writer.NewPoints(source, primitive.offset, primitive.corners, layout.stride);
+            if (!writer.Empty() && (writer.PointCount() + new_points > max_vertices ||
+                                    writer.Bytes() + primitive.corners * MaxGroupBytes > max_bytes))
+            {
+                writer.End();
+                writer.Begin();
+            }
+            std::vector<uint32_t> &target = kind == FacePrimitive   ? writer.FaceElement(primitive.element)
+                                            : kind == LinePrimitive ? writer.LineElement()
+                                                                    : writer.PointElement(primitive.element);
+            writer.AddCorners(source, primitive.offset, primitive.corners, layout, target);
+        }
+    };
+    add(triangles, mesh.mesh.face_elements, face_layout, FacePrimitive);
+    add(pieces, mesh.mesh.polyline_elements, line_layout, LinePrimitive);
+    add(points, mesh.mesh.point_elements, point_layout, PointPrimitive);
+    writer.End();
+    return true;
+}
@@ -0,0 +1,204 @@
+#include "sc_update_encode.h"
+#include "sc_update_weld.h"
+
+#include <cmath>
+
+namespace
+{
+    // Corner normals of a triangle closer than this (cosine, about 0.25 degrees) are one flat face normal.
+    const float FlatNormalCosine = 0.99999f;
+
+    // One element type of a mesh with the flag bits of its optional streams.
+    struct ElementType
+    {
+        std::vector<SC::Store::MeshElement> *elements;
+        IndexLayout (*layout)(SC::Store::Mesh::Bits flags);
+        SC::Store::Mesh::Bits normal_bit;
+        SC::Store::Mesh::Bits uv_bit;
+        SC::Store::Mesh::Bits rgba32_bit;
+        UniformColor *color;
+    };
+
+    SC::Store::Normal
+    Normalized(SC::Store::Normal const &normal)
+    {
+        float const length = std::sqrt(normal.x * normal.x + normal.y * normal.y + normal.z * normal.z);
+        if (length == 0.0f)
+            return normal;
+        return SC::Store::Normal(normal.x / length, normal.y / length, normal.z / length);
+    }
+
+    float
+    Dot(SC::Store::Normal const &a, SC::Store::Normal const &b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    int
+    SlotOf(IndexLayout const &layout, MeshAttribute attribute)
+    {
+        for (uint32_t slot = 0; slot < layout.stride; ++slot)
+        {
+            if (layout.slots[slot] == attribute)
+                return (int)slot;
+        }
+        return -1;
+    }
+
+    size_t
+    IndexCount(std::vector<SC::Store::MeshElement> const &elements)
+    {
+        size_t count = 0;
+        for (SC::Store::MeshElement const &element : elements)
+            count += element.indices.size();
+        return count;
+    }
+
+    // Finds the value every corner references in the given slot. False when there are several.
+    template <typename Value>
+    bool
+    SingleValue(std::vector<SC::Store::MeshElement> const &elements, IndexLayout const &layout, int slot,
+                std::vector<Value> const &values, uint32_t &index)
+    {
+        bool found = false;
+        for (SC::Store::MeshElement const &element : elements)
+        {
+            for (size_t i = slot; i < element.indices.size(); i += layout.stride)
+            {
+                if (!found)
+                    index = element.indices[i], found = true;
+                else if (values[element.indices[i]] != values[index])
+                    return false;
+            }
+        }
+        return found;
+    }
+
+    bool
+    AnyNormal(std::vector<SC::Store::MeshElement> const &elements, IndexLayout const &layout, int slot,
+              std::vector<SC::Store::Normal> const &normals)
+    {
+        SC::Store::Normal const zero(0.0f, 0.0f, 0.0f);
+        for (SC::Store::MeshElement const &element : elements)
+        {
+            for (size_t i = slot; i < element.indices.size(); i += layout.stride)
+            {
+                if (normals[element.indices[i]] != zero)
+                    return true;
+            }
+        }
+        return false;
+    }
+
+    // Removes the attribute from the indices of an element type and clears its flag.
+    void
+    DropAttribute(SC::Store::Mesh &mesh, ElementType const &type, MeshAttribute attribute, SC::Store::Mesh::Bits bit)
+    {
+        IndexLayout const layout = type.layout(mesh.flags);
+        int const slot = SlotOf(layout, attribute);
+        for (SC::Store::MeshElement &element : *type.elements)
+        {
+            std::vector<uint32_t> &indices = element.indices;
+            size_t kept = 0;
+            for (size_t i = 0; i < indices.size(); ++i)
+            {
+                if ((int)(i % layout.stride) != slot)
+                    indices[kept++] = indices[i];
+            }
+            indices.resize(kept);
+        }
+        mesh.flags = (SC::Store::Mesh::Bits)(mesh.flags & ~bit);
+    }
+
+    // Points the three corners of every flat triangle at one shared face normal.
+    void
+    SnapFlatNormals(AuthoredMesh &authored, EncodingStats &stats)
+    {
+        IndexLayout const layout = FaceIndexLayout(authored.mesh.flags);
+        int const slot = SlotOf(layout, NormalAttribute);
+        if (slot < 0)
+            return;
+
+        std::vector<SC::Store::Normal> &normals = authored.normals;
+        for (SC::Store::MeshElement &element : authored.mesh.face_elements)
+        {
+            std::vector<uint32_t> &indices = element.indices;
+            uint32_t const triangle_size = 3 * layout.stride;
+            for (size_t offset = 0; offset + triangle_size <= indices.size(); offset += triangle_size)
+            {
+                uint32_t *corner_normals[3] = {&indices[offset + slot], &indices[offset + layout.stride + slot],
+                                               &indices[offset + 2 * layout.stride + slot]};
+                SC::Store::Normal const a = normals[*corner_normals[0]];
+                SC::Store::Normal const b = normals[*corner_normals[1]];
+                SC::Store::Normal const c = normals[*corner_normals[2]];
+                if (Dot(a, b) < FlatNormalCosine || Dot(a, c) < FlatNormalCosine || Dot(b, c) < FlatNormalCosine)
+                {
+                    ++stats.smooth_triangles;
+                    continue;
+                }
+                ++stats.flat_triangles;
+                if (*corner_normals[0] == *corner_normals[1] && *corner_normals[0] == *corner_normals[2])
+                    continue;
+                normals.push_back(Normalized(SC::Store::Normal(a.x + b.x + c.x, a.y + b.y + c.y, a.z + b.z + c.z)));
+                for (uint32_t *corner_normal : corner_normals)
+                    *corner_normal = (uint32_t)normals.size() - 1;
+            }
+        }
+    }
+}
+
+EncodingStats
+EncodeAuthoredMesh(AuthoredMesh &authored)
+{
+    EncodingStats stats;
+    SC::Store::Mesh &mesh = authored.mesh;
+    stats.flags_before = mesh.flags;
+    stats.bytes_before = AuthoredMeshBytes(authored);
+
+    for (SC::Store::Normal &normal : authored.normals)
+        normal = Normalized(normal);
+
+    ElementType const types[] = {
+        {&mesh.face_elements, FaceIndexLayout, SC::Store::Mesh::FaceNormals, SC::Store::Mesh::FaceUVs,
+         SC::Store::Mesh::FaceRGBA32s, &authored.face_color},
+        {&mesh.polyline_elements, LineIndexLayout, SC::Store::Mesh::LineNormals, SC::Store::Mesh::LineUVs,
+         SC::Store::Mesh::LineRGBA32s, &authored.line_color},
+        {&mesh.point_elements, PointIndexLayout, SC::Store::Mesh::PointNormals, SC::Store::Mesh::PointUVs,
+         SC::Store::Mesh::PointRGBA32s, &authored.point_color},
+    };
+    for (ElementType const &type : types)
+    {
+        if (IndexCount(*type.elements) == 0)
+        {
+            mesh.flags = (SC::Store::Mesh::Bits)(mesh.flags & ~(type.normal_bit | type.uv_bit | type.rgba32_bit));
+            continue;
+        }
+
+        uint32_t index = 0;
+        IndexLayout layout = type.layout(mesh.flags);
+        int slot = SlotOf(layout, NormalAttribute);
+        if (slot >= 0 && !AnyNormal(*type.elements, layout, slot, authored.normals))
+            DropAttribute(mesh, type, NormalAttribute, type.normal_bit);
+
+        layout = type.layout(mesh.flags);
+        slot = SlotOf(layout, UVAttribute);
+        if (slot >= 0 && SingleValue(*type.elements, layout, slot, authored.uvs, index))
+            DropAttribute(mesh, type, UVAttribute, type.uv_bit);
+
+        layout = type.layout(mesh.flags);
+        slot = SlotOf(layout, RGBA32Attribute);
+        if (slot >= 0 && SingleValue(*type.elements, layout, slot, authored.rgba32s, index))
+        {
+            type.color->set = true;
+            type.color->rgba = authored.rgba32s[index];
+            DropAttribute(mesh, type, RGBA32Attribute, type.rgba32_bit);
+        }
+    }
+
+    SnapFlatNormals(authored, stats);
+    CompactAuthoredMesh(authored);
+    authored.Bind();
+
+    stats.flags_after = mesh.flags;
+    return stats;
+}
@@ -0,0 +1,225 @@
+#include "sc_update_instancing.h"
+#include "sc_update_weld.h"
+
+#include <algorithm>
+#include <string.h>
+#include <vector>
+
+namespace
+{
+    uint32_t
+    PackRGBA32(SC::Store::RGBA32 const &rgba32)
+    {
+        return (uint32_t)rgba32.r | (uint32_t)rgba32.g << 8 | (uint32_t)rgba32.b << 16 | (uint32_t)rgba32.a << 24;
+    }
+
+    // Two independent 64-bit streams, mixed at the end, give the 128-bit content hash.
+    class ContentHasher
+    {
+    public:
+        void
+        Add(uint32_t word)
+        {
+            _a = (_a ^ word) * 0x100000001b3ull;
+            _b = (_b + word) * 0x9e3779b97f4a7c15ull;
+            _b ^= _b >> 29;
+        }
+
+        void
+        Add(int32_t word)
+        {
+            Add((uint32_t)word);
+        }
+
+        void
+        Add(float value)
+        {
+            value = value == 0.0f ? 0.0f : value; // -0 and +0 hash equal
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            Add(bits);
+        }
+
+        template <typename Element>
+        void
+        AddElements(std::vector<Element> const &elements)
+        {
+            Add((uint32_t)elements.size());
+            for (Element const &element : elements)
+            {
+                Add((uint32_t)element.indices.size());
+                for (uint32_t index : element.indices)
+                    Add(index);
+            }
+        }
+
+        MeshContentHash
+        Finish() const
+        {
+            MeshContentHash hash;
+            hash.high = Mix(_a);
+            hash.low = Mix(_b ^ _a);
+            return hash;
+        }
+
+    private:
+        static uint64_t
+        Mix(uint64_t h)
+        {
+            h ^= h >> 33;
+            h *= 0xff51afd7ed558ccdull;
+            h ^= h >> 33;
+            h *= 0xc4ceb9fe1a85ec53ull;
+            h ^= h >> 33;
+            return h;
+        }
+
+        uint64_t _a = 0xcbf29ce484222325ull;
+        uint64_t _b = 0x84222325cbf29ce4ull;
+    };
+
+    // Records the words the hasher would see, to compare two meshes whose hashes are equal.
+    class ContentWords
+    {
+    public:
+        void Add(uint32_t word) { words.push_back(word); }
+        void Add(int32_t word) { Add((uint32_t)word); }
+        void
+        Add(float value)
+        {
+            value = value == 0.0f ? 0.0f : value;
+            uint32_t bits;
+            memcpy(&bits, &value, sizeof(bits));
+            Add(bits);
+        }
+
+        template <typename Element>
+        void
+        AddElements(std::vector<Element> const &elements)
+        {
+            Add((uint32_t)elements.size());
+            for (Element const &element : elements)
+            {
+                Add((uint32_t)element.indices.size());
+                words.insert(words.end(), element.indices.begin(), element.indices.end());
+            }
+        }
+
+        std::vector<uint32_t> words;
+    };
+
+    // Feeds the content of a canonical mesh (bounding box at the origin) to sink.
+    template <typename Sink>
+    void
+    AddCanonicalContent(AuthoredMesh const &authored, Sink &sink)
+    {
+        sink.Add((uint32_t)authored.mesh.flags);
+        sink.Add((uint32_t)authored.points.size());
+        sink.Add((uint32_t)authored.normals.size());
+        sink.Add((uint32_t)authored.uvs.size());
+        sink.Add((uint32_t)authored.rgba32s.size());
+
+        if (!authored.points.empty())
+        {
+            // The quantization grid is relative to the extent, so the extent itself is part of the key.
+            float extent = 0.0f;
+            for (SC::Store::Point const &point : authored.points)
+                extent = std::max(extent, std::max(point.x, std::max(point.y, point.z)));
+            float const scale = WeldPositionScale(extent);
+            sink.Add(extent);
+            for (SC::Store::Point const &point : authored.points)
+            {
+                sink.Add(QuantizeWeldValue(point.x, scale));
+                sink.Add(QuantizeWeldValue(point.y, scale));
+                sink.Add(QuantizeWeldValue(point.z, scale));
+            }
+        }
+
+        for (SC::Store::Normal const &normal : authored.normals)
+        {
+            sink.Add(QuantizeWeldValue(normal.x, WeldNormalScale));
+            sink.Add(QuantizeWeldValue(normal.y, WeldNormalScale));
+            sink.Add(QuantizeWeldValue(normal.z, WeldNormalScale));
+        }
+        for (SC::Store::UV const &uv : authored.uvs)
+        {
+            sink.Add(QuantizeWeldValue(uv.u, WeldUVScale));
+            sink.Add(QuantizeWeldValue(uv.v, WeldUVScale));
+        }
+        for (SC::Store::RGBA32 const &rgba32 : authored.rgba32s)
+            sink.Add(PackRGBA32(rgba32));
+        for (UniformColor const *color : {&authored.face_color, &authored.line_color, &authored.point_color})
+            sink.Add(color->set ? PackRGBA32(color->rgba) : 0u);
+
+        sink.AddElements(authored.mesh.face_elements);
+        sink.AddElements(authored.mesh.polyline_elements);
+        sink.AddElements(authored.mesh.point_elements);
+        // Selection bits only when present.
+        for (std::vector<uint8_t> const *bits : {&authored.mesh.face_elements_bits, &authored.mesh.polyline_elements_bits,
+                                                 &authored.mesh.point_elements_bits})
+        {
+            if (bits->empty())
+                continue;
+            sink.Add((uint32_t)bits->size());
+            for (uint8_t value : *bits)
+                sink.Add((uint32_t)value);
+        }
+    }
+
+    bool
+    SameCanonicalContent(AuthoredMesh const &a, AuthoredMesh const &b)
+    {
+        ContentWords first, second;
+        AddCanonicalContent(a, first);
+        AddCanonicalContent(b, second);
+        return first.words == second.words;
+    }
+}
+
+MeshContentHash
+CanonicalizeAuthoredMesh(AuthoredMesh &authored, SC::Store::Point &origin)
+{
+    origin = SC::Store::Point(0.0f, 0.0f, 0.0f);
+    if (!authored.points.empty())
+    {
+        origin = authored.points[0];
+        for (SC::Store::Point const &point : authored.points)
+        {
+            origin.x = std::min(origin.x, point.x);
+            origin.y = std::min(origin.y, point.y);
+            origin.z = std::min(origin.z, point.z);
+        }
+        for (SC::Store::Point &point : authored.points)
+            point = SC::Store::Point(point.x - origin.x, point.y - origin.y, point.z - origin.z);
+    }
+
+    ContentHasher hasher;
+    AddCanonicalContent(authored, hasher);
+    authored.Bind();
+    return hasher.Finish();
+}
+
+bool
+MeshInstanceIndex::Find(MeshContentHash const &hash, AuthoredMesh const &mesh, SC::Store::MeshKey &mesh_key) const
+{
+    auto candidates = _meshes.equal_range(hash);
+    for (auto candidate = candidates.first; candidate != candidates.second; ++candidate)
+    {
+        // The hash only picks candidates; the content decides.
+        if (SameCanonicalContent(*candidate->second.mesh, mesh))
+        {
+            mesh_key = candidate->second.mesh_key;
+            return true;
+        }
+    }
+    return false;
+}
+
+void
+MeshInstanceIndex::Add(MeshContentHash const &hash, AuthoredMesh const &mesh, SC::Store::MeshKey mesh_key)
+{
+    Entry entry;
+    entry.mesh = &mesh;
+    entry.mesh_key = mesh_key;
+    _meshes.emplace(hash, entry);
+}
@@ -0,0 +1,98 @@
+#include "sc_update_intern.h"
+
+#include <string.h>
+
+StringPool::StringPool(size_t block_bytes) : _block_bytes(block_bytes > 0 ? block_bytes : 1)
+{
+}
+
+uint32_t
+StringPool::Hash(char const *text, size_t length)
+{
+    // FNV-1a.
+    uint32_t hash = 2166136261u;
+    for (size_t i = 0; i < length; ++i)
+        hash = (hash ^ (uint8_t)text[i]) * 16777619u;
+    return hash;
+}
+
+StringPool::Slot const *
+StringPool::Lookup(char const *text, size_t length, uint32_t hash) const
+{
+    size_t const mask = _slots.size() - 1;
+    for (size_t i = hash & mask;; i = (i + 1) & mask)
+    {
+        Slot const &slot = _slots[i];
+        if (slot.text == nullptr)
+            return &slot;
+        if (slot.hash == hash && slot.length == length && memcmp(slot.text, text, length) == 0)
+            return &slot;
+    }
+}
+
+void
+StringPool::Grow()
+{
+    std::vector<Slot> slots(_slots.empty() ? 64 : _slots.size() * 2, Slot{nullptr, 0, 0});
+    size_t const mask = slots.size() - 1;
+    for (Slot const &slot : _slots)
+    {
+        if (slot.text == nullptr)
+            continue;
+        size_t i = slot.hash & mask;
+        while (slots[i].text != nullptr)
+            i = (i + 1) & mask;
+        slots[i] = slot;
+    }
+    _slots.swap(slots);
+}
+
+char *
+StringPool::Allocate(size_t bytes)
+{
+    // Strings larger than a quarter block get a block of their own, so the tail of the current
+    // block is not wasted on them.
+    if (bytes > _block_bytes / 4)
+    {
+        _blocks.emplace_back(new char[bytes]);
+        return _blocks.back().get();
+    }
+    if (bytes > _remaining)
+    {
+        _blocks.emplace_back(new char[_block_bytes]);
+        _cursor = _blocks.back().get();
+        _remaining = _block_bytes;
+    }
+    char *out = _cursor;
+    _cursor += bytes;
+    _remaining -= bytes;
+    return out;
+}
+
+char const *
+StringPool::Intern(char const *text, size_t length)
+{
+    // Keep the load factor at or below one half.
+    if ((_count + 1) * 2 > _slots.size())
+        Grow();
+    uint32_t const hash = Hash(text, length);
+    Slot *slot = const_cast<Slot *>(Lookup(text, length, hash));
+    if (slot->text != nullptr)
+        return slot->text;
+
+    char *copy = Allocate(length + 1);
+    memcpy(copy, text, length);
+    copy[length] = '\0';
+    _bytes += length + 1;
+    *slot = Slot{copy, (uint32_t)length, hash};
+    ++_count;
+    return copy;
+}
+
+char const *
+StringPool::Find(char const *text, size_t length) const
+{
+    if (_slots.empty())
+        return nullptr;
+    return Lookup(text, length, Hash(text, length))->text;
+}
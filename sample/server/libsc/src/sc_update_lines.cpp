@@ -0,0 +1,280 @@
+#include "sc_update_lines.h"
+#include "sc_update_weld.h"
+
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+    struct Vector3
+    {
+        double x, y, z;
+    };
+
+    Vector3
+    Cross(Vector3 const &a, Vector3 const &b)
+    {
+        Vector3 c = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+        return c;
+    }
+
+    double
+    Dot(Vector3 const &a, Vector3 const &b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    bool
+    Normalize(Vector3 &v)
+    {
+        double const length = std::sqrt(Dot(v, v));
+        if (length < 1e-12)
+            return false;
+        v.x /= length, v.y /= length, v.z /= length;
+        return true;
+    }
+
+    bool
+    ReadCap(JsonValue const &value, SC::Store::Utils::LineCap &cap)
+    {
+        if (value.getTag() != JSON_STRING)
+            return false;
+        if (strcasecmp(value.toString(), "round") == 0)
+            cap = SC::Store::Utils::LineCap::Round;
+        else if (strcasecmp(value.toString(), "none") == 0)
+            cap = SC::Store::Utils::LineCap::None;
+        else
+            return false;
+        return true;
+    }
+
+    // Orthonormal frame of the plane a polyline lies in: Newell's normal of the polyline closed
+    // into a loop, or for (nearly) straight polylines any plane containing the line.
+    bool
+    PolylineFrame(std::vector<Vector3> const &path, Vector3 &u, Vector3 &v, Vector3 &n)
+    {
+        n.x = n.y = n.z = 0.0;
+        for (size_t i = 0; i < path.size(); ++i)
+        {
+            Vector3 const &a = path[i];
+            Vector3 const &b = path[(i + 1) % path.size()];
+            n.x += (a.y - b.y) * (a.z + b.z);
+            n.y += (a.z - b.z) * (a.x + b.x);
+            n.z += (a.x - b.x) * (a.y + b.y);
+        }
+
+        // The longest chord from the first point is the in-plane reference direction.
+        u.x = u.y = u.z = 0.0;
+        double longest = 0.0;
+        for (Vector3 const &p : path)
+        {
+            Vector3 const d = {p.x - path[0].x, p.y - path[0].y, p.z - path[0].z};
+            if (Dot(d, d) > longest)
+                longest = Dot(d, d), u = d;
+        }
+        if (!Normalize(u))
+            return false;
+
+        double const extent = std::sqrt(longest);
+        if (std::sqrt(Dot(n, n)) < 1e-6 * extent * extent)
+        {
+            // Straight line: lie it in the plane spanned by u and the world axis least aligned with it.
+            Vector3 axis = {0.0, 0.0, 0.0};
+            if (std::fabs(u.x) <= std::fabs(u.y) && std::fabs(u.x) <= std::fabs(u.z))
+                axis.x = 1.0;
+            else if (std::fabs(u.y) <= std::fabs(u.z))
+                axis.y = 1.0;
+            else
+                axis.z = 1.0;
+            n = Cross(u, axis);
+        }
+        if (!Normalize(n))
+            return false;
+        // Make u exactly perpendicular to n.
+        double const along = Dot(u, n);
+        u.x -= along * n.x, u.y -= along * n.y, u.z -= along * n.z;
+        if (!Normalize(u))
+            return false;
+        v = Cross(n, u);
+        return true;
+    }
+}
+
+LineStrokeOptions
+LineStrokeOptionsFromEnvironment()
+{
+    LineStrokeOptions options;
+    if (const char *thickness = getenv("SC_UPDATE_LINE_THICKNESS"))
+        options.thickness = (float)atof(thickness);
+    if (const char *caps = getenv("SC_UPDATE_LINE_CAPS"))
+    {
+        SC::Store::Utils::LineCap const cap =
+            strcasecmp(caps, "none") == 0 ? SC::Store::Utils::LineCap::None : SC::Store::Utils::LineCap::Round;
+        options.begin_cap = options.end_cap = cap;
+    }
+    return options;
+}
+
+bool
+ReadLineStroke(JsonValue const &mesh_template, LineStrokeOptions const &defaults, LineStrokeOptions &options,
+               std::string &error)
+{
+    options = defaults;
+    if (mesh_template.getTag() != JSON_OBJECT)
+        return true;
+    for (auto item : mesh_template)
+    {
+        if (strcmp(item->key, "lineStroke") != 0 || item->value.getTag() == JSON_NULL)
+            continue;
+        if (item->value.getTag() != JSON_OBJECT)
+        {
+            error = "lineStroke must be an object";
+            return false;
+        }
+        for (auto field : item->value)
+        {
+            bool valid = true;
+            if (strcmp(field->key, "thickness") == 0)
+            {
+                valid = field->value.getTag() == JSON_NUMBER && field->value.toNumber() >= 0.0;
+                if (valid)
+                    options.thickness = (float)field->value.toNumber();
+            }
+            else if (strcmp(field->key, "cap") == 0)
+            {
+                valid = ReadCap(field->value, options.begin_cap);
+                options.end_cap = options.begin_cap;
+            }
+            else if (strcmp(field->key, "beginCap") == 0)
+                valid = ReadCap(field->value, options.begin_cap);
+            else if (strcmp(field->key, "endCap") == 0)
+                valid = ReadCap(field->value, options.end_cap);
+            if (!valid)
+            {
+                error = std::string("invalid lineStroke ") + field->key;
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
+void
+TessellateStroke(AuthoredMesh const &mesh, LineStrokeOptions const &options, TessellatedStroke &stroke)
+{
+    stroke.valid = false;
+    IndexLayout const layout = LineIndexLayout(mesh.mesh.flags);
+    std::vector<uint32_t> const &indices = mesh.mesh.polyline_elements[stroke.element].indices;
+    size_t const vertex_count = indices.size() / layout.stride;
+    if (vertex_count < 2)
+        return;
+
+    for (uint32_t slot = 0; slot < layout.stride; ++slot)
+    {
+        if (layout.slots[slot] == RGBA32Attribute)
+        {
+            stroke.has_color = true;
+            stroke.color = mesh.rgba32s[indices[slot]];
+        }
+    }
+
+    std::vector<Vector3> path(vertex_count);
+    Vector3 center = {0.0, 0.0, 0.0};
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        SC::Store::Point const &p = mesh.points[indices[i * layout.stride]];
+        path[i].x = p.x, path[i].y = p.y, path[i].z = p.z;
+        center.x += p.x, center.y += p.y, center.z += p.z;
+    }
+    center.x /= vertex_count, center.y /= vertex_count, center.z /= vertex_count;
+
+    Vector3 u, v, n;
+    if (!PolylineFrame(path, u, v, n))
+        return;
+
+    std::vector<SC::Store::Point> flat(vertex_count);
+    for (size_t i = 0; i < vertex_count; ++i)
+    {
+        Vector3 const d = {path[i].x - center.x, path[i].y - center.y, path[i].z - center.z};
+        flat[i] = SC::Store::Point((float)Dot(d, u), (float)Dot(d, v), 0.0f);
+    }
+
+    SC::Store::Utils::TessellationConfig config;
+    config.steps_per_circle = options.steps_per_circle;
+    SC::Store::Utils::LineStroke line_stroke;
+    line_stroke.cap.begin = options.begin_cap;
+    line_stroke.cap.end = options.end_cap;
+    line_stroke.thickness = options.thickness;
+    if (!SC::Store::Utils::CreateThickLine(config, line_stroke, flat, stroke.points, stroke.triangles) ||
+        stroke.triangles.size() < 3)
+        return;
+
+    for (SC::Store::Point &point : stroke.points)
+    {
+        double const x = point.x, y = point.y;
+        point = SC::Store::Point((float)(center.x + x * u.x + y * v.x), (float)(center.y + x * u.y + y * v.y),
+                                 (float)(center.z + x * u.z + y * v.z));
+    }
+    stroke.normal = SC::Store::Normal((float)n.x, (float)n.y, (float)n.z);
+    stroke.valid = true;
+}
+
+bool
+MergeStrokes(AuthoredMesh &mesh, std::vector<TessellatedStroke> &strokes, AuthoredMesh &strokes_mesh)
+{
+    strokes_mesh = AuthoredMesh();
+    strokes_mesh.node_id = mesh.node_id;
+    strokes_mesh.parent_node_id = mesh.parent_node_id;
+    uint32_t flags = SC::Store::Mesh::FaceNormals | SC::Store::Mesh::TwoSided;
+    if (mesh.mesh.flags & SC::Store::Mesh::LineRGBA32s)
+        flags |= SC::Store::Mesh::FaceRGBA32s;
+    strokes_mesh.mesh.flags = (SC::Store::Mesh::Bits)flags;
+
+    std::vector<bool> tessellated(mesh.mesh.polyline_elements.size(), false);
+    strokes_mesh.mesh.face_elements.emplace_back();
+    std::vector<uint32_t> &faces = strokes_mesh.mesh.face_elements.back().indices;
+    for (TessellatedStroke &stroke : strokes)
+    {
+        if (!stroke.valid)
+            continue;
+        tessellated[stroke.element] = true;
+
+        uint32_t const base = (uint32_t)strokes_mesh.points.size();
+        uint32_t const normal = (uint32_t)strokes_mesh.normals.size();
+        uint32_t const color = (uint32_t)strokes_mesh.rgba32s.size();
+        strokes_mesh.points.insert(strokes_mesh.points.end(), stroke.points.begin(), stroke.points.end());
+        strokes_mesh.normals.push_back(stroke.normal);
+        if (flags & SC::Store::Mesh::FaceRGBA32s)
+            strokes_mesh.rgba32s.push_back(stroke.color);
+        for (uint32_t index : stroke.triangles)
+        {
+            faces.push_back(base + index);
+            faces.push_back(normal);
+            if (flags & SC::Store::Mesh::FaceRGBA32s)
+                faces.push_back(color);
+        }
+        std::vector<SC::Store::Point>().swap(stroke.points);
+        std::vector<uint32_t>().swap(stroke.triangles);
+    }
+    if (faces.empty())
+        return false;
+
+    std::vector<SC::Store::MeshElement> kept;
+    for (size_t e = 0; e < mesh.mesh.polyline_elements.size(); ++e)
+    {
+        if (!tessellated[e])
+            kept.push_back(std::move(mesh.mesh.polyline_elements[e]));
+    }
+    mesh.mesh.polyline_elements.swap(kept);
+    if (mesh.mesh.polyline_elements.empty())
+    {
+        mesh.mesh.flags = (SC::Store::Mesh::Bits)(mesh.mesh.flags & ~(SC::Store::Mesh::LineNormals | SC::Store::Mesh::LineUVs |
+                                                                      SC::Store::Mesh::LineRGBA32s));
+    }
+    CompactAuthoredMesh(mesh);
+    mesh.Bind();
+    strokes_mesh.Bind();
+    return true;
+}
@@ -0,0 +1,404 @@
+#include "sc_update_lod.h"
+#include "sc_update_weld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <queue>
+#include <stdlib.h>
+
+namespace
+{
+    const unsigned MaxLodLevels = 3;
+
+    // Symmetric 4x4 error quadric, upper triangle: xx xy xz xw yy yz yw zz zw ww.
+    struct Quadric
+    {
+        double q[10] = {0, 0, 0, 0, 0, 0, 0, 0, 0, 0};
+
+        void
+        AddPlane(double a, double b, double c, double d, double weight)
+        {
+            q[0] += weight * a * a, q[1] += weight * a * b, q[2] += weight * a * c, q[3] += weight * a * d;
+            q[4] += weight * b * b, q[5] += weight * b * c, q[6] += weight * b * d;
+            q[7] += weight * c * c, q[8] += weight * c * d;
+            q[9] += weight * d * d;
+        }
+
+        void
+        Add(Quadric const &that)
+        {
+            for (int i = 0; i < 10; ++i)
+                q[i] += that.q[i];
+        }
+
+        double
+        Error(SC::Store::Point const &p) const
+        {
+            double const x = p.x, y = p.y, z = p.z;
+            return q[0] * x * x + 2 * q[1] * x * y + 2 * q[2] * x * z + 2 * q[3] * x + q[4] * y * y + 2 * q[5] * y * z +
+                   2 * q[6] * y + q[7] * z * z + 2 * q[8] * z + q[9];
+        }
+    };
+
+    struct Triangle
+    {
+        uint32_t points[3];
+        uint32_t element; // Face element the triangle came from.
+        uint32_t offset;  // Offset of its first corner in that element's indices.
+        bool live;
+    };
+
+    const uint32_t NoElement = 0xffffffffu;
+
+    // Location of an index group in a face element.
+    struct Corner
+    {
+        uint32_t element = NoElement;
+        uint32_t offset = 0;
+    };
+
+    struct Collapse
+    {
+        double cost;
+        uint32_t from, to;
+        uint32_t from_version, to_version;
+
+        bool operator>(Collapse const &that) const { return cost > that.cost; }
+    };
+
+    struct Normal3
+    {
+        double x, y, z;
+    };
+
+    Normal3
+    TriangleNormal(SC::Store::Point const &p0, SC::Store::Point const &p1, SC::Store::Point const &p2)
+    {
+        double const ux = p1.x - p0.x, uy = p1.y - p0.y, uz = p1.z - p0.z;
+        double const vx = p2.x - p0.x, vy = p2.y - p0.y, vz = p2.z - p0.z;
+        Normal3 n = {uy * vz - uz * vy, uz * vx - ux * vz, ux * vy - uy * vx};
+        return n;
+    }
+
+    class Decimator
+    {
+    public:
+        explicit Decimator(AuthoredMesh const &mesh)
+            : _mesh(mesh), _stride(FaceIndexStride(mesh.mesh.flags)), _live_count(0)
+        {
+            size_t const point_count = mesh.points.size();
+            _quadrics.resize(point_count);
+            _versions.assign(point_count, 0);
+            _locked.assign(point_count, false);
+            _dead.assign(point_count, false);
+            _vertex_triangles.resize(point_count);
+            _point_corners.assign(point_count, Corner());
+
+            std::vector<SC::Store::MeshElement> const &elements = mesh.mesh.face_elements;
+            for (uint32_t e = 0; e < (uint32_t)elements.size(); ++e)
+            {
+                std::vector<uint32_t> const &indices = elements[e].indices;
+                for (uint32_t offset = 0; offset + 3 * _stride <= indices.size(); offset += 3 * _stride)
+                {
+                    Triangle triangle;
+                    triangle.points[0] = indices[offset];
+                    triangle.points[1] = indices[offset + _stride];
+                    triangle.points[2] = indices[offset + 2 * _stride];
+                    triangle.element = e;
+                    triangle.offset = offset;
+                    triangle.live = triangle.points[0] != triangle.points[1] && triangle.points[1] != triangle.points[2] &&
+                                    triangle.points[0] != triangle.points[2];
+                    _triangles.push_back(triangle);
+                    for (uint32_t c = 0; c < 3; ++c)
+                    {
+                        Corner &corner = _point_corners[triangle.points[c]];
+                        if (corner.element == NoElement)
+                            corner.element = e, corner.offset = offset + c * _stride;
+                    }
+                }
+            }
+
+            std::vector<uint64_t> edges;
+            edges.reserve(_triangles.size() * 3);
+            for (uint32_t t = 0; t < (uint32_t)_triangles.size(); ++t)
+            {
+                Triangle const &triangle = _triangles[t];
+                if (!triangle.live)
+                    continue;
+                ++_live_count;
+
+                SC::Store::Point const &p0 = mesh.points[triangle.points[0]];
+                Normal3 n = TriangleNormal(p0, mesh.points[triangle.points[1]], mesh.points[triangle.points[2]]);
+                double const length = std::sqrt(n.x * n.x + n.y * n.y + n.z * n.z);
+                for (int c = 0; c < 3; ++c)
+                {
+                    _vertex_triangles[triangle.points[c]].push_back(t);
+                    uint32_t const a = triangle.points[c], b = triangle.points[(c + 1) % 3];
+                    edges.push_back((uint64_t)std::min(a, b) << 32 | std::max(a, b));
+                }
+                if (length == 0.0)
+                    continue;
+                double const a = n.x / length, b = n.y / length, c = n.z / length;
+                double const d = -(a * p0.x + b * p0.y + c * p0.z);
+                for (int corner = 0; corner < 3; ++corner)
+                    _quadrics[triangle.points[corner]].AddPlane(a, b, c, d, length * 0.5);
+            }
+
+            // Edges on a boundary or shared by more than two triangles pin their vertices.
+            std::sort(edges.begin(), edges.end());
+            for (size_t begin = 0, end = 0; begin < edges.size(); begin = end)
+            {
+                while (end < edges.size() && edges[end] == edges[begin])
+                    ++end;
+                uint32_t const a = (uint32_t)(edges[begin] >> 32), b = (uint32_t)edges[begin];
+                if (end - begin != 2)
+                    _locked[a] = _locked[b] = true;
+            }
+            for (size_t begin = 0, end = 0; begin < edges.size(); begin = end)
+            {
+                while (end < edges.size() && edges[end] == edges[begin])
+                    ++end;
+                PushEdge((uint32_t)(edges[begin] >> 32), (uint32_t)edges[begin]);
+            }
+        }
+
+        uint32_t
+        LiveTriangleCount() const
+        {
+            return _live_count;
+        }
+
+        // Collapses edges until at most target triangles are left or no collapse is possible.
+        void
+        CollapseTo(uint32_t target)
+        {
+            while (_live_count > target && !_heap.empty())
+            {
+                Collapse collapse = _heap.top();
+                _heap.pop();
+                if (_dead[collapse.from] || _dead[collapse.to] || _versions[collapse.from] != collapse.from_version ||
+                    _versions[collapse.to] != collapse.to_version)
+                    continue;
+                if (CanCollapse(collapse.from, collapse.to))
+                    Apply(collapse.from, collapse.to);
+            }
+        }
+
+        void
+        Emit(AuthoredMesh &lod) const
+        {
+            lod.node_id = _mesh.node_id;
+            lod.parent_node_id = _mesh.parent_node_id;
+            lod.points = _mesh.points;
+            lod.normals = _mesh.normals;
+            lod.uvs = _mesh.uvs;
+            lod.rgba32s = _mesh.rgba32s;
+            lod.face_color = _mesh.face_color;
+            lod.line_color = _mesh.line_color;
+            lod.point_color = _mesh.point_color;
+            // Locked boundaries keep holes closed, but decimation gives no guarantee about it.
+            lod.mesh.flags = (SC::Store::Mesh::Bits)(_mesh.mesh.flags & ~SC::Store::Mesh::Manifold);
+            lod.mesh.polyline_elements = _mesh.mesh.polyline_elements;
+            lod.mesh.point_elements = _mesh.mesh.point_elements;
+
+            std::vector<SC::Store::MeshElement> const &source_elements = _mesh.mesh.face_elements;
+            std::vector<SC::Store::MeshElement> face_elements(source_elements.size());
+            for (Triangle const &triangle : _triangles)
+            {
+                if (!triangle.live)
+                    continue;
+                std::vector<uint32_t> const &source = source_elements[triangle.element].indices;
+                std::vector<uint32_t> &indices = face_elements[triangle.element].indices;
+                for (uint32_t c = 0; c < 3; ++c)
+                {
+                    // Corners that moved take the attributes of a corner at their new point.
+                    uint32_t const point = triangle.points[c];
+                    std::vector<uint32_t> const *corner_indices = &source;
+                    size_t corner = triangle.offset + c * _stride;
+                    if (source[corner] != point)
+                    {
+                        corner_indices = &source_elements[_point_corners[point].element].indices;
+                        corner = _point_corners[point].offset;
+                    }
+                    indices.push_back(point);
+                    indices.insert(indices.end(), corner_indices->begin() + corner + 1, corner_indices->begin() + corner + _stride);
+                }
+            }
+            for (SC::Store::MeshElement &element : face_elements)
+            {
+                if (!element.indices.empty())
+                {
+                    lod.mesh.face_elements.emplace_back();
+                    lod.mesh.face_elements.back().indices.swap(element.indices);
+                }
+            }
+            CompactAuthoredMesh(lod);
+        }
+
+    private:
+        void
+        PushEdge(uint32_t a, uint32_t b)
+        {
+            if (_locked[a] && _locked[b])
+                return;
+            Quadric combined = _quadrics[a];
+            combined.Add(_quadrics[b]);
+            double const cost_a_to_b = _locked[a] ? HUGE_VAL : combined.Error(_mesh.points[b]);
+            double const cost_b_to_a = _locked[b] ? HUGE_VAL : combined.Error(_mesh.points[a]);
+            Collapse collapse;
+            if (cost_a_to_b <= cost_b_to_a)
+                collapse.cost = cost_a_to_b, collapse.from = a, collapse.to = b;
+            else
+                collapse.cost = cost_b_to_a, collapse.from = b, collapse.to = a;
+            collapse.from_version = _versions[collapse.from];
+            collapse.to_version = _versions[collapse.to];
+            _heap.push(collapse);
+        }
+
+        void
+        CollectNeighbours(uint32_t vertex, std::vector<uint32_t> &neighbours) const
+        {
+            neighbours.clear();
+            for (uint32_t t : _vertex_triangles[vertex])
+            {
+                Triangle const &triangle = _triangles[t];
+                if (!triangle.live)
+                    continue;
+                for (uint32_t point : triangle.points)
+                {
+                    if (point != vertex)
+                        neighbours.push_back(point);
+                }
+            }
+            std::sort(neighbours.begin(), neighbours.end());
+            neighbours.erase(std::unique(neighbours.begin(), neighbours.end()), neighbours.end());
+        }
+
+        bool
+        CanCollapse(uint32_t from, uint32_t to)
+        {
+            // Link condition: an interior edge shares exactly two neighbours, more would pinch the surface.
+            CollectNeighbours(from, _from_neighbours);
+            CollectNeighbours(to, _to_neighbours);
+            size_t shared = 0;
+            for (size_t i = 0, j = 0; i < _from_neighbours.size() && j < _to_neighbours.size();)
+            {
+                if (_from_neighbours[i] < _to_neighbours[j])
+                    ++i;
+                else if (_from_neighbours[i] > _to_neighbours[j])
+                    ++j;
+                else
+                    ++shared, ++i, ++j;
+            }
+            if (shared != 2)
+                return false;
+
+            for (uint32_t t : _vertex_triangles[from])
+            {
+                Triangle const &triangle = _triangles[t];
+                if (!triangle.live || triangle.points[0] == to || triangle.points[1] == to || triangle.points[2] == to)
+                    continue;
+                SC::Store::Point const *before[3], *after[3];
+                for (int c = 0; c < 3; ++c)
+                {
+                    before[c] = &_mesh.points[triangle.points[c]];
+                    after[c] = triangle.points[c] == from ? &_mesh.points[to] : before[c];
+                }
+                Normal3 const old_normal = TriangleNormal(*before[0], *before[1], *before[2]);
+                Normal3 const new_normal = TriangleNormal(*after[0], *after[1], *after[2]);
+                if (old_normal.x * new_normal.x + old_normal.y * new_normal.y + old_normal.z * new_normal.z <= 0.0)
+                    return false;
+            }
+            return true;
+        }
+
+        void
+        Apply(uint32_t from, uint32_t to)
+        {
+            std::vector<uint32_t> &to_triangles = _vertex_triangles[to];
+            for (uint32_t t : _vertex_triangles[from])
+            {
+                Triangle &triangle = _triangles[t];
+                if (!triangle.live)
+                    continue;
+                if (triangle.points[0] == to || triangle.points[1] == to || triangle.points[2] == to)
+                {
+                    triangle.live = false;
+                    --_live_count;
+                    continue;
+                }
+                for (uint32_t &point : triangle.points)
+                {
+                    if (point == from)
+                        point = to;
+                }
+                to_triangles.push_back(t);
+            }
+            std::vector<uint32_t>().swap(_vertex_triangles[from]);
+            to_triangles.erase(std::remove_if(to_triangles.begin(), to_triangles.end(),
+                                              [this](uint32_t t) { return !_triangles[t].live; }),
+                               to_triangles.end());
+
+            _quadrics[to].Add(_quadrics[from]);
+            _dead[from] = true;
+            ++_versions[to];
+
+            CollectNeighbours(to, _to_neighbours);
+            for (uint32_t neighbour : _to_neighbours)
+                PushEdge(to, neighbour);
+        }
+
+        AuthoredMesh const &_mesh;
+        uint32_t const _stride;
+        uint32_t _live_count;
+        std::vector<Triangle> _triangles;
+        std::vector<Quadric> _quadrics;
+        std::vector<uint32_t> _versions;
+        std::vector<bool> _locked;
+        std::vector<bool> _dead;
+        std::vector<std::vector<uint32_t>> _vertex_triangles;
+        std::vector<Corner> _point_corners; // First corner at each point.
+        std::priority_queue<Collapse, std::vector<Collapse>, std::greater<Collapse>> _heap;
+        std::vector<uint32_t> _from_neighbours, _to_neighbours;
+    };
+}
+
+LodOptions
+LodOptionsFromEnvironment()
+{
+    LodOptions options;
+    const char *levels = getenv("SC_UPDATE_LOD_LEVELS");
+    if (levels && atoi(levels) > 0)
+        options.levels = std::min((unsigned)atoi(levels), MaxLodLevels);
+    return options;
+}
+
+void
+BuildMeshLods(AuthoredMesh const &mesh, LodOptions const &options, std::vector<AuthoredMesh> &lods)
+{
+    lods.clear();
+    if (options.levels == 0)
+        return;
+
+    size_t triangle_count = 0;
+    uint32_t const stride = FaceIndexStride(mesh.mesh.flags);
+    for (SC::Store::MeshElement const &element : mesh.mesh.face_elements)
+        triangle_count += element.indices.size() / (3 * stride);
+    if (triangle_count < options.min_triangles)
+        return;
+
+    Decimator decimator(mesh);
+    uint32_t previous = decimator.LiveTriangleCount();
+    lods.reserve(options.levels);
+    for (unsigned level = 0; level < options.levels; ++level)
+    {
+        decimator.CollapseTo((uint32_t)(previous * options.ratio));
+        // A level that barely shrank costs bytes without saving any rendering.
+        if (decimator.LiveTriangleCount() == 0 || decimator.LiveTriangleCount() > previous * 0.8)
+            break;
+        previous = decimator.LiveTriangleCount();
+        lods.emplace_back();
+        decimator.Emit(lods.back());
+    }
+}
@@ -0,0 +1,351 @@
+#include "sc_update_measure.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+
+namespace
+{
+    struct Vector3
+    {
+        double x, y, z;
+    };
+
+    Vector3
+    ToVector3(SC::Store::Point const &p)
+    {
+        Vector3 v = {p.x, p.y, p.z};
+        return v;
+    }
+
+    Vector3
+    Sub(Vector3 const &a, Vector3 const &b)
+    {
+        Vector3 c = {a.x - b.x, a.y - b.y, a.z - b.z};
+        return c;
+    }
+
+    Vector3
+    Cross(Vector3 const &a, Vector3 const &b)
+    {
+        Vector3 c = {a.y * b.z - a.z * b.y, a.z * b.x - a.x * b.z, a.x * b.y - a.y * b.x};
+        return c;
+    }
+
+    double
+    Dot(Vector3 const &a, Vector3 const &b)
+    {
+        return a.x * b.x + a.y * b.y + a.z * b.z;
+    }
+
+    bool
+    Normalize(Vector3 &v)
+    {
+        double const length = std::sqrt(Dot(v, v));
+        if (length < 1e-12)
+            return false;
+        v.x /= length, v.y /= length, v.z /= length;
+        return true;
+    }
+
+    // Eigenvalues (ascending) and eigenvectors of a symmetric 3x3 matrix by cyclic Jacobi rotations.
+    void
+    SymmetricEigen(double a[3][3], double values[3], Vector3 vectors[3])
+    {
+        double v[3][3] = {{1.0, 0.0, 0.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0}};
+        for (int sweep = 0; sweep < 32; ++sweep)
+        {
+            if (a[0][1] * a[0][1] + a[0][2] * a[0][2] + a[1][2] * a[1][2] < 1e-30)
+                break;
+            for (int p = 0; p < 2; ++p)
+            {
+                for (int q = p + 1; q < 3; ++q)
+                {
+                    if (a[p][q] == 0.0)
+                        continue;
+                    double const theta = (a[q][q] - a[p][p]) / (2.0 * a[p][q]);
+                    double const t = (theta >= 0.0 ? 1.0 : -1.0) / (std::fabs(theta) + std::sqrt(theta * theta + 1.0));
+                    double const c = 1.0 / std::sqrt(t * t + 1.0), s = t * c;
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        double const kp = a[k][p], kq = a[k][q];
+                        a[k][p] = c * kp - s * kq, a[k][q] = s * kp + c * kq;
+                    }
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        double const pk = a[p][k], qk = a[q][k];
+                        a[p][k] = c * pk - s * qk, a[q][k] = s * pk + c * qk;
+                    }
+                    for (int k = 0; k < 3; ++k)
+                    {
+                        double const kp = v[k][p], kq = v[k][q];
+                        v[k][p] = c * kp - s * kq, v[k][q] = s * kp + c * kq;
+                    }
+                }
+            }
+        }
+        int order[3] = {0, 1, 2};
+        std::sort(order, order + 3, [&](int i, int j) { return a[i][i] < a[j][j]; });
+        for (int i = 0; i < 3; ++i)
+        {
+            values[i] = a[order[i]][order[i]];
+            vectors[i].x = v[0][order[i]], vectors[i].y = v[1][order[i]], vectors[i].z = v[2][order[i]];
+        }
+    }
+
+    struct Triangle
+    {
+        Vector3 normal; // Unit normal.
+        double area;
+    };
+
+    // The triangles and corners of one face element.
+    struct FaceSamples
+    {
+        std::vector<Triangle> triangles;
+        std::vector<Vector3> corners;
+        Vector3 area_normal;   // Sum of the (twice) area weighted normals.
+        Vector3 centroid;      // Area weighted.
+        double area;
+        double extent;
+    };
+
+    void
+    SampleFace(AuthoredMesh const &mesh, SC::Store::MeshElement const &element, uint32_t stride, FaceSamples &samples)
+    {
+        samples.triangles.clear();
+        samples.corners.clear();
+        samples.area_normal.x = samples.area_normal.y = samples.area_normal.z = 0.0;
+        samples.centroid = samples.area_normal;
+        samples.area = 0.0;
+
+        Vector3 low = {0.0, 0.0, 0.0}, high = low;
+        size_t const triangle_count = element.indices.size() / (3 * stride);
+        for (size_t t = 0; t < triangle_count; ++t)
+        {
+            uint32_t const *corner = &element.indices[t * 3 * stride];
+            Vector3 const a = ToVector3(mesh.points[corner[0]]);
+            Vector3 const b = ToVector3(mesh.points[corner[stride]]);
+            Vector3 const c = ToVector3(mesh.points[corner[2 * stride]]);
+            for (Vector3 const &p : {a, b, c})
+            {
+                if (samples.corners.empty())
+                    low = high = p;
+                low.x = std::min(low.x, p.x), high.x = std::max(high.x, p.x);
+                low.y = std::min(low.y, p.y), high.y = std::max(high.y, p.y);
+                low.z = std::min(low.z, p.z), high.z = std::max(high.z, p.z);
+                samples.corners.push_back(p);
+            }
+
+            Vector3 normal = Cross(Sub(b, a), Sub(c, a));
+            double const area = std::sqrt(Dot(normal, normal));
+            if (!Normalize(normal))
+                continue;
+            Triangle triangle = {normal, area};
+            samples.triangles.push_back(triangle);
+            samples.area_normal.x += normal.x * area, samples.area_normal.y += normal.y * area, samples.area_normal.z += normal.z * area;
+            samples.centroid.x += (a.x + b.x + c.x) / 3.0 * area;
+            samples.centroid.y += (a.y + b.y + c.y) / 3.0 * area;
+            samples.centroid.z += (a.z + b.z + c.z) / 3.0 * area;
+            samples.area += area;
+        }
+        if (samples.area > 0.0)
+            samples.centroid.x /= samples.area, samples.centroid.y /= samples.area, samples.centroid.z /= samples.area;
+        Vector3 const diagonal = Sub(high, low);
+        samples.extent = std::sqrt(Dot(diagonal, diagonal));
+    }
+
+    bool
+    FitPlane(FaceSamples const &samples, double cos_tolerance, double sin_tolerance, FaceMeasurement &measurement)
+    {
+        Vector3 normal = samples.area_normal;
+        if (!Normalize(normal))
+            return false;
+        for (Triangle const &triangle : samples.triangles)
+        {
+            if (Dot(triangle.normal, normal) < cos_tolerance)
+                return false;
+        }
+        double const distance_tolerance = samples.extent * sin_tolerance;
+        for (Vector3 const &corner : samples.corners)
+        {
+            if (std::fabs(Dot(Sub(corner, samples.centroid), normal)) > distance_tolerance)
+                return false;
+        }
+        measurement.kind = FaceMeasurement::Plane;
+        measurement.origin = SC::Store::Point((float)samples.centroid.x, (float)samples.centroid.y, (float)samples.centroid.z);
+        measurement.normal = SC::Store::Vector((float)normal.x, (float)normal.y, (float)normal.z);
+        return true;
+    }
+
+    bool
+    FitCylinder(FaceSamples const &samples, double sin_tolerance, FaceMeasurement &measurement)
+    {
+        // The axis is the direction the normals are most perpendicular to.
+        double moments[3][3] = {{0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}, {0.0, 0.0, 0.0}};
+        for (Triangle const &triangle : samples.triangles)
+        {
+            double const n[3] = {triangle.normal.x, triangle.normal.y, triangle.normal.z};
+            for (int i = 0; i < 3; ++i)
+            {
+                for (int j = 0; j < 3; ++j)
+                    moments[i][j] += triangle.area * n[i] * n[j];
+            }
+        }
+        double values[3];
+        Vector3 vectors[3];
+        SymmetricEigen(moments, values, vectors);
+        // Normals around a cylinder span a plane; a single direction would have been a plane.
+        if (values[1] < 1e-3 * (values[0] + values[1] + values[2]))
+            return false;
+        Vector3 axis = vectors[0];
+        if (!Normalize(axis))
+            return false;
+        for (Triangle const &triangle : samples.triangles)
+        {
+            if (std::fabs(Dot(triangle.normal, axis)) > sin_tolerance)
+                return false;
+        }
+
+        // Least squares circle (Kasa) through the corners projected along the axis, in coordinates
+        // centered on the centroid for conditioning.
+        Vector3 u = vectors[2];
+        double const along = Dot(u, axis);
+        u.x -= along * axis.x, u.y -= along * axis.y, u.z -= along * axis.z;
+        if (!Normalize(u))
+            return false;
+        Vector3 const v = Cross(axis, u);
+        double sxx = 0.0, sxy = 0.0, syy = 0.0, sx = 0.0, sy = 0.0, sxz = 0.0, syz = 0.0, sz = 0.0;
+        double const n = (double)samples.corners.size();
+        double low = 0.0;
+        for (size_t i = 0; i < samples.corners.size(); ++i)
+        {
+            Vector3 const d = Sub(samples.corners[i], samples.centroid);
+            double const x = Dot(d, u), y = Dot(d, v), z = x * x + y * y, t = Dot(d, axis);
+            sxx += x * x, sxy += x * y, syy += y * y, sx += x, sy += y;
+            sxz += x * z, syz += y * z, sz += z;
+            low = i == 0 ? t : std::min(low, t);
+        }
+        // [sxx sxy sx; sxy syy sy; sx sy n] [D E F] = -[sxz syz sz], by Cramer's rule.
+        double const det = sxx * (syy * n - sy * sy) - sxy * (sxy * n - sy * sx) + sx * (sxy * sy - syy * sx);
+        if (std::fabs(det) < 1e-30)
+            return false;
+        double const bx = -sxz, by = -syz, bz = -sz;
+        double const d = (bx * (syy * n - sy * sy) - sxy * (by * n - sy * bz) + sx * (by * sy - syy * bz)) / det;
+        double const e = (sxx * (by * n - sy * bz) - bx * (sxy * n - sy * sx) + sx * (sxy * bz - by * sx)) / det;
+        double const f = (sxx * (syy * bz - by * sy) - sxy * (sxy * bz - by * sx) + bx * (sxy * sy - syy * sx)) / det;
+        double const cx = -d / 2.0, cy = -e / 2.0;
+        double const radius_squared = cx * cx + cy * cy - f;
+        if (!(radius_squared > 0.0))
+            return false;
+        double const radius = std::sqrt(radius_squared);
+
+        double const distance_tolerance = std::max(radius * 1e-3, samples.extent * 1e-5);
+        for (Vector3 const &corner : samples.corners)
+        {
+            Vector3 const d = Sub(corner, samples.centroid);
+            if (std::fabs(std::hypot(Dot(d, u) - cx, Dot(d, v) - cy) - radius) > distance_tolerance)
+                return false;
+        }
+
+        Vector3 const &c = samples.centroid;
+        measurement.kind = FaceMeasurement::Cylinder;
+        measurement.origin = SC::Store::Point((float)(c.x + cx * u.x + cy * v.x + low * axis.x),
+                                              (float)(c.y + cx * u.y + cy * v.y + low * axis.y),
+                                              (float)(c.z + cx * u.z + cy * v.z + low * axis.z));
+        measurement.normal = SC::Store::Vector((float)axis.x, (float)axis.y, (float)axis.z);
+        measurement.radius = (float)radius;
+        return true;
+    }
+}
+
+MeasurementOptions
+MeasurementOptionsFromEnvironment()
+{
+    MeasurementOptions options;
+    if (const char *tolerance = getenv("SC_UPDATE_MEASURE_TOLERANCE"))
+        options.angle_tolerance = std::max(0.0f, (float)atof(tolerance));
+    return options;
+}
+
+void
+DeriveMeasurementData(AuthoredMesh &mesh, MeasurementOptions const &options, MeasurementData &data)
+{
+    data.faces.clear();
+    data.edges.clear();
+    if (options.angle_tolerance <= 0.0f)
+        return;
+    double const radians = options.angle_tolerance * 3.14159265358979323846 / 180.0;
+    double const cos_tolerance = std::cos(radians), sin_tolerance = std::sin(radians);
+
+    uint32_t const face_stride = FaceIndexStride(mesh.mesh.flags);
+    FaceSamples samples;
+    for (uint32_t e = 0; e < (uint32_t)mesh.mesh.face_elements.size(); ++e)
+    {
+        SampleFace(mesh, mesh.mesh.face_elements[e], face_stride, samples);
+        if (samples.triangles.empty())
+            continue;
+        FaceMeasurement measurement;
+        measurement.face = e;
+        if (FitPlane(samples, cos_tolerance, sin_tolerance, measurement) ||
+            (samples.triangles.size() >= options.min_cylinder_triangles && FitCylinder(samples, sin_tolerance, measurement)))
+            data.faces.push_back(measurement);
+    }
+
+    // A polyline is a straight edge when it is no longer than the chord between its ends.
+    uint32_t const line_stride = LineIndexStride(mesh.mesh.flags);
+    for (uint32_t e = 0; e < (uint32_t)mesh.mesh.polyline_elements.size(); ++e)
+    {
+        std::vector<uint32_t> const &indices = mesh.mesh.polyline_elements[e].indices;
+        size_t const vertex_count = indices.size() / line_stride;
+        if (vertex_count < 2)
+            continue;
+        double length = 0.0;
+        for (size_t i = 1; i < vertex_count; ++i)
+        {
+            Vector3 const d = Sub(ToVector3(mesh.points[indices[i * line_stride]]), ToVector3(mesh.points[indices[(i - 1) * line_stride]]));
+            length += std::sqrt(Dot(d, d));
+        }
+        Vector3 const chord = Sub(ToVector3(mesh.points[indices[(vertex_count - 1) * line_stride]]), ToVector3(mesh.points[indices[0]]));
+        double const chord_length = std::sqrt(Dot(chord, chord));
+        if (chord_length > 0.0 && length <= chord_length * (1.0 + 1e-5))
+        {
+            EdgeMeasurement measurement;
+            measurement.edge = e;
+            measurement.length = (float)chord_length;
+            data.edges.push_back(measurement);
+        }
+    }
+
+    if (!data.faces.empty())
+    {
+        mesh.mesh.face_elements_bits.assign(mesh.mesh.face_elements.size(), 0);
+        for (FaceMeasurement const &face : data.faces)
+        {
+            mesh.mesh.face_elements_bits[face.face] = SC::Store::SelectionBitsFaceHasMeasurementData |
+                                                      (face.kind == FaceMeasurement::Plane ? SC::Store::SelectionBitsFacePlanar : 0);
+        }
+    }
+    if (!data.edges.empty())
+    {
+        mesh.mesh.polyline_elements_bits.assign(mesh.mesh.polyline_elements.size(), 0);
+        for (EdgeMeasurement const &edge : data.edges)
+            mesh.mesh.polyline_elements_bits[edge.edge] = SC::Store::SelectionBitsEdgeHasMeasurementData;
+    }
+}
+
+size_t
+SetMeasurementData(SC::Store::AssemblyTree &assembly_tree, SC::Store::NodeId body_node_id, MeasurementData const &data)
+{
+    size_t set = 0;
+    for (FaceMeasurement const &face : data.faces)
+    {
+        bool const ok = face.kind == FaceMeasurement::Plane
+                            ? assembly_tree.SetPlaneFaceMeasurementData(body_node_id, face.face, face.origin, face.normal)
+                            : assembly_tree.SetCylinderFaceMeasurementData(body_node_id, face.face, face.radius, face.origin, face.normal);
+        set += ok ? 1 : 0;
+    }
+    for (EdgeMeasurement const &edge : data.edges)
+        set += assembly_tree.SetLineEdgeMeasurementData(body_node_id, edge.edge, edge.length) ? 1 : 0;
+    return set;
+}
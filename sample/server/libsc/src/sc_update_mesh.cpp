@@ -0,0 +1,488 @@
+#include "sc_update_mesh.h"
+#include "sc_update_bounds.h"
+#include "sc_update_transform.h"
+
+#include <algorithm>
+#include <string.h>
+#include <strings.h>
+
+namespace
+{
+    enum ElementKind
+    {
+        FaceKind,
+        LineKind,
+        PointKind,
+        ElementKindCount
+    };
+
+    const char *const element_keys[ElementKindCount] = {"faces", "lines", "points"};
+
+    struct ElementBits
+    {
+        SC::Store::Mesh::Bits normals;
+        SC::Store::Mesh::Bits uvs;
+        SC::Store::Mesh::Bits rgba32s;
+    };
+
+    const ElementBits element_bits[ElementKindCount] = {
+        {SC::Store::Mesh::FaceNormals, SC::Store::Mesh::FaceUVs, SC::Store::Mesh::FaceRGBA32s},
+        {SC::Store::Mesh::LineNormals, SC::Store::Mesh::LineUVs, SC::Store::Mesh::LineRGBA32s},
+        {SC::Store::Mesh::PointNormals, SC::Store::Mesh::PointUVs, SC::Store::Mesh::PointRGBA32s},
+    };
+
+    // The vertex streams of one face/line/point element as sent by the client.
+    struct ElementStreams
+    {
+        ElementKind kind;
+        JsonNode *position = nullptr;
+        JsonNode *normal = nullptr;
+        JsonNode *rgba = nullptr;
+        JsonNode *uv = nullptr;
+        uint32_t vertex_count = 0;
+        bool has_normals = false;
+        bool has_uvs = false;
+        bool has_rgba32s = false;
+    };
+
+    uint32_t
+    ArrayLength(JsonValue const &value)
+    {
+        if (value.getTag() != JSON_ARRAY)
+            return 0;
+        uint32_t length = 0;
+        for (auto item : value)
+        {
+            (void)item;
+            ++length;
+        }
+        return length;
+    }
+
+    JsonNode *
+    ArrayHead(JsonValue const &value)
+    {
+        return value.getTag() == JSON_ARRAY ? value.toNode() : nullptr;
+    }
+
+    bool
+    IsTruthy(JsonValue const &value)
+    {
+        JsonTag tag = value.getTag();
+        return tag == JSON_TRUE || (tag == JSON_NUMBER && value.toNumber() != 0.0);
+    }
+
+    // Reads the next count numbers of a JSON array, advancing node.
+    bool
+    ReadNumbers(JsonNode *&node, float *out, uint32_t count)
+    {
+        for (uint32_t i = 0; i < count; ++i, node = node->next)
+        {
+            if (!node || node->value.getTag() != JSON_NUMBER)
+                return false;
+            out[i] = (float)node->value.toNumber();
+        }
+        return true;
+    }
+
+    uint8_t
+    ToChannel(float value)
+    {
+        return value <= 0.0f ? 0 : value >= 255.0f ? 255 : (uint8_t)(value + 0.5f);
+    }
+
+    bool
+    ReadElementStreams(ElementKind kind, JsonValue const &element_data, ElementStreams &streams, std::string &error)
+    {
+        streams.kind = kind;
+        if (element_data.getTag() != JSON_OBJECT)
+        {
+            error = std::string(element_keys[kind]) + " entries must be objects";
+            return false;
+        }
+
+        uint32_t position_length = 0, normal_length = 0, rgba_length = 0, uv_length = 0;
+        for (auto stream : element_data)
+        {
+            if (strcmp(stream->key, "position") == 0)
+            {
+                streams.position = ArrayHead(stream->value);
+                position_length = ArrayLength(stream->value);
+            }
+            else if (strcmp(stream->key, "normal") == 0)
+            {
+                streams.normal = ArrayHead(stream->value);
+                normal_length = ArrayLength(stream->value);
+            }
+            else if (strcmp(stream->key, "rgba") == 0)
+            {
+                streams.rgba = ArrayHead(stream->value);
+                rgba_length = ArrayLength(stream->value);
+            }
+            else if (strcmp(stream->key, "uv") == 0)
+            {
+                streams.uv = ArrayHead(stream->value);
+                uv_length = ArrayLength(stream->value);
+            }
+        }
+
+        streams.vertex_count = position_length / 3;
+        uint32_t const vertices_per_primitive = kind == FaceKind ? 3 : kind == LineKind ? 2 : 1;
+        if (position_length % 3 != 0 || streams.vertex_count % vertices_per_primitive != 0)
+        {
+            error = std::string(element_keys[kind]) + " position count does not form whole primitives";
+            return false;
+        }
+
+        streams.has_normals = normal_length != 0;
+        streams.has_uvs = uv_length != 0;
+        streams.has_rgba32s = rgba_length != 0;
+        if ((streams.has_normals && normal_length != streams.vertex_count * 3) ||
+            (streams.has_uvs && uv_length != streams.vertex_count * 2) ||
+            (streams.has_rgba32s && rgba_length != streams.vertex_count * 4))
+        {
+            error = std::string(element_keys[kind]) + " normal/uv/rgba lengths do not match the position count";
+            return false;
+        }
+        return true;
+    }
+
+    // Cursor into the AuthoredMesh attribute buffers while they are being filled.
+    struct AttributeCursor
+    {
+        uint32_t point = 0;
+        uint32_t normal = 0;
+        uint32_t uv = 0;
+        uint32_t rgba32 = 0;
+    };
+
+    // Copies one element's vertex streams into the attribute buffers and returns, per vertex, the
+    // grouped index (point, normal, uv, rgba) in vertex_indices.
+    bool
+    FillElementVertices(ElementStreams const &streams, AuthoredMesh &out, AttributeCursor &cursor,
+                        std::vector<uint32_t> &vertex_indices, uint32_t stride)
+    {
+        vertex_indices.resize((size_t)streams.vertex_count * stride);
+        JsonNode *position = streams.position;
+        JsonNode *normal = streams.normal;
+        JsonNode *rgba = streams.rgba;
+        JsonNode *uv = streams.uv;
+
+        for (uint32_t v = 0; v < streams.vertex_count; ++v)
+        {
+            uint32_t *indices = &vertex_indices[(size_t)v * stride];
+            float values[4];
+            if (!ReadNumbers(position, values, 3))
+                return false;
+            out.points[cursor.point] = SC::Store::Point(values[0], values[1], values[2]);
+            *indices++ = cursor.point++;
+
+            if (streams.has_normals)
+            {
+                if (!ReadNumbers(normal, values, 3))
+                    return false;
+                out.normals[cursor.normal] = SC::Store::Normal(values[0], values[1], values[2]);
+                *indices++ = cursor.normal++;
+            }
+            if (streams.has_uvs)
+            {
+                if (!ReadNumbers(uv, values, 2))
+                    return false;
+                out.uvs[cursor.uv] = SC::Store::UV(values[0], values[1]);
+                *indices++ = cursor.uv++;
+            }
+            if (streams.has_rgba32s)
+            {
+                if (!ReadNumbers(rgba, values, 4))
+                    return false;
+                out.rgba32s[cursor.rgba32] =
+                    SC::Store::RGBA32(ToChannel(values[0]), ToChannel(values[1]), ToChannel(values[2]), ToChannel(values[3]));
+                *indices++ = cursor.rgba32++;
+            }
+        }
+        return true;
+    }
+
+    // Chains a segment list into polylines: a segment whose start point equals the previous
+    // segment's end point continues the current polyline.
+    void
+    AddPolylines(AuthoredMesh &out, std::vector<uint32_t> const &vertex_indices, uint32_t stride)
+    {
+        size_t const vertex_count = vertex_indices.size() / stride;
+        size_t run_begin = 0;
+        for (size_t segment = 0; segment * 2 < vertex_count; ++segment)
+        {
+            size_t const start = segment * 2;
+            bool const continues = start > run_begin &&
+                                   out.points[vertex_indices[start * stride]] == out.points[vertex_indices[(start - 1) * stride]];
+            if (start > run_begin && !continues)
+            {
+                // Close the previous run: its vertices are run_begin, then every segment end.
+                out.mesh.polyline_elements.emplace_back();
+                std::vector<uint32_t> &indices = out.mesh.polyline_elements.back().indices;
+                indices.reserve(((start - run_begin) / 2 + 1) * stride);
+                indices.insert(indices.end(), &vertex_indices[run_begin * stride], &vertex_indices[(run_begin + 1) * stride]);
+                for (size_t end = run_begin + 1; end < start; end += 2)
+                    indices.insert(indices.end(), &vertex_indices[end * stride], &vertex_indices[(end + 1) * stride]);
+                run_begin = start;
+            }
+        }
+        if (vertex_count > run_begin)
+        {
+            out.mesh.polyline_elements.emplace_back();
+            std::vector<uint32_t> &indices = out.mesh.polyline_elements.back().indices;
+            indices.reserve(((vertex_count - run_begin) / 2 + 1) * stride);
+            indices.insert(indices.end(), &vertex_indices[run_begin * stride], &vertex_indices[(run_begin + 1) * stride]);
+            for (size_t end = run_begin + 1; end < vertex_count; end += 2)
+                indices.insert(indices.end(), &vertex_indices[end * stride], &vertex_indices[(end + 1) * stride]);
+        }
+    }
+}
+
+SC::Store::Mesh const &
+AuthoredMesh::Bind()
+{
+    mesh.points = points.empty() ? nullptr : points.data();
+    mesh.point_count = (uint32_t)points.size();
+    mesh.normals = normals.empty() ? nullptr : normals.data();
+    mesh.normal_count = (uint32_t)normals.size();
+    mesh.uvs = uvs.empty() ? nullptr : uvs.data();
+    mesh.uv_count = (uint32_t)uvs.size();
+    mesh.rgba32s = rgba32s.empty() ? nullptr : rgba32s.data();
+    mesh.rgba32_count = (uint32_t)rgba32s.size();
+    return mesh;
+}
+
+void
+AuthoredMesh::ComputeBounds()
+{
+    Bounds bounds;
+    AddPointBounds(points.data(), points.size(), bounds);
+    bounds_min = bounds.empty ? SC::Store::Point(0.0f, 0.0f, 0.0f) : bounds.min;
+    bounds_max = bounds.empty ? SC::Store::Point(0.0f, 0.0f, 0.0f) : bounds.max;
+}
+
+static uint32_t
+IndexStride(SC::Store::Mesh::Bits flags, ElementBits const &bits)
+{
+    return 1 + ((flags & bits.normals) ? 1 : 0) + ((flags & bits.uvs) ? 1 : 0) + ((flags & bits.rgba32s) ? 1 : 0);
+}
+
+uint32_t
+FaceIndexStride(SC::Store::Mesh::Bits flags)
+{
+    return IndexStride(flags, element_bits[FaceKind]);
+}
+
+uint32_t
+LineIndexStride(SC::Store::Mesh::Bits flags)
+{
+    return IndexStride(flags, element_bits[LineKind]);
+}
+
+uint32_t
+PointIndexStride(SC::Store::Mesh::Bits flags)
+{
+    return IndexStride(flags, element_bits[PointKind]);
+}
+
+static IndexLayout
+MakeIndexLayout(SC::Store::Mesh::Bits flags, ElementBits const &bits)
+{
+    IndexLayout layout;
+    layout.stride = 0;
+    layout.slots[layout.stride++] = PointAttribute;
+    if (flags & bits.normals)
+        layout.slots[layout.stride++] = NormalAttribute;
+    if (flags & bits.uvs)
+        layout.slots[layout.stride++] = UVAttribute;
+    if (flags & bits.rgba32s)
+        layout.slots[layout.stride++] = RGBA32Attribute;
+    return layout;
+}
+
+IndexLayout
+FaceIndexLayout(SC::Store::Mesh::Bits flags)
+{
+    return MakeIndexLayout(flags, element_bits[FaceKind]);
+}
+
+IndexLayout
+LineIndexLayout(SC::Store::Mesh::Bits flags)
+{
+    return MakeIndexLayout(flags, element_bits[LineKind]);
+}
+
+IndexLayout
+PointIndexLayout(SC::Store::Mesh::Bits flags)
+{
+    return MakeIndexLayout(flags, element_bits[PointKind]);
+}
+
+uint64_t
+AuthoredMeshBytes(AuthoredMesh const &authored)
+{
+    uint64_t bytes = authored.points.size() * sizeof(SC::Store::Point) + authored.normals.size() * sizeof(SC::Store::Normal) +
+                     authored.uvs.size() * sizeof(SC::Store::UV) + authored.rgba32s.size() * sizeof(SC::Store::RGBA32);
+    for (SC::Store::MeshElement const &element : authored.mesh.face_elements)
+        bytes += element.indices.size() * sizeof(uint32_t);
+    for (SC::Store::MeshElement const &element : authored.mesh.polyline_elements)
+        bytes += element.indices.size() * sizeof(uint32_t);
+    for (SC::Store::MeshElement const &element : authored.mesh.point_elements)
+        bytes += element.indices.size() * sizeof(uint32_t);
+    return bytes;
+}
+
+bool
+BuildAuthoredMesh(JsonValue const &mesh_template, AuthoredMesh &out, std::string &error)
+{
+    if (mesh_template.getTag() != JSON_OBJECT)
+    {
+        error = "mesh entry must be an object";
+        return false;
+    }
+
+    uint32_t flags = SC::Store::Mesh::None;
+    std::vector<ElementStreams> elements;
+    bool has_node_id = false, has_parent_node_id = false, has_polygons = false;
+
+    for (auto item : mesh_template)
+    {
+        if (strcmp(item->key, "nodeId") == 0 && item->value.getTag() == JSON_NUMBER)
+        {
+            out.node_id = (int)item->value.toNumber();
+            has_node_id = true;
+        }
+        else if (strcmp(item->key, "parentNodeId") == 0 && item->value.getTag() == JSON_NUMBER)
+        {
+            out.parent_node_id = (int)item->value.toNumber();
+            has_parent_node_id = true;
+        }
+        else if (strcmp(item->key, "localTransform") == 0)
+        {
+            // null or absent means the parent's frame.
+            if (item->value.getTag() != JSON_NULL)
+            {
+                if (!ParseLocalTransform(item->value, out.local_transform, error))
+                    return false;
+                out.has_local_transform = !IsIdentityTransform(out.local_transform);
+            }
+        }
+        else if (strcmp(item->key, "winding") == 0)
+        {
+            // Communicator.FaceWinding: Unknown = 0, Clockwise = 1, CounterClockwise = 2.
+            JsonTag tag = item->value.getTag();
+            if ((tag == JSON_STRING && strcasecmp(item->value.toString(), "clockwise") == 0) ||
+                (tag == JSON_NUMBER && item->value.toNumber() == 1))
+                flags |= SC::Store::Mesh::ClockwiseWinding;
+            else if ((tag == JSON_STRING && strcasecmp(item->value.toString(), "counterClockwise") == 0) ||
+                     (tag == JSON_NUMBER && item->value.toNumber() == 2))
+                flags |= SC::Store::Mesh::CounterClockwiseWinding;
+        }
+        else if (strcmp(item->key, "isTwoSided") == 0)
+        {
+            if (IsTruthy(item->value))
+                flags |= SC::Store::Mesh::TwoSided;
+        }
+        else if (strcmp(item->key, "isManifold") == 0)
+        {
+            if (IsTruthy(item->value))
+                flags |= SC::Store::Mesh::Manifold;
+        }
+        else if (strcmp(item->key, "polygons") == 0)
+        {
+            // Read and triangulated separately by ReadPolygonFaces().
+            has_polygons = item->value.getTag() == JSON_ARRAY && item->value.toNode() != nullptr;
+        }
+        else
+        {
+            for (int kind = 0; kind < ElementKindCount; ++kind)
+            {
+                if (strcmp(item->key, element_keys[kind]) != 0 || item->value.getTag() != JSON_ARRAY)
+                    continue;
+                for (auto element_data : item->value)
+                {
+                    elements.emplace_back();
+                    if (!ReadElementStreams((ElementKind)kind, element_data->value, elements.back(), error))
+                        return false;
+                    if (elements.back().vertex_count == 0)
+                        elements.pop_back();
+                }
+            }
+        }
+    }
+
+    if (!has_node_id || !has_parent_node_id)
+    {
+        error = "mesh entry needs nodeId and parentNodeId";
+        return false;
+    }
+
+    // Attribute flags are per element type, so all elements of a type must agree on them.
+    size_t point_total = 0, normal_total = 0, uv_total = 0, rgba32_total = 0;
+    bool kind_seen[ElementKindCount] = {false, false, false};
+    for (ElementStreams const &streams : elements)
+    {
+        ElementBits const &bits = element_bits[streams.kind];
+        uint32_t element_flags = (streams.has_normals ? (uint32_t)bits.normals : 0u) | (streams.has_uvs ? (uint32_t)bits.uvs : 0u) |
+                                 (streams.has_rgba32s ? (uint32_t)bits.rgba32s : 0u);
+        uint32_t kind_mask = bits.normals | bits.uvs | bits.rgba32s;
+        if (kind_seen[streams.kind] && (flags & kind_mask) != element_flags)
+        {
+            error = std::string(element_keys[streams.kind]) + " elements disagree on normal/uv/rgba streams";
+            return false;
+        }
+        kind_seen[streams.kind] = true;
+        flags |= element_flags;
+
+        point_total += streams.vertex_count;
+        normal_total += streams.has_normals ? streams.vertex_count : 0;
+        uv_total += streams.has_uvs ? streams.vertex_count : 0;
+        rgba32_total += streams.has_rgba32s ? streams.vertex_count : 0;
+    }
+
+    if (point_total == 0 && !has_polygons)
+    {
+        error = "mesh has no vertices";
+        return false;
+    }
+
+    out.mesh.flags = (SC::Store::Mesh::Bits)flags;
+    out.points.resize(point_total);
+    out.normals.resize(normal_total);
+    out.uvs.resize(uv_total);
+    out.rgba32s.resize(rgba32_total);
+
+    AttributeCursor cursor;
+    std::vector<uint32_t> vertex_indices;
+    for (ElementStreams const &streams : elements)
+    {
+        uint32_t stride = IndexStride(out.mesh.flags, element_bits[streams.kind]);
+        if (!FillElementVertices(streams, out, cursor, vertex_indices, stride))
+        {
+            error = std::string(element_keys[streams.kind]) + " streams contain non-numeric values";
+            return false;
+        }
+
+        switch (streams.kind)
+        {
+        case FaceKind:
+            out.mesh.face_elements.emplace_back();
+            out.mesh.face_elements.back().indices.swap(vertex_indices);
+            break;
+        case LineKind:
+            AddPolylines(out, vertex_indices, stride);
+            break;
+        case PointKind:
+            out.mesh.point_elements.emplace_back();
+            out.mesh.point_elements.back().indices.swap(vertex_indices);
+            break;
+        default:
+            break;
+        }
+        vertex_indices.clear();
+    }
+
+    out.Bind();
+    return true;
+}
@@ -0,0 +1,457 @@
+#include "sc_update_moves.h"
+
+#include <algorithm>
+#include <cmath>
+#include <fstream>
+#include <sstream>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+namespace
+{
+    struct Edit
+    {
+        size_t begin, end;
+        std::string text;
+
+        bool operator<(Edit const &that) const { return begin != that.begin ? begin < that.begin : end < that.end; }
+    };
+
+    bool
+    IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    std::string
+    JoinIds(std::vector<uint32_t> const &ids)
+    {
+        std::string out;
+        char buffer[16];
+        for (size_t i = 0; i < ids.size(); ++i)
+        {
+            snprintf(buffer, sizeof(buffer), i == 0 ? "%u" : " %u", ids[i]);
+            out += buffer;
+        }
+        return out;
+    }
+
+    std::vector<uint32_t>
+    SplitIds(char const *begin, char const *end)
+    {
+        std::vector<uint32_t> ids;
+        while (begin < end)
+        {
+            char *next = nullptr;
+            unsigned long const id = strtoul(begin, &next, 10);
+            if (next == begin)
+                break;
+            ids.push_back((uint32_t)id);
+            begin = next;
+        }
+        return ids;
+    }
+}
+
+bool
+ReadNodeMoves(JsonValue const &moves, std::vector<NodeMove> &out, std::string &error)
+{
+    out.clear();
+    if (moves.getTag() != JSON_ARRAY)
+    {
+        error = "moves must be an array";
+        return false;
+    }
+    for (auto entry : moves)
+    {
+        NodeMove move;
+        bool has_node_id = false, has_parent_node_id = false;
+        if (entry->value.getTag() == JSON_OBJECT)
+        {
+            for (auto item : entry->value)
+            {
+                if (strcmp(item->key, "nodeId") == 0 && item->value.getTag() == JSON_NUMBER && item->value.toNumber() >= 0)
+                {
+                    move.node_id = (uint32_t)item->value.toNumber();
+                    has_node_id = true;
+                }
+                else if (strcmp(item->key, "parentNodeId") == 0 && item->value.getTag() == JSON_NUMBER && item->value.toNumber() >= 0)
+                {
+                    move.parent_node_id = (uint32_t)item->value.toNumber();
+                    has_parent_node_id = true;
+                }
+                else if (strcmp(item->key, "keepWorldTransform") == 0)
+                    move.keep_world_transform = item->value.getTag() != JSON_FALSE;
+            }
+        }
+        if (!has_node_id || !has_parent_node_id)
+        {
+            error = "move entry needs nodeId and parentNodeId of existing nodes";
+            return false;
+        }
+        out.push_back(move);
+    }
+    return true;
+}
+
+AssemblyXml::Affine
+AssemblyXml::Identity()
+{
+    Affine identity = {{1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0}};
+    return identity;
+}
+
+AssemblyXml::Affine
+AssemblyXml::Compose(Affine const &a, Affine const &b)
+{
+    // a applied after b.
+    Affine c;
+    for (int column = 0; column < 4; ++column)
+    {
+        double const *v = &b.m[column * 3];
+        for (int row = 0; row < 3; ++row)
+            c.m[column * 3 + row] = a.m[row] * v[0] + a.m[3 + row] * v[1] + a.m[6 + row] * v[2] + (column == 3 ? a.m[9 + row] : 0.0);
+    }
+    return c;
+}
+
+bool
+AssemblyXml::Invert(Affine const &a, Affine &inverse)
+{
+    double const *m = a.m;
+    // Cofactors of the 3x3 linear part (columns are the axes).
+    double const c00 = m[4] * m[8] - m[7] * m[5], c01 = m[7] * m[2] - m[1] * m[8], c02 = m[1] * m[5] - m[4] * m[2];
+    double const det = m[0] * c00 + m[3] * c01 + m[6] * c02;
+    if (std::fabs(det) < 1e-300)
+        return false;
+    double const s = 1.0 / det;
+    double *r = inverse.m;
+    r[0] = c00 * s, r[1] = c01 * s, r[2] = c02 * s;
+    r[3] = (m[6] * m[5] - m[3] * m[8]) * s, r[4] = (m[0] * m[8] - m[6] * m[2]) * s, r[5] = (m[3] * m[2] - m[0] * m[5]) * s;
+    r[6] = (m[3] * m[7] - m[6] * m[4]) * s, r[7] = (m[6] * m[1] - m[0] * m[7]) * s, r[8] = (m[0] * m[4] - m[3] * m[1]) * s;
+    for (int row = 0; row < 3; ++row)
+        r[9 + row] = -(r[row] * m[9] + r[3 + row] * m[10] + r[6 + row] * m[11]);
+    return true;
+}
+
+AssemblyXml::Affine
+AssemblyXml::Local(Occurrence const &occurrence) const
+{
+    if (occurrence.local_dirty)
+        return occurrence.local;
+    if (!occurrence.has_transform)
+        return Identity();
+
+    // RelativeTransfo is a column major 4x4; the fourth row is 0 0 0 1.
+    double values[16];
+    char const *cursor = _text.c_str() + occurrence.transform_begin;
+    for (int i = 0; i < 16; ++i)
+    {
+        char *next = nullptr;
+        values[i] = strtod(cursor, &next);
+        if (next == cursor)
+            return Identity();
+        cursor = next;
+    }
+    Affine local;
+    for (int column = 0; column < 4; ++column)
+    {
+        for (int row = 0; row < 3; ++row)
+            local.m[column * 3 + row] = values[column * 4 + row];
+    }
+    return local;
+}
+
+AssemblyXml::Affine
+AssemblyXml::World(uint32_t node_id)
+{
+    // Walk up to the nearest cached ancestor, then compose back down, caching every step.
+    std::vector<uint32_t> chain;
+    Affine world = Identity();
+    for (uint32_t id = node_id;;)
+    {
+        auto cached = _worlds.find(id);
+        if (cached != _worlds.end())
+        {
+            world = cached->second;
+            break;
+        }
+        chain.push_back(id);
+        Occurrence const &occurrence = _occurrences[id];
+        if (!occurrence.has_parent || chain.size() > _occurrences.size())
+            break;
+        id = occurrence.parent;
+    }
+    for (size_t i = chain.size(); i-- > 0;)
+    {
+        world = Compose(world, Local(_occurrences[chain[i]]));
+        _worlds[chain[i]] = world;
+    }
+    return world;
+}
+
+bool
+AssemblyXml::Load(std::string text, std::string &error)
+{
+    _text.swap(text);
+    _occurrences.clear();
+    _worlds.clear();
+
+    static char const tag[] = "<ProductOccurence";
+    size_t const tag_length = sizeof(tag) - 1;
+    std::unordered_map<uint32_t, uint32_t> parents;
+    for (size_t position = _text.find(tag); position != std::string::npos; position = _text.find(tag, position))
+    {
+        position += tag_length;
+        if (position >= _text.size() || !IsSpace(_text[position]))
+            continue;
+
+        Occurrence occurrence;
+        bool has_id = false;
+        uint32_t id = 0;
+        // Attributes: name="value" pairs up to '>' or "/>".
+        size_t cursor = position;
+        for (;;)
+        {
+            size_t const attribute = cursor;
+            while (cursor < _text.size() && IsSpace(_text[cursor]))
+                ++cursor;
+            if (cursor >= _text.size())
+            {
+                error = "unterminated ProductOccurence tag";
+                return false;
+            }
+            if (_text[cursor] == '>' || _text.compare(cursor, 2, "/>") == 0)
+            {
+                occurrence.start_tag_end = cursor;
+                occurrence.self_closing = _text[cursor] == '/';
+                break;
+            }
+            size_t const equals = _text.find('=', cursor);
+            if (equals == std::string::npos || equals + 1 >= _text.size() || _text[equals + 1] != '"')
+            {
+                error = "malformed ProductOccurence attribute";
+                return false;
+            }
+            size_t const value_begin = equals + 2;
+            size_t const value_end = _text.find('"', value_begin);
+            if (value_end == std::string::npos)
+            {
+                error = "unterminated ProductOccurence attribute";
+                return false;
+            }
+            if (_text.compare(cursor, equals - cursor, "Id") == 0)
+            {
+                id = (uint32_t)strtoul(_text.c_str() + value_begin, nullptr, 10);
+                has_id = true;
+            }
+            else if (_text.compare(cursor, equals - cursor, "Children") == 0)
+            {
+                occurrence.has_children_attribute = true;
+                occurrence.children_attribute = attribute;
+                occurrence.children_begin = value_begin;
+                occurrence.children_end = value_end;
+            }
+            cursor = value_end + 1;
+        }
+        position = occurrence.start_tag_end;
+        if (!has_id)
+            continue;
+
+        // The local transform is the first child element, if any.
+        if (!occurrence.self_closing)
+        {
+            size_t child = occurrence.start_tag_end + 1;
+            while (child < _text.size() && IsSpace(_text[child]))
+                ++child;
+            static char const transformation[] = "<Transformation";
+            if (_text.compare(child, sizeof(transformation) - 1, transformation) == 0)
+            {
+                size_t const element_end = _text.find('>', child);
+                size_t const attribute = _text.find("RelativeTransfo=\"", child);
+                if (attribute != std::string::npos && attribute < element_end)
+                {
+                    occurrence.transform_begin = attribute + sizeof("RelativeTransfo=\"") - 1;
+                    occurrence.transform_end = _text.find('"', occurrence.transform_begin);
+                    occurrence.has_transform = occurrence.transform_end != std::string::npos;
+                }
+            }
+        }
+
+        if (occurrence.has_children_attribute)
+        {
+            occurrence.children = SplitIds(_text.c_str() + occurrence.children_begin, _text.c_str() + occurrence.children_end);
+            for (uint32_t child : occurrence.children)
+                parents[child] = id;
+        }
+        _occurrences[id] = occurrence;
+    }
+
+    for (auto const &parent : parents)
+    {
+        auto child = _occurrences.find(parent.first);
+        if (child != _occurrences.end())
+        {
+            child->second.has_parent = true;
+            child->second.parent = parent.second;
+        }
+    }
+    return true;
+}
+
+bool
+AssemblyXml::Move(NodeMove const &move, std::string &error)
+{
+    char buffer[96];
+    auto node = _occurrences.find(move.node_id);
+    auto parent = _occurrences.find(move.parent_node_id);
+    if (node == _occurrences.end() || parent == _occurrences.end())
+    {
+        snprintf(buffer, sizeof(buffer), "node %u or %u is not a ProductOccurence", move.node_id, move.parent_node_id);
+        error = buffer;
+        return false;
+    }
+    if (!node->second.has_parent)
+    {
+        snprintf(buffer, sizeof(buffer), "node %u is a root and cannot be moved", move.node_id);
+        error = buffer;
+        return false;
+    }
+    for (uint32_t id = move.parent_node_id;;)
+    {
+        if (id == move.node_id)
+        {
+            snprintf(buffer, sizeof(buffer), "node %u cannot move under its own subtree", move.node_id);
+            error = buffer;
+            return false;
+        }
+        Occurrence const &ancestor = _occurrences[id];
+        if (!ancestor.has_parent)
+            break;
+        id = ancestor.parent;
+    }
+    if (node->second.parent == move.parent_node_id)
+        return true;
+
+    Affine local = Local(node->second);
+    if (move.keep_world_transform)
+    {
+        Affine inverse_parent;
+        if (!Invert(World(move.parent_node_id), inverse_parent))
+        {
+            snprintf(buffer, sizeof(buffer), "node %u has a singular world transform", move.parent_node_id);
+            error = buffer;
+            return false;
+        }
+        local = Compose(inverse_parent, World(move.node_id));
+    }
+
+    Occurrence &old_parent = _occurrences[node->second.parent];
+    old_parent.children.erase(std::remove(old_parent.children.begin(), old_parent.children.end(), move.node_id),
+                              old_parent.children.end());
+    old_parent.children_dirty = true;
+    parent->second.children.push_back(move.node_id);
+    parent->second.children_dirty = true;
+    node->second.parent = move.parent_node_id;
+    node->second.local = local;
+    node->second.local_dirty = true;
+    // A kept world transform leaves every cached world valid; otherwise the subtree moved.
+    if (!move.keep_world_transform)
+        _worlds.clear();
+    return true;
+}
+
+std::string
+AssemblyXml::Write() const
+{
+    std::vector<Edit> edits;
+    for (auto const &entry : _occurrences)
+    {
+        Occurrence const &occurrence = entry.second;
+        if (occurrence.children_dirty)
+        {
+            if (occurrence.has_children_attribute && occurrence.children.empty())
+                edits.push_back(Edit{occurrence.children_attribute, occurrence.children_end + 1, std::string()});
+            else if (occurrence.has_children_attribute)
+                edits.push_back(Edit{occurrence.children_begin, occurrence.children_end, JoinIds(occurrence.children)});
+            else if (!occurrence.children.empty())
+                edits.push_back(Edit{occurrence.start_tag_end, occurrence.start_tag_end, " Children=\"" + JoinIds(occurrence.children) + "\""});
+        }
+        if (occurrence.local_dirty)
+        {
+            std::string matrix;
+            char value[32];
+            for (int column = 0; column < 4; ++column)
+            {
+                for (int row = 0; row < 3; ++row)
+                {
+                    snprintf(value, sizeof(value), "%.17g ", occurrence.local.m[column * 3 + row]);
+                    matrix += value;
+                }
+                matrix += column == 3 ? "1" : "0 ";
+            }
+            if (occurrence.has_transform)
+                edits.push_back(Edit{occurrence.transform_begin, occurrence.transform_end, matrix});
+            else if (occurrence.self_closing)
+                edits.push_back(Edit{occurrence.start_tag_end, occurrence.start_tag_end + 2,
+                                     "><Transformation RelativeTransfo=\"" + matrix + "\"/></ProductOccurence>"});
+            else
+                edits.push_back(Edit{occurrence.start_tag_end + 1, occurrence.start_tag_end + 1,
+                                     "<Transformation RelativeTransfo=\"" + matrix + "\"/>"});
+        }
+    }
+    std::sort(edits.begin(), edits.end());
+
+    std::string out;
+    out.reserve(_text.size() + edits.size() * 64);
+    size_t copied = 0;
+    for (Edit const &edit : edits)
+    {
+        out.append(_text, copied, edit.begin - copied);
+        out += edit.text;
+        copied = edit.end;
+    }
+    out.append(_text, copied, std::string::npos);
+    return out;
+}
+
+bool
+ApplyNodeMoves(std::string const &xml_path, std::string const &moved_xml_path, std::vector<NodeMove> const &moves,
+               size_t &moved, std::vector<std::string> &errors)
+{
+    moved = 0;
+    std::ifstream in(xml_path, std::ios::binary);
+    if (!in)
+    {
+        errors.push_back("cannot read " + xml_path);
+        return false;
+    }
+    std::ostringstream text;
+    text << in.rdbuf();
+
+    AssemblyXml xml;
+    std::string error;
+    if (!xml.Load(text.str(), error))
+    {
+        errors.push_back(error);
+        return false;
+    }
+    for (NodeMove const &move : moves)
+    {
+        if (xml.Move(move, error))
+            ++moved;
+        else
+            errors.push_back(error);
+    }
+
+    std::ofstream out(moved_xml_path, std::ios::binary | std::ios::trunc);
+    std::string const written = xml.Write();
+    out.write(written.data(), (std::streamsize)written.size());
+    if (!out)
+    {
+        errors.push_back("cannot write " + moved_xml_path);
+        return false;
+    }
+    return true;
+}
@@ -0,0 +1,70 @@
+#include "sc_update_parallel.h"
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <mutex>
+#include <stdlib.h>
+#include <thread>
+#include <vector>
+
+unsigned
+ParallelWorkerCount()
+{
+    static unsigned const worker_count = []() {
+        const char *configured = getenv("SC_UPDATE_THREADS");
+        if (configured && atoi(configured) > 0)
+            return (unsigned)atoi(configured);
+        unsigned hardware = std::thread::hardware_concurrency();
+        return hardware > 0 ? hardware : 1u;
+    }();
+    return worker_count;
+}
+
+void
+ParallelFor(size_t count, std::function<void(size_t)> const &body)
+{
+    if (count == 0)
+        return;
+
+    size_t const thread_count = std::min((size_t)ParallelWorkerCount(), count);
+    if (thread_count <= 1)
+    {
+        for (size_t i = 0; i < count; ++i)
+            body(i);
+        return;
+    }
+
+    std::atomic<size_t> next(0);
+    std::atomic<bool> failed(false);
+    std::exception_ptr first_error;
+    std::mutex error_mutex;
+
+    auto worker = [&]() {
+        for (size_t i = next.fetch_add(1); i < count && !failed.load(); i = next.fetch_add(1))
+        {
+            try
+            {
+                body(i);
+            }
+            catch (...)
+            {
+                std::lock_guard<std::mutex> lock(error_mutex);
+                if (!first_error)
+                    first_error = std::current_exception();
+                failed.store(true);
+            }
+        }
+    };
+
+    std::vector<std::thread> threads;
+    threads.reserve(thread_count - 1);
+    for (size_t t = 1; t < thread_count; ++t)
+        threads.emplace_back(worker);
+    worker();
+    for (std::thread &thread : threads)
+        thread.join();
+
+    if (first_error)
+        std::rethrow_exception(first_error);
+}
@@ -0,0 +1,352 @@
+#include "sc_update_pointcloud.h"
+#include "sc_update_bounds.h"
+#include "sc_update_transform.h"
+
+#include <algorithm>
+#include <cmath>
+#include <stdlib.h>
+#include <string.h>
+
+static_assert(sizeof(SC::Store::Point) == 3 * sizeof(float), "Point buffers are filled as packed float32 x,y,z");
+static_assert(sizeof(SC::Store::RGBA32) == 4, "RGBA32 buffers are filled as packed uint8 r,g,b,a");
+
+namespace
+{
+    uint8_t
+    ToChannel(double value)
+    {
+        return value <= 0.0 ? 0 : value >= 255.0 ? 255 : (uint8_t)(value + 0.5);
+    }
+
+    // Number of numbers in a JSON array, or -1 if it holds anything else.
+    long
+    NumberCount(JsonValue const &value)
+    {
+        if (value.getTag() != JSON_ARRAY)
+            return -1;
+        long count = 0;
+        for (auto item : value)
+        {
+            if (item->value.getTag() != JSON_NUMBER)
+                return -1;
+            ++count;
+        }
+        return count;
+    }
+
+    int
+    Base64Digit(char c)
+    {
+        if (c >= 'A' && c <= 'Z')
+            return c - 'A';
+        if (c >= 'a' && c <= 'z')
+            return c - 'a' + 26;
+        if (c >= '0' && c <= '9')
+            return c - '0' + 52;
+        if (c == '+' || c == '-')
+            return 62;
+        if (c == '/' || c == '_')
+            return 63;
+        return -1;
+    }
+
+    // Decoded size of a base64 string, or -1 if it is not valid base64.
+    long
+    Base64Size(char const *text)
+    {
+        size_t length = strlen(text);
+        while (length > 0 && text[length - 1] == '=')
+            --length;
+        if (length % 4 == 1)
+            return -1;
+        return (long)(length / 4 * 3 + (length % 4 ? length % 4 - 1 : 0));
+    }
+
+    // Decodes base64 into a buffer of exactly Base64Size(text) bytes.
+    bool
+    DecodeBase64(char const *text, uint8_t *out, size_t size)
+    {
+        uint32_t bits = 0;
+        int bit_count = 0;
+        size_t written = 0;
+        for (char const *c = text; *c && *c != '='; ++c)
+        {
+            int const digit = Base64Digit(*c);
+            if (digit < 0)
+                return false;
+            bits = bits << 6 | (uint32_t)digit;
+            bit_count += 6;
+            if (bit_count >= 8)
+            {
+                bit_count -= 8;
+                if (written == size)
+                    return false;
+                out[written++] = (uint8_t)(bits >> bit_count);
+            }
+        }
+        return written == size;
+    }
+
+    uint64_t
+    SpreadBits21(uint64_t value)
+    {
+        value &= 0x1fffff;
+        value = (value | value << 32) & 0x001f00000000ffffull;
+        value = (value | value << 16) & 0x001f0000ff0000ffull;
+        value = (value | value << 8) & 0x100f00f00f00f00full;
+        value = (value | value << 4) & 0x10c30c30c30c30c3ull;
+        value = (value | value << 2) & 0x1249249249249249ull;
+        return value;
+    }
+}
+
+bool
+CheckPointCloudPositions(JsonValue const &cloud_template, std::string &error)
+{
+    if (cloud_template.getTag() != JSON_OBJECT)
+        return true;
+    for (auto item : cloud_template)
+    {
+        if (strcmp(item->key, "positionData") == 0 && item->value.getTag() == JSON_STRING)
+        {
+            char const *text = item->value.toString();
+            long const size = Base64Size(text);
+            if (size < 0 || size % sizeof(SC::Store::Point) != 0)
+            {
+                error = "positionData is not base64 of float32 x,y,z triples";
+                return false;
+            }
+            // Decoded one point at a time, so checking does not allocate the whole cloud.
+            uint8_t point_bytes[sizeof(SC::Store::Point)];
+            size_t filled = 0, index = 0;
+            uint32_t bits = 0;
+            int bit_count = 0;
+            for (char const *c = text; *c && *c != '='; ++c)
+            {
+                int const digit = Base64Digit(*c);
+                if (digit < 0)
+                {
+                    error = "positionData is not valid base64";
+                    return false;
+                }
+                bits = bits << 6 | (uint32_t)digit;
+                bit_count += 6;
+                if (bit_count < 8)
+                    continue;
+                bit_count -= 8;
+                point_bytes[filled++] = (uint8_t)(bits >> bit_count);
+                if (filled < sizeof(point_bytes))
+                    continue;
+                SC::Store::Point point;
+                memcpy(&point, point_bytes, sizeof(point));
+                if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+                {
+                    error = "point " + std::to_string(index) + " has a non-finite coordinate";
+                    return false;
+                }
+                filled = 0;
+                ++index;
+            }
+        }
+        else if (strcmp(item->key, "position") == 0 && item->value.getTag() == JSON_ARRAY)
+        {
+            size_t index = 0;
+            for (auto number : item->value)
+            {
+                if (number->value.getTag() == JSON_NUMBER && !std::isfinite((float)number->value.toNumber()))
+                {
+                    error = "point " + std::to_string(index / 3) + " has a non-finite coordinate";
+                    return false;
+                }
+                ++index;
+            }
+        }
+    }
+    return true;
+}
+
+PointCloudOptions
+PointCloudOptionsFromEnvironment()
+{
+    PointCloudOptions options;
+    if (const char *batch = getenv("SC_UPDATE_POINT_BATCH"))
+        options.batch_points = (size_t)strtoull(batch, nullptr, 10);
+    return options;
+}
+
+bool
+BuildPointCloud(JsonValue const &cloud_template, PointCloud &out, std::string &error)
+{
+    if (cloud_template.getTag() != JSON_OBJECT)
+    {
+        error = "point cloud entry must be an object";
+        return false;
+    }
+
+    bool has_node_id = false, has_parent_node_id = false;
+    JsonValue const *position = nullptr, *rgba = nullptr;
+    char const *position_data = nullptr, *rgba_data = nullptr;
+    for (auto item : cloud_template)
+    {
+        if (strcmp(item->key, "nodeId") == 0 && item->value.getTag() == JSON_NUMBER)
+        {
+            out.node_id = (int)item->value.toNumber();
+            has_node_id = true;
+        }
+        else if (strcmp(item->key, "parentNodeId") == 0 && item->value.getTag() == JSON_NUMBER)
+        {
+            out.parent_node_id = (int)item->value.toNumber();
+            has_parent_node_id = true;
+        }
+        else if (strcmp(item->key, "localTransform") == 0 && item->value.getTag() != JSON_NULL)
+        {
+            if (!ParseLocalTransform(item->value, out.local_transform, error))
+                return false;
+            out.has_local_transform = !IsIdentityTransform(out.local_transform);
+        }
+        else if (strcmp(item->key, "position") == 0)
+            position = &item->value;
+        else if (strcmp(item->key, "rgba") == 0)
+            rgba = &item->value;
+        else if (strcmp(item->key, "positionData") == 0 && item->value.getTag() == JSON_STRING)
+            position_data = item->value.toString();
+        else if (strcmp(item->key, "rgbaData") == 0 && item->value.getTag() == JSON_STRING)
+            rgba_data = item->value.toString();
+    }
+
+    if (!has_node_id || !has_parent_node_id)
+    {
+        error = "point cloud entry needs nodeId and parentNodeId";
+        return false;
+    }
+
+    if (position_data != nullptr)
+    {
+        long const size = Base64Size(position_data);
+        if (size < 0 || size % sizeof(SC::Store::Point) != 0)
+        {
+            error = "positionData is not base64 of float32 x,y,z triples";
+            return false;
+        }
+        out.points.resize((size_t)size / sizeof(SC::Store::Point));
+        if (!DecodeBase64(position_data, (uint8_t *)out.points.data(), (size_t)size))
+        {
+            error = "positionData is not valid base64";
+            return false;
+        }
+    }
+    else if (position != nullptr)
+    {
+        long const count = NumberCount(*position);
+        if (count < 0 || count % 3 != 0)
+        {
+            error = "position must be an array of x,y,z numbers";
+            return false;
+        }
+        out.points.resize((size_t)count / 3);
+        float *values = (float *)out.points.data();
+        for (auto item : *position)
+            *values++ = (float)item->value.toNumber();
+    }
+
+    if (rgba_data != nullptr)
+    {
+        long const size = Base64Size(rgba_data);
+        if (size < 0 || (size_t)size != out.points.size() * sizeof(SC::Store::RGBA32))
+        {
+            error = "rgbaData must hold one uint8 r,g,b,a color per point";
+            return false;
+        }
+        out.rgba32s.resize(out.points.size());
+        if (!DecodeBase64(rgba_data, (uint8_t *)out.rgba32s.data(), (size_t)size))
+        {
+            error = "rgbaData is not valid base64";
+            return false;
+        }
+    }
+    else if (rgba != nullptr && NumberCount(*rgba) != 0)
+    {
+        if (NumberCount(*rgba) != (long)out.points.size() * 4)
+        {
+            error = "rgba must hold one r,g,b,a color per point";
+            return false;
+        }
+        out.rgba32s.resize(out.points.size());
+        uint8_t *channels = (uint8_t *)out.rgba32s.data();
+        for (auto item : *rgba)
+            *channels++ = ToChannel(item->value.toNumber());
+    }
+
+    if (out.points.empty())
+    {
+        error = "point cloud has no points";
+        return false;
+    }
+    // Decoded float32 data can hold NaN or Inf, and large JSON numbers overflow to Inf. Either
+    // would break the Morton bucketing and the bounds set on the tree.
+    for (size_t i = 0; i < out.points.size(); ++i)
+    {
+        SC::Store::Point const &point = out.points[i];
+        if (!std::isfinite(point.x) || !std::isfinite(point.y) || !std::isfinite(point.z))
+        {
+            error = "point " + std::to_string(i) + " has a non-finite coordinate";
+            return false;
+        }
+    }
+    return true;
+}
+
+void
+BucketPointCloud(PointCloud &cloud, PointCloudOptions const &options, std::vector<PointCloudBatch> &batches)
+{
+    batches.clear();
+    std::vector<SC::Store::Point> &points = cloud.points;
+    if (points.empty())
+        return;
+
+    Bounds cloud_bounds;
+    AddPointBounds(points.data(), points.size(), cloud_bounds);
+    SC::Store::Point const min_point = cloud_bounds.min, max_point = cloud_bounds.max;
+    uint64_t const max_cell = (1 << 21) - 1;
+    float const scale_x = max_point.x > min_point.x ? max_cell / (max_point.x - min_point.x) : 0.0f;
+    float const scale_y = max_point.y > min_point.y ? max_cell / (max_point.y - min_point.y) : 0.0f;
+    float const scale_z = max_point.z > min_point.z ? max_cell / (max_point.z - min_point.z) : 0.0f;
+    auto cell = [&](float offset, float scale) { return std::min((uint64_t)(offset * scale), max_cell); };
+
+    std::vector<std::pair<uint64_t, uint32_t>> order(points.size());
+    for (size_t i = 0; i < points.size(); ++i)
+    {
+        SC::Store::Point const &p = points[i];
+        order[i].first = SpreadBits21(cell(p.x - min_point.x, scale_x)) | SpreadBits21(cell(p.y - min_point.y, scale_y)) << 1 |
+                         SpreadBits21(cell(p.z - min_point.z, scale_z)) << 2;
+        order[i].second = (uint32_t)i;
+    }
+    std::sort(order.begin(), order.end());
+
+    {
+        std::vector<SC::Store::Point> sorted(points.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            sorted[i] = points[order[i].second];
+        points.swap(sorted);
+    }
+    if (!cloud.rgba32s.empty())
+    {
+        std::vector<SC::Store::RGBA32> sorted(cloud.rgba32s.size());
+        for (size_t i = 0; i < order.size(); ++i)
+            sorted[i] = cloud.rgba32s[order[i].second];
+        cloud.rgba32s.swap(sorted);
+    }
+
+    size_t const batch_points = options.batch_points > 0 ? options.batch_points : points.size();
+    for (size_t begin = 0; begin < points.size(); begin += batch_points)
+    {
+        PointCloudBatch batch;
+        batch.begin = begin;
+        batch.count = std::min(batch_points, points.size() - begin);
+        Bounds bounds;
+        AddPointBounds(&points[begin], batch.count, bounds);
+        batch.bounds_min = bounds.min;
+        batch.bounds_max = bounds.max;
+        batches.push_back(batch);
+    }
+}
@@ -0,0 +1,204 @@
+#include "sc_update_polygons.h"
+
+#include <cmath>
+#include <string.h>
+
+#include "sc_store_utils.h"
+
+namespace
+{
+    uint8_t
+    ToChannel(double value)
+    {
+        return value <= 0.0 ? 0 : value >= 255.0 ? 255 : (uint8_t)(value + 0.5);
+    }
+
+    // Reads a JSON array of numbers; false if it holds anything else.
+    bool
+    ReadNumberArray(JsonValue const &value, std::vector<double> &numbers)
+    {
+        numbers.clear();
+        if (value.getTag() != JSON_ARRAY)
+            return false;
+        for (auto item : value)
+        {
+            if (item->value.getTag() != JSON_NUMBER)
+                return false;
+            numbers.push_back(item->value.toNumber());
+        }
+        return true;
+    }
+
+    bool
+    ReadPolygonFace(JsonValue const &value, PolygonFace &face, std::string &error)
+    {
+        if (value.getTag() != JSON_OBJECT)
+        {
+            error = "polygons entries must be objects";
+            return false;
+        }
+        std::vector<double> numbers;
+        for (auto item : value)
+        {
+            if (strcmp(item->key, "position") == 0)
+            {
+                if (!ReadNumberArray(item->value, numbers) || numbers.size() % 3 != 0)
+                {
+                    error = "polygon position must be an array of x,y,z numbers";
+                    return false;
+                }
+                face.loop.resize(numbers.size() / 3);
+                for (size_t i = 0; i < face.loop.size(); ++i)
+                    face.loop[i] = SC::Store::Point((float)numbers[i * 3], (float)numbers[i * 3 + 1], (float)numbers[i * 3 + 2]);
+            }
+            else if (strcmp(item->key, "normal") == 0 && item->value.getTag() != JSON_NULL)
+            {
+                if (!ReadNumberArray(item->value, numbers) || numbers.size() != 3)
+                {
+                    error = "polygon normal must be 3 numbers";
+                    return false;
+                }
+                face.has_normal = true;
+                face.normal = SC::Store::Normal((float)numbers[0], (float)numbers[1], (float)numbers[2]);
+            }
+            else if (strcmp(item->key, "rgba") == 0 && item->value.getTag() != JSON_NULL)
+            {
+                if (!ReadNumberArray(item->value, numbers) || (numbers.size() != 4 && !numbers.empty()))
+                {
+                    error = "polygon rgba must be 4 numbers";
+                    return false;
+                }
+                face.has_color = !numbers.empty();
+                if (face.has_color)
+                    face.color = SC::Store::RGBA32(ToChannel(numbers[0]), ToChannel(numbers[1]), ToChannel(numbers[2]),
+                                                   ToChannel(numbers[3]));
+            }
+        }
+        if (face.loop.size() > 1 && face.loop.front() == face.loop.back())
+            face.loop.pop_back();
+        if (face.loop.size() < 3)
+        {
+            error = "polygon needs at least 3 corners";
+            return false;
+        }
+        return true;
+    }
+}
+
+bool
+ReadPolygonFaces(JsonValue const &mesh_template, std::vector<PolygonFace> &faces, std::string &error)
+{
+    faces.clear();
+    if (mesh_template.getTag() != JSON_OBJECT)
+        return true;
+    for (auto item : mesh_template)
+    {
+        if (strcmp(item->key, "polygons") != 0 || item->value.getTag() == JSON_NULL)
+            continue;
+        if (item->value.getTag() != JSON_ARRAY)
+        {
+            error = "polygons must be an array";
+            return false;
+        }
+        for (auto polygon : item->value)
+        {
+            faces.emplace_back();
+            if (!ReadPolygonFace(polygon->value, faces.back(), error))
+                return false;
+        }
+    }
+    return true;
+}
+
+void
+TriangulatePolygonFace(PolygonFace &face)
+{
+    face.valid = false;
+    if (!face.has_normal)
+    {
+        // Newell's method: robust for concave and slightly non-planar loops.
+        double x = 0.0, y = 0.0, z = 0.0;
+        for (size_t i = 0; i < face.loop.size(); ++i)
+        {
+            SC::Store::Point const &a = face.loop[i];
+            SC::Store::Point const &b = face.loop[(i + 1) % face.loop.size()];
+            x += ((double)a.y - b.y) * ((double)a.z + b.z);
+            y += ((double)a.z - b.z) * ((double)a.x + b.x);
+            z += ((double)a.x - b.x) * ((double)a.y + b.y);
+        }
+        face.normal = SC::Store::Normal((float)x, (float)y, (float)z);
+    }
+    double const length = std::sqrt((double)face.normal.x * face.normal.x + (double)face.normal.y * face.normal.y +
+                                    (double)face.normal.z * face.normal.z);
+    if (!(length > 0.0))
+        return;
+    face.normal = SC::Store::Normal((float)(face.normal.x / length), (float)(face.normal.y / length),
+                                    (float)(face.normal.z / length));
+
+    std::vector<int> face_list(face.loop.size());
+    for (size_t i = 0; i < face_list.size(); ++i)
+        face_list[i] = (int)i;
+    SC::Store::Point const normal(face.normal.x, face.normal.y, face.normal.z);
+    face.triangles.clear();
+    if (!SC::Store::Utils::TriangulateFace(face.loop.data(), face_list.data(), face_list.size(), normal, face.triangles))
+        return;
+    face.triangles.resize(face.triangles.size() / 3 * 3);
+    face.valid = !face.triangles.empty();
+}
+
+bool
+MergePolygonFaces(AuthoredMesh const &owner, std::vector<PolygonFace> &faces, AuthoredMesh &polygon_mesh)
+{
+    polygon_mesh = AuthoredMesh();
+    polygon_mesh.node_id = owner.node_id;
+    polygon_mesh.parent_node_id = owner.parent_node_id;
+
+    bool colored = false;
+    size_t corner_count = 0, polygon_count = 0;
+    for (PolygonFace const &face : faces)
+    {
+        if (!face.valid)
+            continue;
+        colored = colored || face.has_color;
+        corner_count += face.triangles.size();
+        ++polygon_count;
+    }
+    if (corner_count == 0)
+        return false;
+
+    uint32_t flags = SC::Store::Mesh::FaceNormals | SC::Store::Mesh::TwoSided;
+    if (colored)
+        flags |= SC::Store::Mesh::FaceRGBA32s;
+    polygon_mesh.mesh.flags = (SC::Store::Mesh::Bits)flags;
+
+    // Every buffer is sized once; corners are de-indexed here and shared by the weld afterwards.
+    polygon_mesh.points.reserve(corner_count);
+    polygon_mesh.normals.reserve(polygon_count);
+    if (colored)
+        polygon_mesh.rgba32s.reserve(polygon_count);
+    polygon_mesh.mesh.face_elements.emplace_back();
+    std::vector<uint32_t> &indices = polygon_mesh.mesh.face_elements.back().indices;
+    indices.reserve(corner_count * FaceIndexStride(polygon_mesh.mesh.flags));
+
+    for (PolygonFace &face : faces)
+    {
+        if (!face.valid)
+            continue;
+        uint32_t const normal = (uint32_t)polygon_mesh.normals.size();
+        uint32_t const color = (uint32_t)polygon_mesh.rgba32s.size();
+        polygon_mesh.normals.push_back(face.normal);
+        if (colored)
+            polygon_mesh.rgba32s.push_back(face.has_color ? face.color : SC::Store::RGBA32(255, 255, 255, 255));
+        for (SC::Store::Point const &corner : face.triangles)
+        {
+            indices.push_back((uint32_t)polygon_mesh.points.size());
+            polygon_mesh.points.push_back(corner);
+            indices.push_back(normal);
+            if (colored)
+                indices.push_back(color);
+        }
+        std::vector<SC::Store::Point>().swap(face.triangles);
+    }
+    polygon_mesh.Bind();
+    return true;
+}
@@ -0,0 +1,169 @@
+#include "sc_update_progress.h"
+#include "sc_update_trace.h"
+
+#include <chrono>
+#include <mutex>
+#include <stdarg.h>
+#include <stdio.h>
+
+namespace
+{
+    std::chrono::steady_clock::time_point const process_start = std::chrono::steady_clock::now();
+    std::mutex output_mutex;
+    ProgressListener *listener = nullptr;
+    bool output_enabled = true;
+
+    void
+    AppendJsonString(std::string &out, const char *text)
+    {
+        out += '"';
+        for (const char *c = text; *c; ++c)
+        {
+            switch (*c)
+            {
+            case '"':
+                out += "\\\"";
+                break;
+            case '\\':
+                out += "\\\\";
+                break;
+            case '\n':
+                out += "\\n";
+                break;
+            case '\r':
+                out += "\\r";
+                break;
+            case '\t':
+                out += "\\t";
+                break;
+            default:
+                if ((unsigned char)*c < 0x20)
+                {
+                    char escaped[8];
+                    snprintf(escaped, sizeof(escaped), "\\u%04x", (unsigned char)*c);
+                    out += escaped;
+                }
+                else
+                {
+                    out += *c;
+                }
+            }
+        }
+        out += '"';
+    }
+
+    void
+    WriteLine(std::string const &line)
+    {
+        if (!output_enabled)
+            return;
+        std::lock_guard<std::mutex> lock(output_mutex);
+        fputs(line.c_str(), stdout);
+        fputc('\n', stdout);
+        fflush(stdout);
+    }
+
+    std::string
+    EventPrefix(const char *event, double t_ms)
+    {
+        char buffer[64];
+        snprintf(buffer, sizeof(buffer), "{\"event\":\"%s\",\"t_ms\":%.3f", event, t_ms);
+        return buffer;
+    }
+}
+
+double
+ProgressNowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now() - process_start).count();
+}
+
+void
+SetProgressListener(ProgressListener *progress_listener)
+{
+    listener = progress_listener;
+}
+
+void
+SetProgressOutputEnabled(bool enabled)
+{
+    output_enabled = enabled;
+}
+
+void
+ProgressLog(const char *level, const char *format, ...)
+{
+    char stack_buffer[512];
+    std::string message;
+
+    va_list args;
+    va_start(args, format);
+    va_list args_copy;
+    va_copy(args_copy, args);
+    int length = vsnprintf(stack_buffer, sizeof(stack_buffer), format, args);
+    if (length >= (int)sizeof(stack_buffer))
+    {
+        message.resize(length + 1);
+        vsnprintf(&message[0], message.size(), format, args_copy);
+        message.resize(length);
+    }
+    else if (length > 0)
+    {
+        message.assign(stack_buffer, length);
+    }
+    va_end(args_copy);
+    va_end(args);
+
+    // Messages are often printf lines carried over from before the NDJSON output; drop the
+    // trailing newline rather than escaping it.
+    while (!message.empty() && (message.back() == '\n' || message.back() == ' '))
+        message.pop_back();
+
+    std::string line = EventPrefix("log", ProgressNowMs());
+    line += ",\"level\":";
+    AppendJsonString(line, level);
+    line += ",\"message\":";
+    AppendJsonString(line, message.c_str());
+    line += '}';
+    WriteLine(line);
+}
+
+ProgressPhase::ProgressPhase(std::string name)
+    : _name(std::move(name)), _start_ms(ProgressNowMs()), _bytes(0), _count(0), _ended(false)
+{
+    std::string line = EventPrefix("begin", _start_ms);
+    line += ",\"phase\":";
+    AppendJsonString(line, _name.c_str());
+    line += '}';
+    WriteLine(line);
+}
+
+ProgressPhase::~ProgressPhase()
+{
+    End();
+}
+
+void
+ProgressPhase::End()
+{
+    if (_ended)
+        return;
+    _ended = true;
+
+    double end_ms = ProgressNowMs();
+    double duration_ms = end_ms - _start_ms;
+
+    std::string line = EventPrefix("end", end_ms);
+    line += ",\"phase\":";
+    AppendJsonString(line, _name.c_str());
+    char buffer[128];
+    snprintf(buffer, sizeof(buffer), ",\"duration_ms\":%.3f,\"bytes\":%llu,\"count\":%llu}",
+             duration_ms, (unsigned long long)_bytes, (unsigned long long)_count);
+    line += buffer;
+    WriteLine(line);
+
+    if (listener)
+        listener->PhaseEnded(_name.c_str(), duration_ms, _bytes, _count);
+    if (TraceEnabled())
+        TraceRecord(TraceName(_name), _start_ms, end_ms);
+}
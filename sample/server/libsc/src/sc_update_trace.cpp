@@ -0,0 +1,190 @@
+#include "sc_update_trace.h"
+#include "sc_update_progress.h"
+
+#include <atomic>
+#include <mutex>
+#include <set>
+#include <stdio.h>
+#include <stdlib.h>
+#include <vector>
+
+namespace
+{
+    const uint64_t TraceRingCapacity = 1 << 16;
+
+    struct TraceEvent
+    {
+        const char *name;
+        double begin_ms;
+        double end_ms;
+        int64_t arg;
+    };
+
+    // Written only by its owning thread. 'written' is published with release semantics so the
+    // final dump sees every completed event.
+    struct TraceRing
+    {
+        TraceEvent events[TraceRingCapacity];
+        std::atomic<uint64_t> written;
+        uint32_t thread_index;
+        TraceRing *next;
+    };
+
+    std::atomic<TraceRing *> rings(nullptr);
+    std::atomic<uint32_t> ring_count(0);
+
+    // Rings of threads that have exited. ParallelFor starts fresh threads on every call; reusing
+    // their rings bounds the ring count by the peak number of threads instead of the threads ever
+    // started. A reused ring keeps its earlier events and its tid, which never overlap in time.
+    std::mutex free_rings_mutex;
+    std::vector<TraceRing *> free_rings;
+
+    struct ThreadRingOwner
+    {
+        TraceRing *ring = nullptr;
+
+        ~ThreadRingOwner()
+        {
+            if (ring)
+            {
+                std::lock_guard<std::mutex> lock(free_rings_mutex);
+                free_rings.push_back(ring);
+            }
+        }
+    };
+
+    const char *
+    TracePath()
+    {
+        static const char *path = getenv("SC_UPDATE_TRACE");
+        return path;
+    }
+
+    TraceRing *
+    ThreadRing()
+    {
+        static thread_local ThreadRingOwner owner;
+        TraceRing *&ring = owner.ring;
+        if (!ring)
+        {
+            {
+                std::lock_guard<std::mutex> lock(free_rings_mutex);
+                if (!free_rings.empty())
+                {
+                    ring = free_rings.back();
+                    free_rings.pop_back();
+                    return ring;
+                }
+            }
+            ring = new TraceRing();
+            ring->written.store(0, std::memory_order_relaxed);
+            ring->thread_index = ring_count.fetch_add(1);
+            ring->next = rings.load(std::memory_order_relaxed);
+            while (!rings.compare_exchange_weak(ring->next, ring, std::memory_order_release, std::memory_order_relaxed))
+            {
+            }
+        }
+        return ring;
+    }
+
+    void
+    WriteJsonString(FILE *file, const char *text)
+    {
+        fputc('"', file);
+        for (const char *c = text; *c; ++c)
+        {
+            if (*c == '"' || *c == '\\')
+                fputc('\\', file);
+            if ((unsigned char)*c >= 0x20)
+                fputc(*c, file);
+        }
+        fputc('"', file);
+    }
+}
+
+bool
+TraceEnabled()
+{
+    static bool const enabled = TracePath() && *TracePath();
+    return enabled;
+}
+
+const char *
+TraceName(std::string const &name)
+{
+    static std::mutex names_mutex;
+    static std::set<std::string> names;
+    std::lock_guard<std::mutex> lock(names_mutex);
+    return names.insert(name).first->c_str();
+}
+
+void
+TraceRecord(const char *name, double begin_ms, double end_ms, int64_t arg)
+{
+    if (!TraceEnabled())
+        return;
+    TraceRing *ring = ThreadRing();
+    uint64_t index = ring->written.load(std::memory_order_relaxed);
+    TraceEvent &event = ring->events[index % TraceRingCapacity];
+    event.name = name;
+    event.begin_ms = begin_ms;
+    event.end_ms = end_ms;
+    event.arg = arg;
+    ring->written.store(index + 1, std::memory_order_release);
+}
+
+bool
+TraceWriteFile()
+{
+    if (!TraceEnabled())
+        return false;
+
+    FILE *file = fopen(TracePath(), "w");
+    if (!file)
+    {
+        ProgressLog("error", "Could not write trace file %s", TracePath());
+        return false;
+    }
+
+    uint64_t event_count = 0;
+    uint64_t dropped_count = 0;
+    fputs("{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n", file);
+    bool first = true;
+    for (TraceRing *ring = rings.load(std::memory_order_acquire); ring; ring = ring->next)
+    {
+        uint64_t written = ring->written.load(std::memory_order_acquire);
+        uint64_t begin = written > TraceRingCapacity ? written - TraceRingCapacity : 0;
+        dropped_count += begin;
+        for (uint64_t i = begin; i < written; ++i)
+        {
+            TraceEvent const &event = ring->events[i % TraceRingCapacity];
+            fputs(first ? "{\"name\":" : ",\n{\"name\":", file);
+            first = false;
+            WriteJsonString(file, event.name);
+            // Chrome trace timestamps are in microseconds.
+            fprintf(file, ",\"ph\":\"X\",\"pid\":1,\"tid\":%u,\"ts\":%.3f,\"dur\":%.3f",
+                    ring->thread_index, event.begin_ms * 1000.0, (event.end_ms - event.begin_ms) * 1000.0);
+            if (event.arg >= 0)
+                fprintf(file, ",\"args\":{\"id\":%lld}", (long long)event.arg);
+            fputc('}', file);
+            ++event_count;
+        }
+    }
+    fputs("\n]}\n", file);
+    fclose(file);
+
+    ProgressLog("info", "Wrote %llu trace spans to %s (%llu dropped)", (unsigned long long)event_count,
+                TracePath(), (unsigned long long)dropped_count);
+    return true;
+}
+
+TraceScope::TraceScope(const char *name, int64_t arg)
+    : _name(name), _arg(arg), _begin_ms(TraceEnabled() ? ProgressNowMs() : 0.0)
+{
+}
+
+TraceScope::~TraceScope()
+{
+    if (TraceEnabled())
+        TraceRecord(_name, _begin_ms, ProgressNowMs(), _arg);
+}
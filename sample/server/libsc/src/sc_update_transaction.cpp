@@ -0,0 +1,133 @@
+#include "sc_update_transaction.h"
+
+#include <errno.h>
+#include <stdio.h>
+#include <string.h>
+#include <unistd.h>
+
+ChangeTransaction::~ChangeTransaction()
+{
+    if (!_finished)
+        Abort();
+}
+
+std::string
+ChangeTransaction::Stage(std::string const &published_path)
+{
+    size_t const slash = published_path.find_last_of('/');
+    size_t dot = published_path.find_last_of('.');
+    if (dot == std::string::npos || (slash != std::string::npos && dot < slash))
+        dot = published_path.size();
+    std::string staged = published_path.substr(0, dot) + ".staged" + published_path.substr(dot);
+    _staged.push_back(std::make_pair(staged, published_path));
+    return staged;
+}
+
+void
+ChangeTransaction::Record(char const *operation, int64_t node_id, bool succeeded, std::string const &detail)
+{
+    Entry entry;
+    entry.operation = _strings.Intern(operation, strlen(operation));
+    entry.node_id = node_id;
+    entry.succeeded = succeeded;
+    entry.detail = succeeded || detail.empty() ? nullptr : _strings.Intern(detail);
+    _journal.push_back(entry);
+    _failures += succeeded ? 0 : 1;
+}
+
+std::vector<std::string>
+ChangeTransaction::FailureSummary(size_t limit) const
+{
+    std::vector<std::string> summary;
+    for (Entry const &entry : _journal)
+    {
+        if (entry.succeeded)
+            continue;
+        if (summary.size() == limit)
+            break;
+        std::string line = entry.operation;
+        if (entry.node_id != -1)
+            line += " " + std::to_string(entry.node_id);
+        if (entry.detail != nullptr)
+            line += std::string(": ") + entry.detail;
+        summary.push_back(line);
+    }
+    return summary;
+}
+
+bool
+ChangeTransaction::Commit(std::string &error)
+{
+    // Published files are only replaced once every staged file is complete.
+    for (auto const &staged : _staged)
+    {
+        FILE *file = fopen(staged.first.c_str(), "rb");
+        if (file == nullptr)
+        {
+            error = "staged output " + staged.first + " is missing";
+            Abort();
+            return false;
+        }
+        fclose(file);
+    }
+
+    // A hard link keeps every replaced file, so a failed rename can put the earlier ones back
+    // without the published path ever going missing.
+    std::vector<bool> replaced(_staged.size(), false);
+    for (size_t i = 0; i < _staged.size(); ++i)
+    {
+        std::string const backup = _staged[i].second + ".replaced";
+        remove(backup.c_str());
+        if (link(_staged[i].second.c_str(), backup.c_str()) == 0)
+            replaced[i] = true;
+        else if (errno != ENOENT)
+        {
+            error = "cannot keep a copy of " + _staged[i].second;
+            RemoveBackups(replaced);
+            Abort();
+            return false;
+        }
+    }
+
+    for (size_t i = 0; i < _staged.size(); ++i)
+    {
+        if (rename(_staged[i].first.c_str(), _staged[i].second.c_str()) == 0)
+            continue;
+        error = "cannot publish " + _staged[i].second;
+        for (size_t j = 0; j < i; ++j)
+        {
+            std::string const &published = _staged[j].second;
+            if (replaced[j])
+                rename((published + ".replaced").c_str(), published.c_str());
+            else
+                remove(published.c_str());
+            replaced[j] = false;
+        }
+        RemoveBackups(replaced);
+        Abort();
+        return false;
+    }
+    RemoveBackups(replaced);
+    _staged.clear();
+    _finished = true;
+    return true;
+}
+
+void
+ChangeTransaction::RemoveBackups(std::vector<bool> const &replaced) const
+{
+    for (size_t i = 0; i < replaced.size(); ++i)
+    {
+        if (replaced[i])
+            remove((_staged[i].second + ".replaced").c_str());
+    }
+}
+
+void
+ChangeTransaction::Abort()
+{
+    for (auto const &staged : _staged)
+        remove(staged.first.c_str());
+    _staged.clear();
+    _finished = true;
+}
@@ -0,0 +1,101 @@
+#include "sc_update_transform.h"
+
+#include <string.h>
+
+namespace
+{
+    MatrixBits
+    BitsOf(SC::Store::Matrix3d const &matrix)
+    {
+        MatrixBits bits;
+        for (int i = 0; i < 12; ++i)
+        {
+            float const value = matrix.m[i] == 0.0f ? 0.0f : matrix.m[i];
+            memcpy(&bits.words[i], &value, sizeof(value));
+        }
+        return bits;
+    }
+}
+
+bool
+ParseLocalTransform(JsonValue const &value, SC::Store::Matrix3d &matrix, std::string &error)
+{
+    float values[16];
+    int count = 0;
+    if (value.getTag() == JSON_ARRAY)
+    {
+        for (auto item : value)
+        {
+            if (count == 16 || item->value.getTag() != JSON_NUMBER)
+            {
+                count = -1;
+                break;
+            }
+            values[count++] = (float)item->value.toNumber();
+        }
+    }
+
+    if (count == 12)
+    {
+        memcpy(matrix.m, values, sizeof(matrix.m));
+        return true;
+    }
+    if (count == 16)
+    {
+        // Columns of the 4x4 are the x, y, z axes and the translation; Matrix3d stores them in that order.
+        if (values[3] != 0.0f || values[7] != 0.0f || values[11] != 0.0f || values[15] != 1.0f)
+        {
+            error = "localTransform must be affine";
+            return false;
+        }
+        for (int column = 0; column < 4; ++column)
+            memcpy(&matrix.m[column * 3], &values[column * 4], 3 * sizeof(float));
+        return true;
+    }
+    error = "localTransform must be an array of 16 (or 12) numbers";
+    return false;
+}
+
+bool
+IsIdentityTransform(SC::Store::Matrix3d const &matrix)
+{
+    SC::Store::Matrix3d identity;
+    identity.SetIdentity();
+    return BitsOf(matrix) == BitsOf(identity);
+}
+
+bool
+MatrixBits::operator==(MatrixBits const &that) const
+{
+    return memcmp(words, that.words, sizeof(words)) == 0;
+}
+
+size_t
+MatrixBitsHasher::operator()(MatrixBits const &bits) const
+{
+    uint64_t h = 0xcbf29ce484222325ull;
+    for (uint32_t word : bits.words)
+        h = (h ^ word) * 0x100000001b3ull;
+    return (size_t)(h ^ (h >> 32));
+}
+
+MatrixKeyCache::MatrixKeyCache(SC::Store::Model &model)
+    : _model(model), _hits(0)
+{
+}
+
+SC::Store::MatrixKey
+MatrixKeyCache::FindOrInsert(SC::Store::Matrix3d const &matrix)
+{
+    MatrixBits const bits = BitsOf(matrix);
+    auto found = _matrix_keys.find(bits);
+    if (found != _matrix_keys.end())
+    {
+        ++_hits;
+        return found->second;
+    }
+
+    SC::Store::MatrixKey const matrix_key = _model.FindOrInsert(matrix);
+    _matrix_keys[bits] = matrix_key;
+    return matrix_key;
+}
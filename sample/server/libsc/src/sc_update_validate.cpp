@@ -0,0 +1,433 @@
+#include "sc_update_validate.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/stat.h>
+#include <unordered_map>
+
+#include "sc_update_attribute_table.h"
+#include "sc_update_attribute_value.h"
+#include "sc_update_parallel.h"
+#include "sc_update_pointcloud.h"
+#include "sc_update_transform.h"
+
+namespace
+{
+    bool
+    IsSpace(char c)
+    {
+        return c == ' ' || c == '\t' || c == '\r' || c == '\n';
+    }
+
+    struct Context
+    {
+        NodeIndex const *nodes;
+        std::string attribute_directory;
+        // Client id -> position of the meshes / pointClouds entry that creates it.
+        std::unordered_map<int, size_t> declared;
+    };
+
+    struct Job;
+
+    struct Category
+    {
+        char const *name;
+        void (*check)(Context const &, Job &);
+        bool single; // One object instead of an array of entries.
+    };
+
+    struct Job
+    {
+        Category const *category;
+        size_t entry;
+        size_t sequence; // Position in the whole change set.
+        JsonValue const *value;
+        std::vector<std::string> messages;
+    };
+
+    JsonNode const *
+    Member(JsonValue const &object, char const *key)
+    {
+        for (auto item : object)
+        {
+            if (strcmp(item->key, key) == 0)
+                return item;
+        }
+        return nullptr;
+    }
+
+    bool
+    ReadInt(JsonValue const &value, int &out)
+    {
+        if (value.getTag() != JSON_NUMBER)
+            return false;
+        double const number = value.toNumber();
+        out = (int)number;
+        return (double)out == number;
+    }
+
+    bool
+    Exists(Context const &context, int node_id)
+    {
+        return node_id >= 0 && context.nodes->Contains((SC::Store::NodeId)node_id);
+    }
+
+    // An existing node, or one created by an entry applied before sequence.
+    bool
+    Resolves(Context const &context, int node_id, size_t sequence)
+    {
+        if (Exists(context, node_id))
+            return true;
+        auto declared = context.declared.find(node_id);
+        return declared != context.declared.end() && declared->second < sequence;
+    }
+
+    std::string
+    NodeMessage(char const *what, int node_id, char const *problem)
+    {
+        return std::string(what) + " " + std::to_string(node_id) + " " + problem;
+    }
+
+    void
+    CheckAttributes(Context const &context, Job &job)
+    {
+        JsonNode const *node_id = job.value->getTag() == JSON_OBJECT ? job.value->toNode() : nullptr;
+        int id = 0;
+        if (node_id == nullptr || strcmp(node_id->key, "nodeId") != 0 || !ReadInt(node_id->value, id))
+        {
+            job.messages.push_back("expected an object starting with nodeId");
+            return;
+        }
+        if (!Exists(context, id))
+            job.messages.push_back(NodeMessage("node", id, "does not exist"));
+        if (node_id->next == nullptr)
+            job.messages.push_back("no attributes");
+        for (JsonNode const *field = node_id->next; field != nullptr; field = field->next)
+        {
+            TypedAttributeValue value;
+            if (!ReadTypedAttributeValue(field->value, value))
+                job.messages.push_back(std::string("attribute ") + field->key + " has no scalar value");
+        }
+    }
+
+    void
+    CheckNodeNames(Context const &context, Job &job)
+    {
+        JsonNode const *node_id = job.value->getTag() == JSON_OBJECT ? job.value->toNode() : nullptr;
+        int id = 0;
+        if (node_id == nullptr || strcmp(node_id->key, "nodeId") != 0 || !ReadInt(node_id->value, id) || node_id->next == nullptr ||
+            strcmp(node_id->next->key, "nodeName") != 0 || node_id->next->value.getTag() != JSON_STRING)
+        {
+            job.messages.push_back("expected {\"nodeId\":id,\"nodeName\":\"name\"}");
+            return;
+        }
+        if (!Exists(context, id))
+            job.messages.push_back(NodeMessage("node", id, "does not exist"));
+    }
+
+    void
+    CheckColors(Context const &, Job &job)
+    {
+        JsonNode const *first = job.value->getTag() == JSON_OBJECT ? job.value->toNode() : nullptr;
+        if (first != nullptr && strcmp(first->key, "nodeIds") == 0)
+            return; // Not applied.
+        int id = 0;
+        JsonNode const *color = first != nullptr ? first->next : nullptr;
+        JsonNode const *instance = color != nullptr ? color->next : nullptr;
+        if (first == nullptr || strcmp(first->key, "nodeId") != 0 || !ReadInt(first->value, id) || color == nullptr ||
+            strcmp(color->key, "color") != 0 || color->value.getTag() != JSON_OBJECT || instance == nullptr ||
+            strcmp(instance->key, "scInstanceId") != 0 || instance->value.getTag() != JSON_NUMBER)
+        {
+            job.messages.push_back("expected {\"nodeId\":id,\"color\":{\"r\":r,\"g\":g,\"b\":b},\"scInstanceId\":id}");
+            return;
+        }
+        for (auto channel : color->value)
+        {
+            if (channel->value.getTag() != JSON_NUMBER)
+                job.messages.push_back(std::string("color channel ") + channel->key + " is not a number");
+        }
+    }
+
+    void
+    CheckDefaultCamera(Context const &, Job &job)
+    {
+        if (job.value->getTag() != JSON_OBJECT)
+        {
+            job.messages.push_back("expected an object");
+            return;
+        }
+        for (auto setting : *job.value)
+        {
+            if (strcmp(setting->key, "position") == 0 || strcmp(setting->key, "target") == 0 || strcmp(setting->key, "up") == 0)
+            {
+                bool valid = setting->value.getTag() == JSON_OBJECT;
+                for (char const *axis : {"x", "y", "z"})
+                {
+                    JsonNode const *coordinate = valid ? Member(setting->value, axis) : nullptr;
+                    valid = valid && (coordinate == nullptr || coordinate->value.getTag() == JSON_NUMBER);
+                }
+                if (!valid)
+                    job.messages.push_back(std::string(setting->key) + " must be an object of numeric x, y and z");
+            }
+            else if ((strcmp(setting->key, "width") == 0 || strcmp(setting->key, "height") == 0 || strcmp(setting->key, "projection") == 0) &&
+                     setting->value.getTag() != JSON_NUMBER)
+            {
+                job.messages.push_back(std::string(setting->key) + " must be a number");
+            }
+        }
+    }
+
+    void
+    CheckLocalTransform(JsonValue const &entry, Job &job)
+    {
+        JsonNode const *local_transform = Member(entry, "localTransform");
+        if (local_transform == nullptr || local_transform->value.getTag() == JSON_NULL)
+            return;
+        SC::Store::Matrix3d matrix;
+        std::string error;
+        if (!ParseLocalTransform(local_transform->value, matrix, error))
+            job.messages.push_back("invalid localTransform: " + error);
+    }
+
+    // meshes and pointClouds
+    void
+    CheckAuthoredNode(Context const &context, Job &job)
+    {
+        if (job.value->getTag() != JSON_OBJECT)
+        {
+            job.messages.push_back("expected an object");
+            return;
+        }
+        JsonNode const *node_id = Member(*job.value, "nodeId");
+        JsonNode const *parent_node_id = Member(*job.value, "parentNodeId");
+        int id = 0, parent = 0;
+        if (node_id == nullptr || !ReadInt(node_id->value, id))
+            job.messages.push_back("missing nodeId");
+        if (parent_node_id == nullptr || !ReadInt(parent_node_id->value, parent))
+            job.messages.push_back("missing parentNodeId");
+        else if (!Resolves(context, parent, job.sequence))
+            job.messages.push_back(NodeMessage("parent node", parent, "does not exist or is created later"));
+        CheckLocalTransform(*job.value, job);
+    }
+
+    void
+    CheckPointCloud(Context const &context, Job &job)
+    {
+        CheckAuthoredNode(context, job);
+        std::string error;
+        if (!CheckPointCloudPositions(*job.value, error))
+            job.messages.push_back(error);
+    }
+
+    void
+    CheckTransforms(Context const &context, Job &job)
+    {
+        JsonNode const *node_id = job.value->getTag() == JSON_OBJECT ? Member(*job.value, "nodeId") : nullptr;
+        int id = 0;
+        if (node_id == nullptr || !ReadInt(node_id->value, id) || Member(*job.value, "localTransform") == nullptr)
+        {
+            job.messages.push_back("expected nodeId and localTransform");
+            return;
+        }
+        if (!Resolves(context, id, job.sequence))
+            job.messages.push_back(NodeMessage("node", id, "does not exist or is created later"));
+        CheckLocalTransform(*job.value, job);
+    }
+
+    void
+    CheckMoves(Context const &context, Job &job)
+    {
+        JsonNode const *node_id = job.value->getTag() == JSON_OBJECT ? Member(*job.value, "nodeId") : nullptr;
+        JsonNode const *parent_node_id = job.value->getTag() == JSON_OBJECT ? Member(*job.value, "parentNodeId") : nullptr;
+        int id = 0, parent = 0;
+        if (node_id == nullptr || parent_node_id == nullptr || !ReadInt(node_id->value, id) || !ReadInt(parent_node_id->value, parent))
+        {
+            job.messages.push_back("expected nodeId and parentNodeId");
+            return;
+        }
+        for (int occurrence : {id, parent})
+        {
+            if (occurrence < 0 || !context.nodes->IsOccurrence((SC::Store::NodeId)occurrence))
+                job.messages.push_back(NodeMessage("node", occurrence, "is not an existing product occurrence"));
+        }
+        if (id == parent)
+            job.messages.push_back(NodeMessage("node", id, "cannot be its own parent"));
+        JsonNode const *keep = Member(*job.value, "keepWorldTransform");
+        if (keep != nullptr && keep->value.getTag() != JSON_TRUE && keep->value.getTag() != JSON_FALSE)
+            job.messages.push_back("keepWorldTransform must be true or false");
+    }
+
+    void
+    CheckAttributeTables(Context const &context, Job &job)
+    {
+        JsonNode const *file = job.value->getTag() == JSON_OBJECT ? Member(*job.value, "file") : nullptr;
+        if (file == nullptr || file->value.getTag() != JSON_STRING)
+        {
+            job.messages.push_back("expected a file name");
+            return;
+        }
+        std::string path, error;
+        struct stat file_stat;
+        if (!ResolveAttributeTablePath(context.attribute_directory, file->value.toString(), path, error))
+            job.messages.push_back(error);
+        else if (stat(path.c_str(), &file_stat) != 0 || !S_ISREG(file_stat.st_mode))
+            job.messages.push_back(std::string("attribute table ") + file->value.toString() + " not found");
+        JsonNode const *delimiter = Member(*job.value, "delimiter");
+        if (delimiter != nullptr && (delimiter->value.getTag() != JSON_STRING || strlen(delimiter->value.toString()) != 1))
+            job.messages.push_back("delimiter must be a single character");
+    }
+
+    Category const categories[] = {
+        {"attributes", CheckAttributes, false},
+        {"attributeTables", CheckAttributeTables, false},
+        {"nodeNames", CheckNodeNames, false},
+        {"colors", CheckColors, false},
+        {"defaultCamera", CheckDefaultCamera, true},
+        {"meshes", CheckAuthoredNode, false},
+        {"pointClouds", CheckPointCloud, false},
+        {"moves", CheckMoves, false},
+        {"transforms", CheckTransforms, false},
+    };
+}
+
+bool
+IsAssemblyNodeElement(char const *name, size_t length)
+{
+    for (char const *node : {"ProductOccurence", "PartDefinition", "Body", "BodyInstance"})
+    {
+        if (strlen(node) == length && memcmp(name, node, length) == 0)
+            return true;
+    }
+    return false;
+}
+
+bool
+NodeIndex::Load(std::string const &xml_path, std::string &error)
+{
+    _nodes.clear();
+    _occurrences.clear();
+    std::ifstream in(xml_path, std::ios::binary);
+    if (!in)
+    {
+        error = "cannot read " + xml_path;
+        return false;
+    }
+    std::ostringstream buffer;
+    buffer << in.rdbuf();
+    std::string const text = buffer.str();
+
+    static char const occurrence_tag[] = "ProductOccurence";
+    size_t const occurrence_length = sizeof(occurrence_tag) - 1;
+    for (size_t position = text.find('<'); position != std::string::npos; position = text.find('<', position))
+    {
+        ++position;
+        if (position >= text.size() || text[position] == '/' || text[position] == '?' || text[position] == '!')
+            continue;
+        size_t cursor = position;
+        while (cursor < text.size() && !IsSpace(text[cursor]) && text[cursor] != '>' && text[cursor] != '/')
+            ++cursor;
+        bool const is_occurrence = cursor - position == occurrence_length && text.compare(position, occurrence_length, occurrence_tag) == 0;
+        bool const is_node = IsAssemblyNodeElement(text.c_str() + position, cursor - position);
+        for (;;)
+        {
+            while (cursor < text.size() && IsSpace(text[cursor]))
+                ++cursor;
+            if (cursor >= text.size() || text[cursor] == '>' || text[cursor] == '/')
+                break;
+            size_t const equals = text.find('=', cursor);
+            if (equals == std::string::npos || equals + 1 >= text.size() || (text[equals + 1] != '"' && text[equals + 1] != '\''))
+            {
+                error = "malformed attribute in " + xml_path;
+                return false;
+            }
+            size_t const value_end = text.find(text[equals + 1], equals + 2);
+            if (value_end == std::string::npos)
+            {
+                error = "unterminated attribute in " + xml_path;
+                return false;
+            }
+            if (is_node && equals - cursor == 2 && text.compare(cursor, 2, "Id") == 0)
+            {
+                SC::Store::NodeId const id = (SC::Store::NodeId)strtoul(text.c_str() + equals + 2, nullptr, 10);
+                _nodes.insert(id);
+                if (is_occurrence)
+                    _occurrences.insert(id);
+            }
+            cursor = value_end + 1;
+        }
+        position = cursor;
+    }
+    return true;
+}
+
+bool
+ValidateChangeSet(JsonValue const &change_set, NodeIndex const &nodes, std::string const &attribute_directory,
+                  std::vector<std::string> &errors)
+{
+    errors.clear();
+    if (change_set.getTag() != JSON_OBJECT)
+    {
+        errors.push_back("the change set must be a JSON object");
+        return false;
+    }
+
+    Context context;
+    context.nodes = &nodes;
+    context.attribute_directory = attribute_directory;
+
+    // Flatten every entry of every category, in the order they are applied.
+    std::vector<Job> jobs;
+    std::vector<std::string> shape_errors;
+    for (auto item : change_set)
+    {
+        Category const *category = nullptr;
+        for (Category const &candidate : categories)
+        {
+            if (strcmp(candidate.name, item->key) == 0)
+                category = &candidate;
+        }
+        if (category == nullptr)
+        {
+            shape_errors.push_back(std::string(item->key) + ": unknown change category");
+            continue;
+        }
+        if (category->single)
+        {
+            jobs.push_back(Job{category, 0, jobs.size(), &item->value, {}});
+            continue;
+        }
+        if (item->value.getTag() != JSON_ARRAY)
+        {
+            shape_errors.push_back(std::string(item->key) + ": must be an array");
+            continue;
+        }
+        size_t entry = 0;
+        for (auto element : item->value)
+            jobs.push_back(Job{category, entry++, jobs.size(), &element->value, {}});
+    }
+
+    // Nodes created by the change set; cheap, and needed by every other check.
+    for (Job &job : jobs)
+    {
+        if (job.category->check != CheckAuthoredNode || job.value->getTag() != JSON_OBJECT)
+            continue;
+        JsonNode const *node_id = Member(*job.value, "nodeId");
+        int id = 0;
+        if (node_id == nullptr || !ReadInt(node_id->value, id))
+            continue;
+        if (!context.declared.insert(std::make_pair(id, job.sequence)).second)
+            job.messages.push_back(NodeMessage("node", id, "is created twice"));
+    }
+
+    ParallelFor(jobs.size(), [&](size_t i) { jobs[i].category->check(context, jobs[i]); });
+
+    errors.swap(shape_errors);
+    for (Job const &job : jobs)
+    {
+        for (std::string const &message : job.messages)
+            errors.push_back(std::string(job.category->name) + "[" + std::to_string(job.entry) + "]: " + message);
+    }
+    return errors.empty();
+}
@@ -0,0 +1,233 @@
+#include "sc_update_vcache.h"
+#include "sc_update_weld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <unordered_map>
+
+namespace
+{
+    const int OptimizerCacheSize = 32;
+
+    // Forsyth's scoring: the three most recent vertices score a flat 0.75 (the triangle that used them
+    // was just emitted), older ones decay towards the cache end; vertices with few triangles left get
+    // a boost so they are finished before they fall out of the cache.
+    struct ScoreTables
+    {
+        float cache[OptimizerCacheSize];
+        float valence[64];
+
+        ScoreTables()
+        {
+            for (int position = 0; position < OptimizerCacheSize; ++position)
+            {
+                cache[position] = position < 3 ? 0.75f
+                                               : std::pow(1.0f - (float)(position - 3) / (OptimizerCacheSize - 3), 1.5f);
+            }
+            for (int remaining = 0; remaining < 64; ++remaining)
+                valence[remaining] = remaining == 0 ? 0.0f : 2.0f / std::sqrt((float)remaining);
+        }
+    };
+
+    ScoreTables const score_tables;
+
+    float
+    VertexScore(int cache_position, uint32_t remaining)
+    {
+        if (remaining == 0)
+            return -1.0f;
+        float score = cache_position < 0 ? 0.0f : score_tables.cache[cache_position];
+        return score + (remaining < 64 ? score_tables.valence[remaining] : 2.0f / std::sqrt((float)remaining));
+    }
+
+    struct IndexGroupHasher
+    {
+        size_t
+        operator()(std::pair<uint64_t, uint64_t> const &key) const
+        {
+            uint64_t h = key.first * 0x9e3779b97f4a7c15ull ^ key.second * 0xc2b2ae3d27d4eb4full;
+            return (size_t)(h ^ (h >> 32));
+        }
+    };
+
+    // Maps every corner of a face element to a vertex id, one per unique index group.
+    uint32_t
+    AssignVertexIds(std::vector<uint32_t> const &indices, uint32_t stride, std::vector<uint32_t> &vertex_ids)
+    {
+        size_t const corner_count = indices.size() / stride;
+        std::unordered_map<std::pair<uint64_t, uint64_t>, uint32_t, IndexGroupHasher> ids;
+        ids.reserve(corner_count);
+        vertex_ids.resize(corner_count);
+        for (size_t corner = 0; corner < corner_count; ++corner)
+        {
+            uint32_t group[4] = {0, 0, 0, 0};
+            std::copy(indices.begin() + corner * stride, indices.begin() + (corner + 1) * stride, group);
+            std::pair<uint64_t, uint64_t> key((uint64_t)group[0] | (uint64_t)group[1] << 32,
+                                              (uint64_t)group[2] | (uint64_t)group[3] << 32);
+            vertex_ids[corner] = ids.insert(std::make_pair(key, (uint32_t)ids.size())).first->second;
+        }
+        return (uint32_t)ids.size();
+    }
+
+    uint32_t
+    SimulateFifoMisses(std::vector<uint32_t> const &vertex_ids, uint32_t vertex_count)
+    {
+        // A vertex is in the FIFO while fewer than VertexCacheSimulatedSize misses happened since it was loaded.
+        std::vector<uint64_t> loaded_at(vertex_count, 0);
+        uint64_t misses = 0;
+        for (uint32_t vertex : vertex_ids)
+        {
+            if (loaded_at[vertex] == 0 || misses - loaded_at[vertex] >= VertexCacheSimulatedSize)
+                loaded_at[vertex] = ++misses;
+        }
+        return (uint32_t)misses;
+    }
+
+    // Computes the emission order of the triangles of a face element.
+    void
+    ForsythOrder(std::vector<uint32_t> const &vertex_ids, uint32_t vertex_count, std::vector<uint32_t> &order)
+    {
+        uint32_t const triangle_count = (uint32_t)(vertex_ids.size() / 3);
+        order.clear();
+        order.reserve(triangle_count);
+
+        // Triangles of each vertex; the first remaining[v] entries are the ones not emitted yet.
+        std::vector<uint32_t> remaining(vertex_count, 0);
+        for (uint32_t vertex : vertex_ids)
+            ++remaining[vertex];
+        std::vector<uint32_t> offsets(vertex_count + 1, 0);
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            offsets[v + 1] = offsets[v] + remaining[v];
+        std::vector<uint32_t> vertex_triangles(vertex_ids.size());
+        {
+            std::vector<uint32_t> fill(offsets.begin(), offsets.end() - 1);
+            for (uint32_t corner = 0; corner < (uint32_t)vertex_ids.size(); ++corner)
+                vertex_triangles[fill[vertex_ids[corner]]++] = corner / 3;
+        }
+
+        std::vector<int> cache_position(vertex_count, -1);
+        std::vector<float> vertex_score(vertex_count);
+        for (uint32_t v = 0; v < vertex_count; ++v)
+            vertex_score[v] = VertexScore(-1, remaining[v]);
+
+        std::vector<bool> emitted(triangle_count, false);
+        int best = -1;
+        float best_score = -1.0f;
+        for (uint32_t t = 0; t < triangle_count; ++t)
+        {
+            float const score = vertex_score[vertex_ids[t * 3]] + vertex_score[vertex_ids[t * 3 + 1]] +
+                                vertex_score[vertex_ids[t * 3 + 2]];
+            if (score > best_score)
+                best_score = score, best = (int)t;
+        }
+
+        std::vector<uint32_t> cache, next_cache;
+        cache.reserve(OptimizerCacheSize + 3);
+        next_cache.reserve(OptimizerCacheSize + 3);
+        uint32_t cursor = 0;
+
+        while (order.size() < triangle_count)
+        {
+            if (best < 0)
+            {
+                // Dead end: nothing in the cache has triangles left, continue in input order.
+                while (emitted[cursor])
+                    ++cursor;
+                best = (int)cursor;
+            }
+
+            uint32_t const triangle = (uint32_t)best;
+            emitted[triangle] = true;
+            order.push_back(triangle);
+
+            next_cache.clear();
+            for (int c = 0; c < 3; ++c)
+            {
+                uint32_t const vertex = vertex_ids[triangle * 3 + c];
+                next_cache.push_back(vertex);
+
+                uint32_t *begin = &vertex_triangles[offsets[vertex]];
+                uint32_t *end = begin + remaining[vertex];
+                *std::find(begin, end, triangle) = *(end - 1);
+                --remaining[vertex];
+            }
+            for (uint32_t vertex : cache)
+            {
+                if (vertex != next_cache[0] && vertex != next_cache[1] && vertex != next_cache[2])
+                    next_cache.push_back(vertex);
+            }
+            for (size_t i = OptimizerCacheSize; i < next_cache.size(); ++i)
+            {
+                cache_position[next_cache[i]] = -1;
+                vertex_score[next_cache[i]] = VertexScore(-1, remaining[next_cache[i]]);
+            }
+            if (next_cache.size() > (size_t)OptimizerCacheSize)
+                next_cache.resize(OptimizerCacheSize);
+            cache.swap(next_cache);
+
+            // Rescore the cached vertices and their triangles, picking the best one for the next step.
+            for (size_t i = 0; i < cache.size(); ++i)
+            {
+                uint32_t const vertex = cache[i];
+                cache_position[vertex] = (int)i;
+                vertex_score[vertex] = VertexScore((int)i, remaining[vertex]);
+            }
+            best = -1;
+            best_score = -1.0f;
+            for (uint32_t vertex : cache)
+            {
+                for (uint32_t i = 0; i < remaining[vertex]; ++i)
+                {
+                    uint32_t const t = vertex_triangles[offsets[vertex] + i];
+                    float const score = vertex_score[vertex_ids[t * 3]] + vertex_score[vertex_ids[t * 3 + 1]] +
+                                        vertex_score[vertex_ids[t * 3 + 2]];
+                    if (score > best_score)
+                        best_score = score, best = (int)t;
+                }
+            }
+        }
+    }
+}
+
+VertexCacheStats
+OptimizeVertexCache(AuthoredMesh &authored)
+{
+    VertexCacheStats stats;
+    uint32_t const stride = FaceIndexStride(authored.mesh.flags);
+    uint64_t misses_before = 0, misses_after = 0;
+
+    std::vector<uint32_t> vertex_ids, order, reordered_ids, reordered;
+    for (SC::Store::MeshElement &element : authored.mesh.face_elements)
+    {
+        std::vector<uint32_t> &indices = element.indices;
+        uint32_t const triangle_count = (uint32_t)(indices.size() / (3 * stride));
+        if (triangle_count == 0)
+            continue;
+        indices.resize((size_t)triangle_count * 3 * stride);
+
+        uint32_t const vertex_count = AssignVertexIds(indices, stride, vertex_ids);
+        misses_before += SimulateFifoMisses(vertex_ids, vertex_count);
+        ForsythOrder(vertex_ids, vertex_count, order);
+
+        reordered.resize(indices.size());
+        reordered_ids.resize(vertex_ids.size());
+        size_t const triangle_size = 3 * stride;
+        for (uint32_t i = 0; i < triangle_count; ++i)
+        {
+            std::copy(indices.begin() + order[i] * triangle_size, indices.begin() + (order[i] + 1) * triangle_size,
+                      reordered.begin() + i * triangle_size);
+            std::copy(vertex_ids.begin() + order[i] * 3, vertex_ids.begin() + order[i] * 3 + 3, reordered_ids.begin() + i * 3);
+        }
+        indices.swap(reordered);
+        misses_after += SimulateFifoMisses(reordered_ids, vertex_count);
+        stats.triangles += triangle_count;
+    }
+
+    if (stats.triangles > 0)
+    {
+        stats.acmr_before = (double)misses_before / stats.triangles;
+        stats.acmr_after = (double)misses_after / stats.triangles;
+        CompactAuthoredMesh(authored);
+    }
+    return stats;
+}
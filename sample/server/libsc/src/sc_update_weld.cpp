@@ -0,0 +1,355 @@
+#include "sc_update_weld.h"
+
+#include <algorithm>
+#include <cmath>
+#include <string.h>
+
+namespace
+{
+    const uint32_t EmptySlot = 0xffffffffu;
+
+    inline uint64_t
+    FinalizeHash(uint64_t h)
+    {
+        h ^= h >> 33;
+        h *= 0xff51afd7ed558ccdull;
+        h ^= h >> 33;
+        h *= 0xc4ceb9fe1a85ec53ull;
+        h ^= h >> 33;
+        return h;
+    }
+
+    // Each lane is multiplied by its own odd constant and summed, so the compiler can evaluate the
+    // lanes of a row independently before the final mix.
+    template <int Width>
+    inline uint64_t
+    HashRow(int32_t const *key)
+    {
+        static const uint64_t lane_multipliers[4] = {0x9e3779b97f4a7c15ull, 0xc2b2ae3d27d4eb4full,
+                                                     0x165667b19e3779f9ull, 0x27d4eb2f165667c5ull};
+        uint64_t h = 0;
+        for (int i = 0; i < Width; ++i)
+            h += (uint64_t)(uint32_t)key[i] * lane_multipliers[i];
+        return FinalizeHash(h);
+    }
+
+    // Dedupes rows of Width quantized keys. remap[row] receives the unique index of each row and
+    // representatives[unique] the first row that produced it.
+    template <int Width>
+    void
+    WeldRows(std::vector<int32_t> const &keys, uint32_t row_count, std::vector<uint32_t> &remap,
+             std::vector<uint32_t> &representatives)
+    {
+        uint32_t capacity = 16;
+        while (capacity < row_count * 2)
+            capacity <<= 1;
+        uint32_t const mask = capacity - 1;
+
+        std::vector<uint32_t> table(capacity, EmptySlot);
+        remap.resize(row_count);
+        representatives.clear();
+        representatives.reserve(row_count);
+
+        for (uint32_t row = 0; row < row_count; ++row)
+        {
+            int32_t const *key = &keys[(size_t)row * Width];
+            uint32_t slot = (uint32_t)HashRow<Width>(key) & mask;
+            for (;;)
+            {
+                uint32_t const candidate = table[slot];
+                if (candidate == EmptySlot)
+                {
+                    table[slot] = (uint32_t)representatives.size();
+                    remap[row] = table[slot];
+                    representatives.push_back(row);
+                    break;
+                }
+                if (memcmp(&keys[(size_t)representatives[candidate] * Width], key, sizeof(int32_t) * Width) == 0)
+                {
+                    remap[row] = candidate;
+                    break;
+                }
+                slot = (slot + 1) & mask;
+            }
+        }
+    }
+
+    template <typename T>
+    void
+    Compact(std::vector<T> &values, std::vector<uint32_t> const &representatives)
+    {
+        std::vector<T> unique_values(representatives.size());
+        for (size_t i = 0; i < representatives.size(); ++i)
+            unique_values[i] = values[representatives[i]];
+        values.swap(unique_values);
+    }
+
+    // Remap tables for the attribute slots of one element type, in index order.
+    struct SlotRemaps
+    {
+        std::vector<uint32_t> *slots[4];
+        uint32_t stride;
+    };
+
+    SlotRemaps
+    MakeSlotRemaps(SC::Store::Mesh::Bits flags, SC::Store::Mesh::Bits normal_bit, SC::Store::Mesh::Bits uv_bit,
+                   SC::Store::Mesh::Bits rgba32_bit, std::vector<uint32_t> *point_remap,
+                   std::vector<uint32_t> *normal_remap, std::vector<uint32_t> *uv_remap,
+                   std::vector<uint32_t> *rgba32_remap)
+    {
+        SlotRemaps remaps;
+        remaps.stride = 0;
+        remaps.slots[remaps.stride++] = point_remap;
+        if (flags & normal_bit)
+            remaps.slots[remaps.stride++] = normal_remap;
+        if (flags & uv_bit)
+            remaps.slots[remaps.stride++] = uv_remap;
+        if (flags & rgba32_bit)
+            remaps.slots[remaps.stride++] = rgba32_remap;
+        return remaps;
+    }
+
+    template <typename Element>
+    void
+    RemapElements(std::vector<Element> &elements, SlotRemaps const &remaps)
+    {
+        for (Element &element : elements)
+        {
+            std::vector<uint32_t> &indices = element.indices;
+            for (size_t i = 0; i < indices.size(); i += remaps.stride)
+            {
+                for (uint32_t slot = 0; slot < remaps.stride; ++slot)
+                {
+                    std::vector<uint32_t> const *remap = remaps.slots[slot];
+                    if (remap)
+                        indices[i + slot] = (*remap)[indices[i + slot]];
+                }
+            }
+        }
+    }
+
+    // Remap tables of the four attribute arrays with the next free index of each.
+    struct FirstUseNumbering
+    {
+        std::vector<uint32_t> *tables[4];
+        uint32_t next[4];
+    };
+
+    // Gives every value referenced by the elements a new index, in order of first use.
+    template <typename Element>
+    void
+    NumberByFirstUse(std::vector<Element> const &elements, SlotRemaps const &remaps, FirstUseNumbering &numbering)
+    {
+        uint32_t *next[4];
+        for (uint32_t slot = 0; slot < remaps.stride; ++slot)
+        {
+            for (int table = 0; table < 4; ++table)
+            {
+                if (numbering.tables[table] == remaps.slots[slot])
+                    next[slot] = &numbering.next[table];
+            }
+        }
+
+        for (Element const &element : elements)
+        {
+            std::vector<uint32_t> const &indices = element.indices;
+            for (size_t i = 0; i < indices.size(); i += remaps.stride)
+            {
+                for (uint32_t slot = 0; slot < remaps.stride; ++slot)
+                {
+                    uint32_t &remapped = (*remaps.slots[slot])[indices[i + slot]];
+                    if (remapped == EmptySlot)
+                        remapped = (*next[slot])++;
+                }
+            }
+        }
+    }
+
+    // Moves every numbered value to its new index and drops the values no element references.
+    template <typename T>
+    void
+    PermuteReferenced(std::vector<T> &values, std::vector<uint32_t> const &remap, uint32_t referenced_count)
+    {
+        std::vector<T> permuted(referenced_count);
+        for (size_t i = 0; i < values.size(); ++i)
+        {
+            if (remap[i] != EmptySlot)
+                permuted[remap[i]] = values[i];
+        }
+        values.swap(permuted);
+    }
+
+    // Applies the remap tables to the face, polyline and point elements of a mesh.
+    void
+    RemapMesh(SC::Store::Mesh &mesh, std::vector<uint32_t> *points, std::vector<uint32_t> *normals,
+              std::vector<uint32_t> *uvs, std::vector<uint32_t> *rgba32s)
+    {
+        RemapElements(mesh.face_elements,
+                      MakeSlotRemaps(mesh.flags, SC::Store::Mesh::FaceNormals, SC::Store::Mesh::FaceUVs,
+                                     SC::Store::Mesh::FaceRGBA32s, points, normals, uvs, rgba32s));
+        RemapElements(mesh.polyline_elements,
+                      MakeSlotRemaps(mesh.flags, SC::Store::Mesh::LineNormals, SC::Store::Mesh::LineUVs,
+                                     SC::Store::Mesh::LineRGBA32s, points, normals, uvs, rgba32s));
+        RemapElements(mesh.point_elements,
+                      MakeSlotRemaps(mesh.flags, SC::Store::Mesh::PointNormals, SC::Store::Mesh::PointUVs,
+                                     SC::Store::Mesh::PointRGBA32s, points, normals, uvs, rgba32s));
+    }
+
+    void
+    WeldPoints(std::vector<SC::Store::Point> &points, std::vector<uint32_t> &remap)
+    {
+        uint32_t const count = (uint32_t)points.size();
+        float min_x = points[0].x, min_y = points[0].y, min_z = points[0].z;
+        float max_x = min_x, max_y = min_y, max_z = min_z;
+        for (uint32_t i = 1; i < count; ++i)
+        {
+            min_x = std::min(min_x, points[i].x), max_x = std::max(max_x, points[i].x);
+            min_y = std::min(min_y, points[i].y), max_y = std::max(max_y, points[i].y);
+            min_z = std::min(min_z, points[i].z), max_z = std::max(max_z, points[i].z);
+        }
+        float const extent = std::max(max_x - min_x, std::max(max_y - min_y, max_z - min_z));
+        float const scale = WeldPositionScale(extent);
+
+        std::vector<int32_t> keys((size_t)count * 3);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            keys[i * 3 + 0] = QuantizeWeldValue(points[i].x - min_x, scale);
+            keys[i * 3 + 1] = QuantizeWeldValue(points[i].y - min_y, scale);
+            keys[i * 3 + 2] = QuantizeWeldValue(points[i].z - min_z, scale);
+        }
+
+        std::vector<uint32_t> representatives;
+        WeldRows<3>(keys, count, remap, representatives);
+        if (representatives.size() < count)
+            Compact(points, representatives);
+    }
+
+    void
+    WeldNormals(std::vector<SC::Store::Normal> &normals, std::vector<uint32_t> &remap)
+    {
+        uint32_t const count = (uint32_t)normals.size();
+        std::vector<int32_t> keys((size_t)count * 3);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            keys[i * 3 + 0] = QuantizeWeldValue(normals[i].x, WeldNormalScale);
+            keys[i * 3 + 1] = QuantizeWeldValue(normals[i].y, WeldNormalScale);
+            keys[i * 3 + 2] = QuantizeWeldValue(normals[i].z, WeldNormalScale);
+        }
+
+        std::vector<uint32_t> representatives;
+        WeldRows<3>(keys, count, remap, representatives);
+        if (representatives.size() < count)
+            Compact(normals, representatives);
+    }
+
+    void
+    WeldUVs(std::vector<SC::Store::UV> &uvs, std::vector<uint32_t> &remap)
+    {
+        uint32_t const count = (uint32_t)uvs.size();
+        std::vector<int32_t> keys((size_t)count * 2);
+        for (uint32_t i = 0; i < count; ++i)
+        {
+            keys[i * 2 + 0] = QuantizeWeldValue(uvs[i].u, WeldUVScale);
+            keys[i * 2 + 1] = QuantizeWeldValue(uvs[i].v, WeldUVScale);
+        }
+
+        std::vector<uint32_t> representatives;
+        WeldRows<2>(keys, count, remap, representatives);
+        if (representatives.size() < count)
+            Compact(uvs, representatives);
+    }
+
+    void
+    WeldRGBA32s(std::vector<SC::Store::RGBA32> &rgba32s, std::vector<uint32_t> &remap)
+    {
+        uint32_t const count = (uint32_t)rgba32s.size();
+        std::vector<int32_t> keys(count);
+        for (uint32_t i = 0; i < count; ++i)
+            keys[i] = (int32_t)((uint32_t)rgba32s[i].r | (uint32_t)rgba32s[i].g << 8 | (uint32_t)rgba32s[i].b << 16 |
+                                (uint32_t)rgba32s[i].a << 24);
+
+        std::vector<uint32_t> representatives;
+        WeldRows<1>(keys, count, remap, representatives);
+        if (representatives.size() < count)
+            Compact(rgba32s, representatives);
+    }
+}
+
+float
+WeldPositionScale(float extent)
+{
+    return extent > 0.0f ? (float)(1 << 21) / extent : 1.0f;
+}
+
+int32_t
+QuantizeWeldValue(float value, float scale)
+{
+    double scaled = std::floor((double)value * scale + 0.5);
+    scaled = std::min(std::max(scaled, -2147483647.0), 2147483647.0);
+    return (int32_t)scaled;
+}
+
+WeldStats
+WeldAuthoredMesh(AuthoredMesh &authored)
+{
+    WeldStats stats;
+    stats.points_before = (uint32_t)authored.points.size();
+    stats.normals_before = (uint32_t)authored.normals.size();
+    stats.uvs_before = (uint32_t)authored.uvs.size();
+    stats.rgba32s_before = (uint32_t)authored.rgba32s.size();
+
+    std::vector<uint32_t> point_remap, normal_remap, uv_remap, rgba32_remap;
+    if (!authored.points.empty())
+        WeldPoints(authored.points, point_remap);
+    if (!authored.normals.empty())
+        WeldNormals(authored.normals, normal_remap);
+    if (!authored.uvs.empty())
+        WeldUVs(authored.uvs, uv_remap);
+    if (!authored.rgba32s.empty())
+        WeldRGBA32s(authored.rgba32s, rgba32_remap);
+
+    stats.points_after = (uint32_t)authored.points.size();
+    stats.normals_after = (uint32_t)authored.normals.size();
+    stats.uvs_after = (uint32_t)authored.uvs.size();
+    stats.rgba32s_after = (uint32_t)authored.rgba32s.size();
+
+    // Arrays that did not shrink keep identity indices.
+    RemapMesh(authored.mesh, stats.points_after < stats.points_before ? &point_remap : nullptr,
+              stats.normals_after < stats.normals_before ? &normal_remap : nullptr,
+              stats.uvs_after < stats.uvs_before ? &uv_remap : nullptr,
+              stats.rgba32s_after < stats.rgba32s_before ? &rgba32_remap : nullptr);
+
+    authored.Bind();
+    return stats;
+}
+
+void
+CompactAuthoredMesh(AuthoredMesh &authored)
+{
+    std::vector<uint32_t> point_remap(authored.points.size(), EmptySlot);
+    std::vector<uint32_t> normal_remap(authored.normals.size(), EmptySlot);
+    std::vector<uint32_t> uv_remap(authored.uvs.size(), EmptySlot);
+    std::vector<uint32_t> rgba32_remap(authored.rgba32s.size(), EmptySlot);
+
+    FirstUseNumbering numbering = {{&point_remap, &normal_remap, &uv_remap, &rgba32_remap}, {0, 0, 0, 0}};
+    SC::Store::Mesh &mesh = authored.mesh;
+    NumberByFirstUse(mesh.face_elements,
+                     MakeSlotRemaps(mesh.flags, SC::Store::Mesh::FaceNormals, SC::Store::Mesh::FaceUVs,
+                                    SC::Store::Mesh::FaceRGBA32s, &point_remap, &normal_remap, &uv_remap, &rgba32_remap),
+                     numbering);
+    NumberByFirstUse(mesh.polyline_elements,
+                     MakeSlotRemaps(mesh.flags, SC::Store::Mesh::LineNormals, SC::Store::Mesh::LineUVs,
+                                    SC::Store::Mesh::LineRGBA32s, &point_remap, &normal_remap, &uv_remap, &rgba32_remap),
+                     numbering);
+    NumberByFirstUse(mesh.point_elements,
+                     MakeSlotRemaps(mesh.flags, SC::Store::Mesh::PointNormals, SC::Store::Mesh::PointUVs,
+                                    SC::Store::Mesh::PointRGBA32s, &point_remap, &normal_remap, &uv_remap, &rgba32_remap),
+                     numbering);
+
+    PermuteReferenced(authored.points, point_remap, numbering.next[0]);
+    PermuteReferenced(authored.normals, normal_remap, numbering.next[1]);
+    PermuteReferenced(authored.uvs, uv_remap, numbering.next[2]);
+    PermuteReferenced(authored.rgba32s, rgba32_remap, numbering.next[3]);
+    RemapMesh(mesh, &point_remap, &normal_remap, &uv_remap, &rgba32_remap);
+    authored.Bind();
+}